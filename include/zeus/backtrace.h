@@ -35,6 +35,8 @@ public:
 
     std::string toString(unsigned int skipLevels = 0) const;
 
+    static unsigned int capture(void **addresses, unsigned int size);
+
 private:
     ZEUS_DISABLE_COPY(Backtrace)
 
@@ -20,13 +20,17 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 
+#include <zeus/flags.h>
+
 namespace zeus {
 
+class InvokeMessage;
 class Object;
 
 enum ConnectionType {
@@ -36,6 +40,15 @@ enum ConnectionType {
     ConnectionTypeBlocking,
 };
 
+enum class ConnectionFlag {
+    NoOption = 0,
+    Coalesce = (1 << 0),
+};
+
+using ConnectionFlags = Flags<ConnectionFlag>;
+
+ZEUS_FLAGS_ENABLE_OPERATORS(ConnectionFlag)
+
 class BoundMethodPackBase
 {
 public:
@@ -79,11 +92,16 @@ public:
 class BoundMethodBase
 {
 public:
-    BoundMethodBase(void *obj, Object *object, ConnectionType type)
-            : obj_(obj), object_(object), connectionType_(type)
+    BoundMethodBase(void *obj, Object *object, ConnectionType type,
+                    ConnectionFlags flags = ConnectionFlag::NoOption)
+            : obj_(obj), object_(object), connectionType_(type),
+              connectionFlags_(flags), pendingMessage_(nullptr),
+              invoking_(0), destroyed_(false)
     {
     }
-    virtual ~BoundMethodBase() = default;
+    virtual ~BoundMethodBase();
+
+    void destroy();
 
     template<typename T, std::enable_if_t<!std::is_same<Object, T>::value> * = nullptr>
     bool match(T *obj) { return obj == obj_; }
@@ -101,7 +119,16 @@ protected:
     Object *object_;
 
 private:
+    friend class InvokeMessage;
+
+    static void invokeMessage(InvokeMessage *msg);
+    static void releaseMessage(InvokeMessage *msg);
+
     ConnectionType connectionType_;
+    ConnectionFlags connectionFlags_;
+    InvokeMessage *pendingMessage_;
+    unsigned int invoking_;
+    bool destroyed_;
 };
 
 template<typename R, typename... Args>
@@ -109,6 +136,7 @@ class BoundMethodArgs : public BoundMethodBase
 {
 public:
     using PackType = BoundMethodPack<R, Args...>;
+    using Filter = std::function<bool(const std::remove_reference_t<Args> &...)>;
 
 private:
     template<std::size_t... I, typename T = R>
@@ -129,16 +157,26 @@ private:
     }
 
 public:
-    BoundMethodArgs(void *obj, Object *object, ConnectionType type)
-            : BoundMethodBase(obj, object, type) {}
+    BoundMethodArgs(void *obj, Object *object, ConnectionType type,
+                    ConnectionFlags flags = ConnectionFlag::NoOption)
+            : BoundMethodBase(obj, object, type, flags) {}
 
     void invokePack(BoundMethodPackBase *pack) override
     {
         invokePack(pack, std::make_index_sequence<sizeof...(Args)>{});
     }
 
+    void setFilter(Filter filter) { filter_ = std::move(filter); }
+    bool accept(const std::remove_reference_t<Args> &...args) const
+    {
+        return !filter_ || filter_(args...);
+    }
+
     virtual R activate(Args... args, bool deleteMethod = false) = 0;
     virtual R invoke(Args... args) = 0;
+
+private:
+    Filter filter_;
 };
 
 template<typename T, typename R, typename Func, typename... Args>
@@ -148,8 +186,9 @@ public:
     using PackType = typename BoundMethodArgs<R, Args...>::PackType;
 
     BoundMethodFunctor(T *obj, Object *object, Func func,
-                       ConnectionType type = ConnectionTypeAuto)
-            : BoundMethodArgs<R, Args...>(obj, object, type), func_(func)
+                       ConnectionType type = ConnectionTypeAuto,
+                       ConnectionFlags flags = ConnectionFlag::NoOption)
+            : BoundMethodArgs<R, Args...>(obj, object, type, flags), func_(func)
     {
     }
 
@@ -179,8 +218,9 @@ public:
     using PackType = typename BoundMethodArgs<R, Args...>::PackType;
 
     BoundMethodMember(T *obj, Object *object, R (T::*func)(Args...),
-                      ConnectionType type = ConnectionTypeAuto)
-            : BoundMethodArgs<R, Args...>(obj, object, type), func_(func)
+                      ConnectionType type = ConnectionTypeAuto,
+                      ConnectionFlags flags = ConnectionFlag::NoOption)
+            : BoundMethodArgs<R, Args...>(obj, object, type, flags), func_(func)
     {
     }
 
@@ -0,0 +1,110 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: durable_file.h - Atomic file replacement and group-commit append log
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include <zeus/macros.h>
+#include <zeus/mutex.h>
+#include <zeus/private.h>
+#include <zeus/signal.h>
+#include <zeus/span.h>
+#include <zeus/unique_fd.h>
+
+namespace zeus {
+
+class DurableLogRequest;
+class DurableLogState;
+class DurableLogThread;
+
+class AtomicFile
+{
+public:
+    AtomicFile(const std::string &name);
+    ~AtomicFile();
+
+    const std::string &fileName() const { return name_; }
+
+    int open(mode_t mode = 0666);
+    bool isOpen() const { return fd_.isValid(); }
+
+    ssize_t write(const Span<const uint8_t> &data);
+    int commit();
+    void discard();
+
+    static int replace(const std::string &name, const Span<const uint8_t> &data,
+                       mode_t mode = 0666);
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(AtomicFile)
+
+    std::string name_;
+    std::string tmpName_;
+    UniqueFD fd_;
+};
+
+class DurableLog
+{
+public:
+    DurableLog(const std::string &name);
+    ~DurableLog();
+
+    const std::string &fileName() const { return name_; }
+
+    int open();
+    bool isOpen() const { return fd_.isValid(); }
+    void close();
+
+    int64_t append(const Span<const uint8_t> &record);
+    int flush();
+
+    Signal<uint64_t, int> committed;
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(DurableLog)
+
+    friend class DurableLogThread;
+
+    void run();
+
+    std::string name_;
+    UniqueFD fd_;
+
+    std::shared_ptr<DurableLogState> state_;
+    std::atomic<uint64_t> nextId_;
+
+    Mutex mutex_;
+    ConditionVariable cv_;
+    std::vector<DurableLogRequest *> pending_ ZEUS_TSA_GUARDED_BY(mutex_);
+    uint64_t appended_ ZEUS_TSA_GUARDED_BY(mutex_);
+    uint64_t synced_ ZEUS_TSA_GUARDED_BY(mutex_);
+    int error_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool stop_ ZEUS_TSA_GUARDED_BY(mutex_);
+
+    std::unique_ptr<DurableLogThread> thread_;
+};
+
+} /* namespace zeus */
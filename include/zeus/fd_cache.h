@@ -0,0 +1,87 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: fd_cache.h - LRU cache of open file descriptors
+//
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+#include <zeus/file.h>
+#include <zeus/macros.h>
+#include <zeus/mutex.h>
+#include <zeus/private.h>
+#include <zeus/shared_fd.h>
+
+namespace zeus {
+
+class FdCache
+{
+public:
+    static constexpr size_t kDefaultCapacity = 64;
+
+    struct Statistics {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t invalidations;
+    };
+
+    FdCache(size_t capacity = kDefaultCapacity);
+    ~FdCache();
+
+    int get(const std::string &path, SharedFD *fd,
+            File::OpenMode mode = File::OpenModeFlag::ReadOnly);
+
+    void invalidate(const std::string &path);
+    void invalidate(const std::string &oldPath, const std::string &newPath);
+    void clear();
+
+    size_t capacity() const;
+    void setCapacity(size_t capacity);
+    size_t size() const;
+
+    Statistics statistics() const;
+    void resetStatistics();
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(FdCache)
+
+    using Key = std::pair<std::string, File::OpenMode::Type>;
+
+    struct Entry {
+        Key key;
+        SharedFD fd;
+    };
+
+    void evict(std::list<Entry> *evicted) ZEUS_TSA_REQUIRES(mutex_);
+
+    mutable Mutex mutex_;
+
+    size_t capacity_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::list<Entry> entries_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::map<Key, std::list<Entry>::iterator> index_ ZEUS_TSA_GUARDED_BY(mutex_);
+    Statistics stats_ ZEUS_TSA_GUARDED_BY(mutex_);
+    uint64_t generation_ ZEUS_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace zeus */
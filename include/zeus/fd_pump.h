@@ -0,0 +1,71 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: fd_pump.h - Zero-copy data pump between file descriptors
+//
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+
+#include <zeus/object.h>
+#include <zeus/private.h>
+#include <zeus/signal.h>
+#include <zeus/unique_fd.h>
+
+namespace zeus {
+
+class EventNotifier;
+
+class FdPump : public Object
+{
+public:
+    FdPump(int in, int out, Object *parent = nullptr);
+    ~FdPump();
+
+    int start(uint64_t size = UINT64_MAX);
+    void stop();
+    bool isRunning() const { return running_; }
+
+    uint64_t bytesTransferred() const { return transferred_; }
+
+    Signal<int> finished;
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(FdPump)
+
+    void pump();
+    void finish(int result);
+
+    int in_;
+    int out_;
+
+    UniqueFD pipeIn_;
+    UniqueFD pipeOut_;
+    size_t pipeSize_;
+
+    std::unique_ptr<EventNotifier> inNotifier_;
+    std::unique_ptr<EventNotifier> outNotifier_;
+
+    bool running_;
+    uint64_t toRead_;
+    size_t buffered_;
+    uint64_t transferred_;
+};
+
+} /* namespace zeus */
@@ -21,23 +21,60 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <stdint.h>
 #include <string>
 #include <sys/types.h>
 
 #include <zeus/flags.h>
 #include <zeus/macros.h>
 #include <zeus/private.h>
+#include <zeus/signal.h>
 #include <zeus/span.h>
 #include <zeus/unique_fd.h>
 
 namespace zeus {
 
+class FileIoState;
+class SharedFD;
+
+class AlignedBuffer
+{
+public:
+    AlignedBuffer();
+    AlignedBuffer(size_t size, size_t alignment);
+    AlignedBuffer(AlignedBuffer &&other);
+    ~AlignedBuffer();
+
+    AlignedBuffer &operator=(AlignedBuffer &&other);
+
+    bool isValid() const { return data_ != nullptr; }
+    uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t alignment() const { return alignment_; }
+
+    Span<uint8_t> span() const { return { data_, size_ }; }
+
+private:
+    ZEUS_DISABLE_COPY(AlignedBuffer)
+
+    uint8_t *data_;
+    size_t size_;
+    size_t alignment_;
+};
+
 class File
 {
 public:
     enum class MapFlag {
         NoOption = 0,
         Private = (1 << 0),
+        Populate = (1 << 1),
+        Sequential = (1 << 2),
+        Random = (1 << 3),
+        WillNeed = (1 << 4),
+        HugePage = (1 << 5),
+        Locked = (1 << 6),
     };
 
     using MapFlags = Flags<MapFlag>;
@@ -47,11 +84,20 @@ public:
         ReadOnly = (1 << 0),
         WriteOnly = (1 << 1),
         ReadWrite = ReadOnly | WriteOnly,
+        Direct = (1 << 2),
     };
 
     using OpenMode = Flags<OpenModeFlag>;
 
+    enum class AllocateFlag {
+        NoOption = 0,
+        KeepSize = (1 << 0),
+    };
+
+    using AllocateFlags = Flags<AllocateFlag>;
+
     File(const std::string &name);
+    File(const SharedFD &fd, const std::string &name = std::string());
     File();
     ~File();
 
@@ -64,6 +110,8 @@ public:
     OpenMode openMode() const { return mode_; }
     void close();
 
+    size_t directIoAlignment() const { return directAlignment_; }
+
     int error() const { return error_; }
     ssize_t size() const;
 
@@ -73,26 +121,82 @@ public:
     ssize_t read(const Span<uint8_t> &data);
     ssize_t write(const Span<const uint8_t> &data);
 
+    ssize_t readAt(off_t offset, const Span<uint8_t> &data);
+    ssize_t writeAt(off_t offset, const Span<const uint8_t> &data);
+
+    ssize_t readv(const Span<const Span<uint8_t>> &buffers);
+    ssize_t writev(const Span<const Span<const uint8_t>> &buffers);
+    ssize_t readvAt(off_t offset, const Span<const Span<uint8_t>> &buffers,
+                    int flags = 0);
+    ssize_t writevAt(off_t offset, const Span<const Span<const uint8_t>> &buffers,
+                     int flags = 0);
+
+    ssize_t copyTo(File &dest, off_t offset, size_t size, off_t destOffset);
+    ssize_t transferTo(int fd, off_t offset, size_t size);
+
+    int allocate(off_t offset, off_t size,
+                 AllocateFlags flags = AllocateFlag::NoOption);
+    int truncate(off_t size);
+    int punchHole(off_t offset, off_t size);
+    int startWriteback(off_t offset, off_t size);
+    int waitWriteback(off_t offset, off_t size);
+
+    int64_t readAsync(off_t offset, const Span<uint8_t> &data);
+    int64_t writeAsync(off_t offset, const Span<const uint8_t> &data);
+    int64_t syncAsync();
+    size_t bytesInFlight() const;
+
+    static void setAsyncQueueDepth(unsigned int depth);
+
+    Signal<uint64_t, ssize_t> ioCompleted;
+
     Span<uint8_t> map(off_t offset = 0, ssize_t size = -1,
                       MapFlags flags = MapFlag::NoOption);
     bool unmap(uint8_t *addr);
 
+    int advise(const Span<const uint8_t> &region, MapFlags advice);
+    int prefetch(const Span<const uint8_t> &region);
+    int64_t prefetchAsync(const Span<const uint8_t> &region);
+    int lock(const Span<const uint8_t> &region);
+    int unlock(const Span<const uint8_t> &region);
+    ssize_t residentPages(const Span<const uint8_t> &region) const;
+
     static bool exists(const std::string &name);
 
 private:
     ZEUS_DISABLE_COPY(File)
 
+    friend class FileIoRequest;
+
+    enum class IoOperation {
+        Read,
+        Write,
+        Sync,
+        Prefetch,
+    };
+
     void unmapAll();
+    int checkDirectIo(const void *data, size_t size, off_t offset) const;
+    ssize_t transferBuffered(int fd, off_t offset, size_t size,
+                             off_t destOffset);
+    bool isMapped(const Span<const uint8_t> &region) const;
+    void waitAsync();
+    int64_t submitAsync(IoOperation operation, off_t offset, uint8_t *data,
+                        size_t size);
 
     std::string name_;
     UniqueFD fd_;
     OpenMode mode_;
+    size_t directAlignment_;
 
     int error_;
     std::map<void *, size_t> maps_;
+
+    std::shared_ptr<FileIoState> io_;
 };
 
 ZEUS_FLAGS_ENABLE_OPERATORS(File::MapFlag)
 ZEUS_FLAGS_ENABLE_OPERATORS(File::OpenModeFlag)
+ZEUS_FLAGS_ENABLE_OPERATORS(File::AllocateFlag)
 
 } /* namespace zeus */
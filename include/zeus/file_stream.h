@@ -0,0 +1,120 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: file_stream.h - Buffered streaming reader and writer over File
+//
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+#include <zeus/file.h>
+#include <zeus/macros.h>
+#include <zeus/private.h>
+#include <zeus/span.h>
+
+namespace zeus {
+
+class FileStreamJob;
+
+class FileReader
+{
+public:
+    static constexpr size_t kDefaultBufferSize = 1024 * 1024;
+
+    FileReader(File &file, off_t offset = 0,
+               size_t bufferSize = kDefaultBufferSize);
+    ~FileReader();
+
+    bool readLine(std::string_view *line, char delimiter = '\n');
+    bool readRecord(size_t size, Span<const uint8_t> *record);
+
+    off_t offset() const { return offset_; }
+    int error() const { return error_; }
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(FileReader)
+
+    struct Chunk {
+        AlignedBuffer buffer;
+        ssize_t result;
+    };
+
+    void readAhead(unsigned int index);
+    bool fetch();
+
+    File &file_;
+    Chunk chunks_[2];
+    unsigned int current_;
+    size_t length_;
+    size_t pos_;
+    size_t skip_;
+
+    off_t offset_;
+    off_t readOffset_;
+    bool end_;
+    int error_;
+
+    std::string carry_;
+    std::unique_ptr<FileStreamJob> job_;
+};
+
+class FileWriter
+{
+public:
+    static constexpr size_t kDefaultBufferSize = 1024 * 1024;
+
+    FileWriter(File &file, off_t offset = 0,
+               size_t bufferSize = kDefaultBufferSize);
+    ~FileWriter();
+
+    int write(const Span<const uint8_t> &data);
+    int write(std::string_view data);
+
+    Span<uint8_t> reserve(size_t size);
+    void commit(size_t size);
+
+    int flush();
+
+    off_t offset() const { return writeOffset_ + length_; }
+    int error() const { return error_; }
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(FileWriter)
+
+    void writeBehind(bool flush = false);
+    void complete();
+
+    File &file_;
+    AlignedBuffer buffers_[2];
+    unsigned int current_;
+    size_t length_;
+    size_t directAlignment_;
+
+    off_t writeOffset_;
+    size_t pendingSize_;
+    ssize_t pendingResult_;
+    int error_;
+
+    std::unique_ptr<FileStreamJob> job_;
+};
+
+} /* namespace zeus */
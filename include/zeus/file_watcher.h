@@ -0,0 +1,98 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: file_watcher.h - inotify-based file system watcher
+//
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <zeus/object.h>
+#include <zeus/private.h>
+#include <zeus/signal.h>
+#include <zeus/unique_fd.h>
+
+namespace zeus {
+
+class EventNotifier;
+class Timer;
+
+class FileWatcher : public Object
+{
+public:
+    FileWatcher(Object *parent = nullptr);
+    ~FileWatcher();
+
+    int addPath(const std::string &path);
+    int removePath(const std::string &path);
+    std::vector<std::string> paths() const;
+
+    void setCoalescingInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds coalescingInterval() const { return interval_; }
+
+    Signal<const std::string &> modified;
+    Signal<const std::string &> created;
+    Signal<const std::string &> deleted;
+    Signal<const std::string &, const std::string &> moved;
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(FileWatcher)
+
+    enum class EventType {
+        Modified,
+        Created,
+        Deleted,
+        Moved,
+    };
+
+    struct Event {
+        EventType type;
+        std::string path;
+        std::string target;
+    };
+
+    struct Watch {
+        std::string path;
+        bool directory = false;
+        std::map<std::string, std::string> files;
+    };
+
+    void readEvents();
+    void queueEvent(EventType type, const std::string &path,
+                    const std::string &target = std::string());
+    void flush();
+
+    UniqueFD fd_;
+    std::unique_ptr<EventNotifier> notifier_;
+    std::unique_ptr<Timer> timer_;
+    std::chrono::milliseconds interval_;
+
+    std::map<int, Watch> watches_;
+    std::map<std::string, int> paths_;
+
+    std::vector<Event> pending_;
+    std::set<std::string> modifiedPaths_;
+};
+
+} /* namespace zeus */
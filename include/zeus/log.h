@@ -20,8 +20,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <sstream>
+#include <stdint.h>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include <zeus/macros.h>
 #include <zeus/private.h>
@@ -38,22 +43,95 @@ enum LogSeverity {
     LogFatal,
 };
 
+#ifndef ZEUS_LOG_MIN_SEVERITY
+#define ZEUS_LOG_MIN_SEVERITY 0
+#endif
+
+#ifndef ZEUS_LOG_CATEGORY_MIN_SEVERITY
+#define ZEUS_LOG_CATEGORY_MIN_SEVERITY ""
+#endif
+
+#ifndef __DOXYGEN__
+namespace details {
+
+constexpr int logParseSeverity(std::string_view level)
+{
+    constexpr std::string_view names[] = { "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+
+    for (int i = 0; i <= LogFatal; ++i) {
+        if (level == names[i])
+            return i;
+    }
+
+    if (level.size() == 1 && level[0] >= '0' && level[0] <= '0' + LogFatal)
+        return level[0] - '0';
+
+    return LogInvalid;
+}
+
+/*
+ * Compute the compile-time severity floor for a category. The overrides use
+ * the ZEUS_LOG_LEVELS syntax, a comma-separated list of "category:level"
+ * pairs where a '*' matches all remaining characters of the category name.
+ */
+constexpr int logMinSeverity(std::string_view category)
+{
+    std::string_view overrides = ZEUS_LOG_CATEGORY_MIN_SEVERITY;
+
+    while (!overrides.empty()) {
+        size_t comma = overrides.find(',');
+        std::string_view pair = overrides.substr(0, comma);
+        overrides = comma == std::string_view::npos
+                            ? std::string_view()
+                            : overrides.substr(comma + 1);
+
+        size_t colon = pair.find(':');
+        if (colon == std::string_view::npos)
+            continue;
+
+        std::string_view pattern = pair.substr(0, colon);
+        int severity = logParseSeverity(pair.substr(colon + 1));
+        if (severity == LogInvalid)
+            continue;
+
+        size_t star = pattern.find('*');
+        if (star == std::string_view::npos ? pattern == category
+                                           : category.substr(0, star) == pattern.substr(0, star))
+            return severity;
+    }
+
+    return ZEUS_LOG_MIN_SEVERITY;
+}
+
+} /* namespace details */
+
+/* Fatal messages abort execution and are never compiled out. */
+#define _LOG_COMPILED(name, severity)                                        \
+    (std::integral_constant<bool, (severity) == LogFatal ||                    \
+                                          (severity) >= details::logMinSeverity(name)>::value)
+#endif /* __DOXYGEN__ */
+
 class LogCategory
 {
 public:
     static LogCategory *create(const char *name);
 
     const std::string &name() const { return name_; }
-    LogSeverity severity() const { return severity_; }
+    LogSeverity severity() const { return severity_.load(std::memory_order_relaxed); }
     void setSeverity(LogSeverity severity);
 
+    bool isEnabled(LogSeverity severity) const
+    {
+        return severity >= severity_.load(std::memory_order_relaxed);
+    }
+
     static const LogCategory &defaultCategory();
 
 private:
     explicit LogCategory(const char *name);
 
     const std::string name_;
-    LogSeverity severity_;
+    std::atomic<LogSeverity> severity_;
 };
 
 #define LOG_DECLARE_CATEGORY(name) \
@@ -67,6 +145,82 @@ private:
         return *category;                                            \
     }
 
+class LogField
+{
+public:
+    enum Type {
+        Bool,
+        Int,
+        UInt,
+        Double,
+        String,
+    };
+
+    LogField(const char *key, bool value)
+        : key_(key), type_(Bool), bool_(value)
+    {
+    }
+
+    template<typename T,
+             std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>> * = nullptr>
+    LogField(const char *key, T value)
+        : key_(key), type_(Int), int_(value)
+    {
+    }
+
+    template<typename T,
+             std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T> &&
+                              !std::is_same_v<T, bool>> * = nullptr>
+    LogField(const char *key, T value)
+        : key_(key), type_(UInt), uint_(value)
+    {
+    }
+
+    LogField(const char *key, double value)
+        : key_(key), type_(Double), double_(value)
+    {
+    }
+
+    LogField(const char *key, std::string_view value)
+        : key_(key), type_(String), string_(value)
+    {
+    }
+
+    LogField(const char *key, const char *value)
+        : LogField(key, std::string_view(value))
+    {
+    }
+
+    LogField(const char *key, const std::string &value)
+        : LogField(key, std::string_view(value))
+    {
+    }
+
+    const char *key() const { return key_; }
+    Type type() const { return type_; }
+
+    bool boolValue() const { return bool_; }
+    int64_t intValue() const { return int_; }
+    uint64_t uintValue() const { return uint_; }
+    double doubleValue() const { return double_; }
+    const std::string &stringValue() const { return string_; }
+
+private:
+    const char *key_;
+    Type type_;
+    union {
+        bool bool_;
+        int64_t int_;
+        uint64_t uint_;
+        double double_;
+    };
+    std::string string_;
+};
+
+std::ostream &operator<<(std::ostream &out, const LogField &field);
+
+class AsyncLogWriter;
+
 class LogMessage
 {
 public:
@@ -82,21 +236,44 @@ public:
     const utils::time_point &timestamp() const { return timestamp_; }
     LogSeverity severity() const { return severity_; }
     const LogCategory &category() const { return category_; }
-    const std::string &fileInfo() const { return fileInfo_; }
+    const char *fileName() const { return fileName_; }
+    unsigned int line() const { return line_; }
+    const std::string &fileInfo() const;
     const std::string &prefix() const { return prefix_; }
-    const std::string msg() const { return msgStream_.str(); }
+    const std::string msg() const { return msgBuffer_.str(); }
+    std::string_view msgView() const { return msgBuffer_.view(); }
+    const std::vector<LogField> &fields() const { return fields_; }
+    const std::string &backtrace() const { return backtrace_; }
 
 private:
     ZEUS_DISABLE_COPY(LogMessage)
 
+    friend class AsyncLogWriter;
+    friend std::ostream &operator<<(std::ostream &out, const LogField &field);
+    static int streamIndex();
+
+    class Buffer : public std::stringbuf
+    {
+    public:
+        std::string_view view() const
+        {
+            return { pbase(), static_cast<size_t>(pptr() - pbase()) };
+        }
+    };
+
     void init(const char *fileName, unsigned int line);
 
-    std::ostringstream msgStream_;
+    Buffer msgBuffer_;
+    std::ostream msgStream_;
     const LogCategory &category_;
     LogSeverity severity_;
     utils::time_point timestamp_;
-    std::string fileInfo_;
+    const char *fileName_;
+    unsigned int line_;
+    mutable std::string fileInfo_;
     std::string prefix_;
+    std::vector<LogField> fields_;
+    std::string backtrace_;
 };
 
 class Loggable
@@ -116,12 +293,66 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
                 const char *fileName = __builtin_FILE(),
                 unsigned int line = __builtin_LINE());
 
+class LogRateLimiter
+{
+public:
+    enum Policy {
+        EveryN,
+        FirstN,
+        PerSecond,
+    };
+
+    struct Result {
+        bool allowed;
+        unsigned int suppressed;
+    };
+
+    LogRateLimiter(Policy policy, unsigned int count);
+
+    Result check();
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(LogRateLimiter)
+
+    const Policy policy_;
+    const unsigned int count_;
+
+    std::atomic<uint64_t> occurrences_;
+    std::atomic<unsigned int> suppressed_;
+    std::atomic<int64_t> windowStart_;
+    std::atomic<unsigned int> windowCount_;
+};
+
+std::ostream &operator<<(std::ostream &out, const LogRateLimiter::Result &result);
+
 #ifndef __DOXYGEN__
+class LogMessageVoidify
+{
+public:
+    void operator&([[maybe_unused]] std::ostream &stream) {}
+};
+
 #define _LOG_CATEGORY(name) logCategory##name
 
-#define _LOG1(severity) \
+/*
+ * Check the category severity before constructing the LogMessage. The
+ * conditional operator has a lower precedence than operator<<(), so the whole
+ * stream insertion chain is skipped when the message is disabled.
+ * LogMessageVoidify turns the stream into void to match the other branch.
+ * Messages below the compile-time severity floor fold to a constant true
+ * condition, and their code is discarded by the compiler.
+ */
+#define _LOG_IF_ENABLED(name, category, severity)                          \
+    !_LOG_COMPILED(name, severity) ||                                      \
+            !__builtin_expect((category).isEnabled(severity), 0)           \
+            ? (void)0                                                      \
+            : LogMessageVoidify() &
+
+#define _LOG1(severity)                                                       \
+    _LOG_IF_ENABLED("default", LogCategory::defaultCategory(), Log##severity) \
     _log(nullptr, Log##severity).stream()
-#define _LOG2(category, severity) \
+#define _LOG2(category, severity)                                             \
+    _LOG_IF_ENABLED(#category, _LOG_CATEGORY(category)(), Log##severity)      \
     _log(&_LOG_CATEGORY(category)(), Log##severity).stream()
 
 /*
@@ -130,8 +361,36 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
  */
 #define _LOG_MACRO(_1, _2, NAME, ...) NAME
 #define LOG(...) _LOG_MACRO(__VA_ARGS__, _LOG2, _LOG1)(__VA_ARGS__)
+
+/*
+ * The rate limiter state is a static local of the if statement, and thus
+ * unique to the call site. The switch statement wraps the if statement chain,
+ * so that an else following the macro binds to the caller's if statement
+ * without triggering dangling else warnings.
+ */
+#define _LOG_LIMITED(category, severity, policy, count)                            \
+    switch (0)                                                                     \
+    case 0:                                                                        \
+    default:                                                                       \
+    if constexpr (!_LOG_COMPILED(#category, Log##severity)) {                      \
+    } else if (static LogRateLimiter _logLimiter(LogRateLimiter::policy, count);  \
+        !__builtin_expect(_LOG_CATEGORY(category)().isEnabled(Log##severity), 0)) { \
+    } else if (LogRateLimiter::Result _logLimit = _logLimiter.check();             \
+               !_logLimit.allowed) {                                               \
+    } else                                                                         \
+        _log(&_LOG_CATEGORY(category)(), Log##severity).stream() << _logLimit
+
+#define LOG_EVERY_N(category, severity, n) \
+    _LOG_LIMITED(category, severity, EveryN, n)
+#define LOG_FIRST_N(category, severity, n) \
+    _LOG_LIMITED(category, severity, FirstN, n)
+#define LOG_RATE_LIMITED(category, severity, n) \
+    _LOG_LIMITED(category, severity, PerSecond, n)
 #else /* __DOXYGEN___ */
 #define LOG(category, severity)
+#define LOG_EVERY_N(category, severity, n)
+#define LOG_FIRST_N(category, severity, n)
+#define LOG_RATE_LIMITED(category, severity, n)
 #endif /* __DOXYGEN__ */
 
 #ifndef NDEBUG
@@ -0,0 +1,183 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: log_binary.h - Binary deferred-formatting log records
+//
+
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <zeus/log.h>
+#include <zeus/private.h>
+
+namespace zeus {
+
+#ifndef __DOXYGEN__
+namespace details {
+
+template<typename T>
+constexpr char logBinaryType()
+{
+    using U = std::decay_t<T>;
+
+    if constexpr (std::is_same_v<U, bool>)
+        return 'u';
+    else if constexpr (std::is_enum_v<U>)
+        return std::is_signed_v<std::underlying_type_t<U>> ? 'i' : 'u';
+    else if constexpr (std::is_integral_v<U>)
+        return std::is_signed_v<U> ? 'i' : 'u';
+    else if constexpr (std::is_floating_point_v<U>)
+        return 'f';
+    else if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *> ||
+                       std::is_same_v<U, std::string> || std::is_same_v<U, std::string_view>)
+        return 's';
+    else if constexpr (std::is_pointer_v<U>)
+        return 'p';
+    else
+        static_assert(!sizeof(T), "Unsupported binary log argument type");
+}
+
+template<typename T>
+std::string_view logBinaryString(const T &value)
+{
+    if constexpr (std::is_pointer_v<T>) {
+        if (!value)
+            return "(null)";
+    }
+
+    return std::string_view(value);
+}
+
+template<typename T>
+size_t logBinarySize(const T &value)
+{
+    if constexpr (logBinaryType<T>() == 's')
+        return sizeof(uint32_t) + logBinaryString(value).size();
+    else
+        return sizeof(uint64_t);
+}
+
+template<typename T>
+void logBinaryEncode(uint8_t *&data, const T &value)
+{
+    constexpr char type = logBinaryType<T>();
+
+    if constexpr (type == 's') {
+        std::string_view str = logBinaryString(value);
+        uint32_t size = str.size();
+        memcpy(data, &size, sizeof(size));
+        memcpy(data + sizeof(size), str.data(), size);
+        data += sizeof(size) + size;
+        return;
+    } else {
+        uint64_t raw;
+
+        if constexpr (type == 'f') {
+            double v = value;
+            memcpy(&raw, &v, sizeof(raw));
+        } else if constexpr (type == 'p') {
+            raw = reinterpret_cast<uintptr_t>(value);
+        } else if constexpr (type == 'i') {
+            raw = static_cast<uint64_t>(static_cast<int64_t>(value));
+        } else {
+            raw = static_cast<uint64_t>(value);
+        }
+
+        memcpy(data, &raw, sizeof(raw));
+        data += sizeof(raw);
+    }
+}
+
+} /* namespace details */
+#endif /* __DOXYGEN__ */
+
+class LogBinarySite
+{
+public:
+    LogBinarySite(const LogCategory &category, LogSeverity severity,
+                  const char *fileName, unsigned int line,
+                  const char *format);
+
+    template<typename... Args>
+    void log(const Args &...args)
+    {
+        static constexpr char types[] = { details::logBinaryType<Args>()..., '\0' };
+
+        uint32_t id = id_.load(std::memory_order_acquire);
+        if (!id)
+            id = registerSite(types);
+
+        size_t size = (details::logBinarySize(args) + ... + 0);
+
+        uint8_t *data = beginRecord(id, size);
+        if (data) {
+            (details::logBinaryEncode(data, args), ...);
+            endRecord();
+            return;
+        }
+
+        /* No binary output, format the message as text. */
+        std::vector<uint8_t> payload(size);
+        data = payload.data();
+        (details::logBinaryEncode(data, args), ...);
+        logText(types, payload);
+    }
+
+private:
+    uint32_t registerSite(const char *types);
+    uint8_t *beginRecord(uint32_t id, size_t size);
+    void endRecord();
+    void logText(const char *types, const std::vector<uint8_t> &payload);
+
+    const LogCategory &category_;
+    LogSeverity severity_;
+    const char *fileName_;
+    unsigned int line_;
+    const char *format_;
+
+    std::atomic<uint32_t> id_;
+};
+
+int logSetBinaryFile(const char *path);
+void logFlushBinary();
+void logDumpBinary();
+int logDecodeBinary(std::istream &input, std::ostream &output);
+
+#ifndef __DOXYGEN__
+#define LOG_BINARY(category, severity, format, ...)                             \
+    do {                                                                        \
+        if constexpr (!_LOG_COMPILED(#category, Log##severity)) {               \
+        } else if (_LOG_CATEGORY(category)().isEnabled(Log##severity)) {        \
+            static LogBinarySite _logSite(_LOG_CATEGORY(category)(),            \
+                                          Log##severity, __FILE__, __LINE__,    \
+                                          format);                              \
+            _logSite.log(__VA_ARGS__);                                          \
+        }                                                                       \
+    } while (0)
+#else
+#define LOG_BINARY(category, severity, format, ...)
+#endif
+
+} /* namespace zeus */
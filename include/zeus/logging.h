@@ -20,7 +20,9 @@
 
 #pragma once
 
+#include <chrono>
 #include <iostream>
+#include <stddef.h>
 
 namespace zeus {
 
@@ -29,11 +31,49 @@ enum LoggingTarget {
     LoggingTargetSyslog,
     LoggingTargetFile,
     LoggingTargetStream,
+    LoggingTargetFlightRecorder,
+    LoggingTargetJournal,
+};
+
+enum LoggingFormat {
+    LoggingFormatText,
+    LoggingFormatJson,
+    LoggingFormatLogfmt,
+    LoggingFormatJournal,
+};
+
+enum LoggingOverflowPolicy {
+    LoggingOverflowBlock,
+    LoggingOverflowDrop,
 };
 
 int logSetFile(const char *path, bool color = false);
 int logSetStream(std::ostream *stream, bool color = false);
+int logSetFlightRecorder(size_t size, const char *path = nullptr);
 int logSetTarget(LoggingTarget target);
+int logSetFormat(LoggingFormat format);
+
+int logAddFileSink(const char *path, bool color = false);
+int logAddStreamSink(std::ostream *stream, bool color = false);
+int logAddSyslogSink();
+int logAddJournalSink(const char *path = nullptr);
+int logAddFlightRecorderSink(size_t size, const char *path = nullptr);
+int logRemoveSink(int sink);
+int logSetSinkLevel(int sink, const char *category, const char *level);
+int logSetSinkFormat(int sink, LoggingFormat format);
+int logSetSinkRotation(int sink, size_t maxSize, unsigned int count = 5,
+                       std::chrono::seconds interval = std::chrono::seconds(0),
+                       bool compress = false);
+
 void logSetLevel(const char *category, const char *level);
+int logSetAsync(bool enable,
+                LoggingOverflowPolicy policy = LoggingOverflowBlock,
+                unsigned int capacity = 4096);
+void logFlush();
+void logSetCollapseRepeated(bool enable);
+int logDumpFlightRecorder(int fd);
+int logDecodeFlightRecorder(std::istream &input, std::ostream &output);
+int logSetCrashHandler(int fd);
+int logDecodeCrashReport(std::istream &input, std::ostream &output);
 
 } /* namespace zeus */
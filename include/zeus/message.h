@@ -74,10 +74,13 @@ public:
     void invoke();
 
 private:
+    friend class BoundMethodBase;
+
     BoundMethodBase *method_;
     std::shared_ptr<BoundMethodPackBase> pack_;
     Semaphore *semaphore_;
     bool deleteMethod_;
+    bool coalesced_;
 };
 
 } /* namespace zeus */
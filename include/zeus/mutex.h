@@ -124,6 +124,14 @@ public:
         return cv_.wait_for(locker.lock_, relTime, stopWaiting);
     }
 
+    template<class Clock, class Duration, class Predicate>
+    bool wait_until(MutexLocker &locker,
+                    const std::chrono::time_point<Clock, Duration> &absTime,
+                    Predicate stopWaiting)
+    {
+        return cv_.wait_until(locker.lock_, absTime, stopWaiting);
+    }
+
 private:
     std::condition_variable cv_;
 };
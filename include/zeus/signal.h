@@ -51,6 +51,8 @@ template<typename... Args>
 class Signal : public SignalBase
 {
 public:
+    using Filter = typename BoundMethodArgs<void, Args...>::Filter;
+
     ~Signal()
     {
         disconnect();
@@ -59,10 +61,22 @@ public:
 #ifndef __DOXYGEN__
     template<typename T, typename R, std::enable_if_t<std::is_base_of<Object, T>::value> * = nullptr>
     void connect(T *obj, R (T::*func)(Args...),
-                 ConnectionType type = ConnectionTypeAuto)
+                 ConnectionType type = ConnectionTypeAuto,
+                 ConnectionFlags flags = ConnectionFlag::NoOption)
+    {
+        Object *object = static_cast<Object *>(obj);
+        SignalBase::connect(new BoundMethodMember<T, R, Args...>(obj, object, func, type, flags));
+    }
+
+    template<typename T, typename R, std::enable_if_t<std::is_base_of<Object, T>::value> * = nullptr>
+    void connect(T *obj, R (T::*func)(Args...), Filter filter,
+                 ConnectionType type = ConnectionTypeAuto,
+                 ConnectionFlags flags = ConnectionFlag::NoOption)
     {
         Object *object = static_cast<Object *>(obj);
-        SignalBase::connect(new BoundMethodMember<T, R, Args...>(obj, object, func, type));
+        auto *slot = new BoundMethodMember<T, R, Args...>(obj, object, func, type, flags);
+        slot->setFilter(std::move(filter));
+        SignalBase::connect(slot);
     }
 
     template<typename T, typename R, std::enable_if_t<!std::is_base_of<Object, T>::value> * = nullptr>
@@ -81,10 +95,27 @@ public:
                               && std::is_invocable_v<Func, Args...>
 #endif
                               > * = nullptr>
-    void connect(T *obj, Func func, ConnectionType type = ConnectionTypeAuto)
+    void connect(T *obj, Func func, ConnectionType type = ConnectionTypeAuto,
+                 ConnectionFlags flags = ConnectionFlag::NoOption)
+    {
+        Object *object = static_cast<Object *>(obj);
+        SignalBase::connect(new BoundMethodFunctor<T, void, Func, Args...>(obj, object, func, type, flags));
+    }
+
+    template<typename T, typename Func,
+             std::enable_if_t<std::is_base_of<Object, T>::value
+#if __cplusplus >= 201703L
+                              && std::is_invocable_v<Func, Args...>
+#endif
+                              > * = nullptr>
+    void connect(T *obj, Func func, Filter filter,
+                 ConnectionType type = ConnectionTypeAuto,
+                 ConnectionFlags flags = ConnectionFlag::NoOption)
     {
         Object *object = static_cast<Object *>(obj);
-        SignalBase::connect(new BoundMethodFunctor<T, void, Func, Args...>(obj, object, func, type));
+        auto *slot = new BoundMethodFunctor<T, void, Func, Args...>(obj, object, func, type, flags);
+        slot->setFilter(std::move(filter));
+        SignalBase::connect(slot);
     }
 
     template<typename T, typename Func,
@@ -162,8 +193,19 @@ public:
 		 * Make a copy of the slots list as the slot could call the
 		 * disconnect operation, invalidating the iterator.
 		 */
-        for (BoundMethodBase *slot : slots())
-            static_cast<BoundMethodArgs<void, Args...> *>(slot)->activate(args...);
+        for (BoundMethodBase *slot : slots()) {
+            auto *method = static_cast<BoundMethodArgs<void, Args...> *>(slot);
+
+            /*
+			 * Evaluate the connection filter in the emitter's
+			 * context, before packing the arguments for queued
+			 * invocations.
+			 */
+            if (!method->accept(args...))
+                continue;
+
+            method->activate(args...);
+        }
     }
 };
 
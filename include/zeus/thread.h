@@ -55,6 +55,7 @@ public:
     static pid_t currentId();
 
     EventDispatcher *eventDispatcher();
+    bool hasEventDispatcher() const;
 
     void dispatchMessages(Message::Type type = Message::Type::None);
 
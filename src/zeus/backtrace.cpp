@@ -40,9 +40,16 @@
 #include <libunwind.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <cxxabi.h>
+#include <iterator>
+#include <link.h>
 #include <sstream>
+#include <stddef.h>
+#include <unordered_map>
 
+#include <zeus/mutex.h>
 #include <zeus/span.h>
 #include <zeus/utils.h>
 
@@ -55,25 +62,77 @@ namespace zeus {
 
 namespace {
 
-#if HAVE_DW
-class DwflParser
+#if HAVE_DW || HAVE_BACKTRACE
+/*
+ * Retrieve the number of modules loaded and unloaded since the process
+ * started, to detect changes caused by dlopen() and dlclose().
+ */
+int moduleGeneration(struct dl_phdr_info *info, size_t size, void *data)
+{
+    auto *generation = static_cast<std::pair<unsigned long long, unsigned long long> *>(data);
+
+    if (size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs))
+        *generation = { info->dlpi_adds, info->dlpi_subs };
+
+    /* The counters are identical for all modules, stop at the first one. */
+    return 1;
+}
+
+/*
+ * Process-wide symbolizer. The module list and debug information are loaded
+ * once and reused, and resolved addresses are cached. The module list is
+ * reloaded when modules are loaded, and the cache is additionally cleared
+ * when modules are unloaded, as their addresses may then be reused.
+ */
+class Symbolizer
 {
 public:
-    DwflParser();
-    ~DwflParser();
+    static Symbolizer &instance();
 
-    bool isValid() const { return valid_; }
+    bool isValid() const;
     std::string stackEntry(const void *ip);
 
 private:
+    static constexpr size_t kMaxCacheSize = 4096;
+
+    Symbolizer();
+    ~Symbolizer();
+
+    void update() ZEUS_TSA_REQUIRES(mutex_);
+    std::string resolve(const void *ip) ZEUS_TSA_REQUIRES(mutex_);
+
+    Mutex mutex_;
+
+    std::pair<unsigned long long, unsigned long long> generation_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::unordered_map<const void *, std::string> cache_ ZEUS_TSA_GUARDED_BY(mutex_);
+
+#if HAVE_DW
+    bool report() ZEUS_TSA_REQUIRES(mutex_);
+
     Dwfl_Callbacks callbacks_;
     Dwfl *dwfl_;
-    bool valid_;
+    std::atomic<bool> valid_;
+#endif
 };
 
-DwflParser::DwflParser()
-        : callbacks_({}), dwfl_(nullptr), valid_(false)
+Symbolizer &Symbolizer::instance()
 {
+    static Symbolizer symbolizer;
+    return symbolizer;
+}
+
+Symbolizer::Symbolizer()
+        : generation_(0, 0)
+{
+    MutexLocker locker(mutex_);
+
+    dl_iterate_phdr(moduleGeneration, &generation_);
+
+#if HAVE_DW
+    callbacks_ = {};
+    dwfl_ = nullptr;
+    valid_ = false;
+
     callbacks_.find_elf = dwfl_linux_proc_find_elf;
     callbacks_.find_debuginfo = dwfl_standard_find_debuginfo;
 
@@ -81,70 +140,156 @@ DwflParser::DwflParser()
     if (!dwfl_)
         return;
 
+    valid_ = report();
+#endif
+}
+
+Symbolizer::~Symbolizer()
+{
+#if HAVE_DW
+    if (dwfl_)
+        dwfl_end(dwfl_);
+#endif
+}
+
+bool Symbolizer::isValid() const
+{
+#if HAVE_BACKTRACE
+    /* backtrace_symbols() is used as a fallback if libdw isn't usable. */
+    return true;
+#else
+    return valid_;
+#endif
+}
+
+#if HAVE_DW
+/*
+ * Report the modules of the process to libdwfl. Modules reported again are
+ * kept with their ELF and DWARF data, only new modules are loaded.
+ */
+bool Symbolizer::report()
+{
+    dwfl_report_begin(dwfl_);
+
     int ret = dwfl_linux_proc_report(dwfl_, getpid());
     if (ret)
-        return;
+        return false;
 
     ret = dwfl_report_end(dwfl_, nullptr, nullptr);
     if (ret)
-        return;
+        return false;
 
-    valid_ = true;
+    return true;
 }
+#endif
 
-DwflParser::~DwflParser()
+/*
+ * Refresh the module list if modules have been loaded or unloaded since the
+ * last update.
+ */
+void Symbolizer::update()
 {
+    std::pair<unsigned long long, unsigned long long> generation = generation_;
+    dl_iterate_phdr(moduleGeneration, &generation);
+
+    if (generation == generation_)
+        return;
+
+    if (generation.second != generation_.second)
+        cache_.clear();
+
+    generation_ = generation;
+
+#if HAVE_DW
     if (dwfl_)
-        dwfl_end(dwfl_);
+        valid_ = report();
+#endif
 }
 
-std::string DwflParser::stackEntry(const void *ip)
+/*
+ * Retrieve a human-readable description of an instruction pointer, including
+ * the symbol name and offset and the source location when available. This
+ * function is thread-safe.
+ */
+std::string Symbolizer::stackEntry(const void *ip)
 {
-    Dwarf_Addr addr = reinterpret_cast<Dwarf_Addr>(ip);
+    MutexLocker locker(mutex_);
 
-    Dwfl_Module *module = dwfl_addrmodule(dwfl_, addr);
-    if (!module)
-        return std::string();
+    update();
 
-    std::ostringstream entry;
+    auto it = cache_.find(ip);
+    if (it != cache_.end())
+        return it->second;
 
-    GElf_Off offset;
-    GElf_Sym sym;
-    const char *symbol = dwfl_module_addrinfo(module, addr, &offset, &sym,
-                                              nullptr, nullptr, nullptr);
-    if (symbol) {
-        char *name = abi::__cxa_demangle(symbol, nullptr, nullptr, nullptr);
-        entry << (name ? name : symbol) << "+0x" << std::hex << offset
-              << std::dec;
-        free(name);
-    } else {
-        entry << "??? [" << utils::hex(addr) << "]";
-    }
+    if (cache_.size() >= kMaxCacheSize)
+        cache_.clear();
 
-    entry << " (";
+    return cache_.emplace(ip, resolve(ip)).first->second;
+}
 
-    Dwfl_Line *line = dwfl_module_getsrc(module, addr);
-    if (line) {
-        const char *filename;
-        int lineNumber = 0;
+std::string Symbolizer::resolve(const void *ip)
+{
+#if HAVE_DW
+    if (valid_) {
+        Dwarf_Addr addr = reinterpret_cast<Dwarf_Addr>(ip);
 
-        filename = dwfl_lineinfo(line, &addr, &lineNumber, nullptr,
-                                 nullptr, nullptr);
+        Dwfl_Module *module = dwfl_addrmodule(dwfl_, addr);
+        if (!module)
+            return std::string();
 
-        entry << (filename ? filename : "???") << ":" << lineNumber;
-    } else {
-        const char *filename = nullptr;
+        std::ostringstream entry;
 
-        dwfl_module_info(module, nullptr, nullptr, nullptr, nullptr,
-                         nullptr, &filename, nullptr);
+        GElf_Off offset;
+        GElf_Sym sym;
+        const char *symbol = dwfl_module_addrinfo(module, addr, &offset, &sym,
+                                                  nullptr, nullptr, nullptr);
+        if (symbol) {
+            char *name = abi::__cxa_demangle(symbol, nullptr, nullptr, nullptr);
+            entry << (name ? name : symbol) << "+0x" << std::hex << offset
+                  << std::dec;
+            free(name);
+        } else {
+            entry << "??? [" << utils::hex(addr) << "]";
+        }
+
+        entry << " (";
+
+        Dwfl_Line *line = dwfl_module_getsrc(module, addr);
+        if (line) {
+            const char *filename;
+            int lineNumber = 0;
+
+            filename = dwfl_lineinfo(line, &addr, &lineNumber, nullptr,
+                                     nullptr, nullptr);
+
+            entry << (filename ? filename : "???") << ":" << lineNumber;
+        } else {
+            const char *filename = nullptr;
+
+            dwfl_module_info(module, nullptr, nullptr, nullptr, nullptr,
+                             nullptr, &filename, nullptr);
+
+            entry << (filename ? filename : "???") << " [" << utils::hex(addr) << "]";
+        }
+
+        entry << ")";
+        return entry.str();
+    }
+#endif
 
-        entry << (filename ? filename : "???") << " [" << utils::hex(addr) << "]";
+#if HAVE_BACKTRACE
+    void *const addresses[] = { const_cast<void *>(ip) };
+    char **strings = backtrace_symbols(addresses, 1);
+    if (strings) {
+        std::string entry = strings[0];
+        free(strings);
+        return entry;
     }
+#endif
 
-    entry << ")";
-    return entry.str();
+    return "???";
 }
-#endif /* HAVE_DW */
+#endif /* HAVE_DW || HAVE_BACKTRACE */
 
 } /* namespace */
 
@@ -284,6 +429,11 @@ __attribute__((__noinline__)) bool Backtrace::unwindTrace()
  * of the Backtrace instance from the call stack. The Backtrace constructor
  * itself is automatically skipped and never shown in the backtrace.
  *
+ * Symbols are resolved by a symbolizer shared by all backtraces. It loads the
+ * module list and debug information once, reloads them when modules are
+ * loaded or unloaded, and caches resolved addresses. Only the first backtrace
+ * pays the cost of loading symbols.
+ *
  * If backtrace generation fails for any reason (usually because the platform
  * doesn't support this feature), an empty string is returned.
  *
@@ -307,16 +457,16 @@ std::string Backtrace::toString(unsigned int skipLevels) const
         return utils::join(trace.subspan(skipLevels), "");
     }
 
-#if HAVE_DW
-    DwflParser dwfl;
+#if HAVE_DW || HAVE_BACKTRACE
+    Symbolizer &symbolizer = Symbolizer::instance();
 
-    if (dwfl.isValid()) {
+    if (symbolizer.isValid()) {
         std::ostringstream msg;
 
         Span<void *const> trace{ backtrace_ };
         for (const void *ip : trace.subspan(skipLevels)) {
             if (ip)
-                msg << dwfl.stackEntry(ip) << std::endl;
+                msg << symbolizer.stackEntry(ip) << std::endl;
             else
                 msg << "???" << std::endl;
         }
@@ -325,23 +475,65 @@ std::string Backtrace::toString(unsigned int skipLevels) const
     }
 #endif
 
-#if HAVE_BACKTRACE
-    Span<void *const> trace{ backtrace_ };
-    trace = trace.subspan(skipLevels);
+    return std::string();
+}
 
-    char **strings = backtrace_symbols(trace.data(), trace.size());
-    if (strings) {
-        std::ostringstream msg;
+/**
+ * \brief Capture the call stack as raw instruction pointers
+ * \param[out] addresses The array to store the instruction pointers in
+ * \param[in] size The size of the \a addresses array
+ *
+ * This function captures the instruction pointers of the current call stack,
+ * starting with the caller of this function, without resolving any symbol.
+ * It is meant to be used in contexts where constructing a Backtrace isn't
+ * possible, such as signal handlers.
+ *
+ * With the backtrace() backend, the first call may load the unwinder library
+ * and allocate memory. Callers that need async-signal safety shall call this
+ * function once beforehand outside of signal context.
+ *
+ * \context This function is async-signal-safe.
+ *
+ * \return The number of instruction pointers stored in \a addresses
+ */
+__attribute__((__noinline__)) unsigned int Backtrace::capture(void **addresses,
+                                                             unsigned int size)
+{
+#if HAVE_UNWIND
+    unw_context_t uc;
+    unw_cursor_t cursor;
 
-        for (unsigned int i = 0; i < trace.size(); ++i)
-            msg << strings[i] << std::endl;
+    if (unw_getcontext(&uc) || unw_init_local(&cursor, &uc))
+        return 0;
 
-        free(strings);
-        return msg.str();
+    unsigned int count = 0;
+
+    /* Skip the frame of this function. */
+    while (count < size && unw_step(&cursor) > 0) {
+        unw_word_t ip;
+        if (unw_get_reg(&cursor, UNW_REG_IP, &ip))
+            break;
+
+        addresses[count++] = reinterpret_cast<void *>(ip);
     }
-#endif
 
-    return std::string();
+    return count;
+#elif HAVE_BACKTRACE
+    void *trace[128];
+    unsigned int max = std::min<unsigned int>(size + 1, std::size(trace));
+
+    int count = backtrace(trace, max);
+    if (count <= 1)
+        return 0;
+
+    /* Skip the frame of this function. */
+    std::copy(trace + 1, trace + count, addresses);
+    return count - 1;
+#else
+    (void)addresses;
+    (void)size;
+    return 0;
+#endif
 }
 
 } /* namespace zeus */
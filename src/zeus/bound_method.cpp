@@ -20,6 +20,7 @@
 
 #include <zeus/bound_method.h>
 #include <zeus/message.h>
+#include <zeus/mutex.h>
 #include <zeus/semaphore.h>
 #include <zeus/thread.h>
 
@@ -30,6 +31,18 @@
 
 namespace zeus {
 
+namespace {
+
+/*
+ * Mutex to protect, for coalesced connections, the BoundMethodBase
+ * pendingMessage_ pointer and invocation state, and the method and pack of the
+ * pending InvokeMessage. Only connections created with ConnectionFlag::Coalesce
+ * take the lock.
+ */
+Mutex coalesceLock;
+
+} /* namespace */
+
 /**
  * \enum ConnectionType
  * \brief Connection type for asynchronous communication
@@ -62,6 +75,73 @@ namespace zeus {
  * blocks until the receiver signals the completion of the invocation.
  */
 
+/**
+ * \enum ConnectionFlag
+ * \brief Options for asynchronous communication
+ *
+ * \var ConnectionFlag::NoOption
+ * \brief No option (used as default value)
+ *
+ * \var ConnectionFlag::Coalesce
+ * \brief Coalesce queued invocations, keeping the latest arguments only
+ *
+ * When a queued invocation is requested while a previous queued invocation of
+ * the same bound method is still pending in the receiver's message queue, the
+ * arguments of the pending invocation are replaced with the new arguments
+ * instead of posting a new message. The receiver thus only processes the
+ * freshest values, and the number of pending messages for the connection is
+ * bounded to one.
+ *
+ * The flag only affects invocations that are queued, direct and blocking
+ * invocations are performed unchanged.
+ */
+
+/**
+ * \typedef ConnectionFlags
+ * \brief A bitwise combination of ConnectionFlag values
+ */
+
+BoundMethodBase::~BoundMethodBase()
+{
+    if (!(connectionFlags_ & ConnectionFlag::Coalesce))
+        return;
+
+    /*
+	 * Detach the pending message, if any, to prevent it from accessing
+	 * the bound method when it gets delivered or destroyed.
+	 */
+    MutexLocker locker(coalesceLock);
+    if (pendingMessage_)
+        pendingMessage_->method_ = nullptr;
+}
+
+/**
+ * \brief Destroy the bound method
+ *
+ * Bound methods of coalesced connections may be destroyed while their slot is
+ * being invoked from the receiver's thread, when the connection is removed
+ * from another thread or from within the slot. Destruction is then deferred
+ * until the invocation completes. Other bound methods are deleted immediately.
+ */
+void BoundMethodBase::destroy()
+{
+    if (connectionFlags_ & ConnectionFlag::Coalesce) {
+        MutexLocker locker(coalesceLock);
+
+        if (pendingMessage_) {
+            pendingMessage_->method_ = nullptr;
+            pendingMessage_ = nullptr;
+        }
+
+        if (invoking_) {
+            destroyed_ = true;
+            return;
+        }
+    }
+
+    delete this;
+}
+
 /**
  * \brief Invoke the bound method with packed arguments
  * \param[in] pack Packed arguments
@@ -100,8 +180,28 @@ bool BoundMethodBase::activatePack(std::shared_ptr<BoundMethodPackBase> pack,
         return true;
 
     case ConnectionTypeQueued: {
-        std::unique_ptr<Message> msg =
-                std::make_unique<InvokeMessage>(this, pack, nullptr, deleteMethod);
+        std::unique_ptr<InvokeMessage> msg;
+
+        if (connectionFlags_ & ConnectionFlag::Coalesce) {
+            MutexLocker locker(coalesceLock);
+
+            /*
+			 * Replace the arguments of the pending invocation. The
+			 * previous arguments are released when pack goes out of
+			 * scope, after the lock is released.
+			 */
+            if (pendingMessage_) {
+                pendingMessage_->pack_.swap(pack);
+                return false;
+            }
+
+            msg = std::make_unique<InvokeMessage>(this, pack, nullptr, deleteMethod);
+            msg->coalesced_ = true;
+            pendingMessage_ = msg.get();
+        } else {
+            msg = std::make_unique<InvokeMessage>(this, pack, nullptr, deleteMethod);
+        }
+
         object_->postMessage(std::move(msg));
         return false;
     }
@@ -119,4 +219,57 @@ bool BoundMethodBase::activatePack(std::shared_ptr<BoundMethodPackBase> pack,
     }
 }
 
+/*
+ * Deliver a coalesced invocation message. The message is detached from the
+ * bound method before invocation, subsequent invocations are then queued in a
+ * new message and don't modify the arguments being processed. The bound method
+ * is kept alive until the invocation completes.
+ */
+void BoundMethodBase::invokeMessage(InvokeMessage *msg)
+{
+    BoundMethodBase *method;
+    std::shared_ptr<BoundMethodPackBase> pack;
+
+    {
+        MutexLocker locker(coalesceLock);
+
+        method = msg->method_;
+        if (!method)
+            return;
+
+        if (method->pendingMessage_ == msg)
+            method->pendingMessage_ = nullptr;
+
+        msg->method_ = nullptr;
+        pack = std::move(msg->pack_);
+        method->invoking_++;
+    }
+
+    method->invokePack(pack.get());
+
+    {
+        MutexLocker locker(coalesceLock);
+
+        if (--method->invoking_ || !method->destroyed_)
+            return;
+    }
+
+    delete method;
+}
+
+/*
+ * Release a coalesced invocation message when it is destroyed without being
+ * delivered.
+ */
+void BoundMethodBase::releaseMessage(InvokeMessage *msg)
+{
+    MutexLocker locker(coalesceLock);
+
+    BoundMethodBase *method = msg->method_;
+    if (method && method->pendingMessage_ == msg)
+        method->pendingMessage_ = nullptr;
+
+    msg->method_ = nullptr;
+}
+
 } /* namespace zeus */
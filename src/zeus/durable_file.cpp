@@ -0,0 +1,566 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: durable_file.cpp - Atomic file replacement and group-commit append log
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zeus/durable_file.h>
+#include <zeus/log.h>
+#include <zeus/object.h>
+#include <zeus/thread.h>
+#include <zeus/utils.h>
+
+/**
+ * \file durable_file.h
+ * \brief Atomic file replacement and group-commit append log
+ */
+
+namespace zeus {
+
+LOG_DEFINE_CATEGORY(DurableFile)
+
+namespace {
+
+/*
+ * Synchronize a directory to storage, to make the creation, rename or removal
+ * of its entries durable.
+ */
+int syncDirectory(const std::string &path)
+{
+    UniqueFD fd(::open(utils::dirname(path).c_str(),
+                       O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (!fd.isValid())
+        return -errno;
+
+    if (fsync(fd.get()) < 0)
+        return -errno;
+
+    return 0;
+}
+
+ssize_t writeAll(int fd, const Span<const uint8_t> &data)
+{
+    size_t written = 0;
+
+    /* Retry in case of partial writes. */
+    while (written < data.size()) {
+        ssize_t ret = ::write(fd, data.data() + written, data.size() - written);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+
+        written += ret;
+    }
+
+    return written;
+}
+
+} /* namespace */
+
+/**
+ * \class AtomicFile
+ * \brief Replace the contents of a file atomically and durably
+ *
+ * The AtomicFile class writes new contents for a file to an anonymous
+ * temporary file, created with O_TMPFILE in the same directory, and replaces
+ * the target file in a single step when the contents are committed. Readers
+ * see either the old or the new contents, never a partial file, and the new
+ * contents survive a system crash once commit() returns.
+ *
+ * If the file system doesn't support O_TMPFILE, a named temporary file is
+ * used instead, and removed if the contents are discarded.
+ */
+
+/**
+ * \brief Construct an AtomicFile for the file \a name
+ * \param[in] name The name of the file to replace
+ */
+AtomicFile::AtomicFile(const std::string &name)
+        : name_(name)
+{
+}
+
+/**
+ * \brief Destroy the AtomicFile, discarding uncommitted contents
+ */
+AtomicFile::~AtomicFile()
+{
+    discard();
+}
+
+/**
+ * \fn AtomicFile::fileName()
+ * \brief Retrieve the name of the file to replace
+ * \return The file name
+ */
+
+/**
+ * \brief Create the temporary file for the new contents
+ * \param[in] mode The permissions of the new file, modified by the umask
+ * \return 0 on success, or a negative error code otherwise
+ */
+int AtomicFile::open(mode_t mode)
+{
+    if (isOpen())
+        return -EBUSY;
+
+    std::string dir = utils::dirname(name_);
+
+    fd_ = UniqueFD(::open(dir.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, mode));
+    if (fd_.isValid())
+        return 0;
+
+    if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+        return -errno;
+
+    /* Fall back to a named temporary file. */
+    std::string tmpName = name_ + ".XXXXXX";
+    fd_ = UniqueFD(mkostemp(tmpName.data(), O_CLOEXEC));
+    if (!fd_.isValid())
+        return -errno;
+
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd_.get(), mode & ~mask);
+
+    tmpName_ = std::move(tmpName);
+    return 0;
+}
+
+/**
+ * \fn AtomicFile::isOpen()
+ * \brief Check if the temporary file has been created
+ * \return True if the temporary file is open, false otherwise
+ */
+
+/**
+ * \brief Write data to the new contents
+ * \param[in] data The data to write
+ * \return The number of bytes written on success, or a negative error code
+ * otherwise
+ */
+ssize_t AtomicFile::write(const Span<const uint8_t> &data)
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    return writeAll(fd_.get(), data);
+}
+
+/**
+ * \brief Commit the new contents
+ *
+ * Synchronize the new contents to storage, replace the target file with them,
+ * and synchronize the directory. The AtomicFile is closed.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int AtomicFile::commit()
+{
+    static std::atomic<unsigned int> counter = 0;
+
+    if (!isOpen())
+        return -EINVAL;
+
+    if (fdatasync(fd_.get()) < 0)
+        return -errno;
+
+    if (tmpName_.empty()) {
+        /*
+		 * Give the anonymous file a temporary name. Linking through
+		 * /proc doesn't require the CAP_DAC_READ_SEARCH capability
+		 * that AT_EMPTY_PATH needs. The target can't be linked
+		 * directly as linkat() doesn't replace existing files.
+		 */
+        std::string source = "/proc/self/fd/" + std::to_string(fd_.get());
+        std::string tmpName = name_ + ".tmp" + std::to_string(getpid()) +
+                              "." + std::to_string(counter++);
+
+        if (linkat(AT_FDCWD, source.c_str(), AT_FDCWD, tmpName.c_str(),
+                   AT_SYMLINK_FOLLOW) < 0)
+            return -errno;
+
+        tmpName_ = std::move(tmpName);
+    }
+
+    if (rename(tmpName_.c_str(), name_.c_str()) < 0)
+        return -errno;
+
+    tmpName_.clear();
+    fd_.reset();
+
+    return syncDirectory(name_);
+}
+
+/**
+ * \brief Discard the new contents
+ *
+ * The target file is left untouched. Discarding is a no-op if the AtomicFile
+ * isn't open.
+ */
+void AtomicFile::discard()
+{
+    if (!tmpName_.empty()) {
+        unlink(tmpName_.c_str());
+        tmpName_.clear();
+    }
+
+    fd_.reset();
+}
+
+/**
+ * \brief Replace the contents of a file atomically and durably
+ * \param[in] name The name of the file to replace
+ * \param[in] data The new contents
+ * \param[in] mode The permissions of the new file, modified by the umask
+ * \return 0 on success, or a negative error code otherwise
+ */
+int AtomicFile::replace(const std::string &name,
+                        const Span<const uint8_t> &data, mode_t mode)
+{
+    AtomicFile file(name);
+
+    int ret = file.open(mode);
+    if (ret < 0)
+        return ret;
+
+    ssize_t written = file.write(data);
+    if (written < 0)
+        return written;
+
+    return file.commit();
+}
+
+/*
+ * State shared between a DurableLog and its pending requests, which may be
+ * delivered after the log has been destroyed.
+ */
+class DurableLogState
+{
+public:
+    DurableLogState(DurableLog *log)
+        : log(log)
+    {
+    }
+
+    Mutex mutex;
+    DurableLog *log ZEUS_TSA_GUARDED_BY(mutex);
+};
+
+/*
+ * A record waiting to be committed. The request is bound to the thread that
+ * appended the record, the commit thread completes it by invoking deliver()
+ * in that thread.
+ */
+class DurableLogRequest : public Object
+{
+public:
+    DurableLogRequest(std::shared_ptr<DurableLogState> state, uint64_t id)
+        : state_(std::move(state)), id_(id)
+    {
+    }
+
+    void complete(int result)
+    {
+        invokeMethod(&DurableLogRequest::deliver, ConnectionTypeQueued, result);
+    }
+
+private:
+    void deliver(int result)
+    {
+        {
+            MutexLocker locker(state_->mutex);
+            if (state_->log)
+                state_->log->committed.emit(id_, result);
+        }
+
+        delete this;
+    }
+
+    std::shared_ptr<DurableLogState> state_;
+    uint64_t id_;
+};
+
+/* The commit thread of a DurableLog. */
+class DurableLogThread : public Thread
+{
+public:
+    DurableLogThread(DurableLog *log)
+        : log_(log)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        log_->run();
+    }
+
+private:
+    DurableLog *log_;
+};
+
+/**
+ * \class DurableLog
+ * \brief Append-only log with group commit
+ *
+ * The DurableLog class appends records to a file and makes them durable with
+ * fdatasync(). Records appended concurrently, from any number of threads, are
+ * committed together with a single fdatasync() call by a commit thread: while
+ * a commit is in progress, new records accumulate and are committed by the
+ * next one. This amortizes the cost of synchronization over all writers.
+ *
+ * append() writes the record to the file and returns immediately. Commit
+ * completion is reported through the \ref committed signal, emitted in the
+ * thread that appended the record, which shall run an event loop. Threads
+ * without an event dispatcher don't receive the signal, and can wait for
+ * commits with flush().
+ *
+ * If fdatasync() fails, the state of the data in the file is unknown. The
+ * error is then reported for all pending records, and all subsequent appends
+ * fail with the same error.
+ */
+
+/**
+ * \brief Construct a DurableLog for the file \a name
+ * \param[in] name The log file name
+ */
+DurableLog::DurableLog(const std::string &name)
+        : name_(name), state_(std::make_shared<DurableLogState>(this)),
+          nextId_(1), appended_(0), synced_(0), error_(0), stop_(false),
+          thread_(std::make_unique<DurableLogThread>(this))
+{
+}
+
+/**
+ * \brief Destroy the DurableLog
+ *
+ * The log is closed, waiting for pending records to be committed. Their
+ * \ref committed signal isn't emitted.
+ */
+DurableLog::~DurableLog()
+{
+    close();
+
+    MutexLocker locker(state_->mutex);
+    state_->log = nullptr;
+}
+
+/**
+ * \fn DurableLog::fileName()
+ * \brief Retrieve the log file name
+ * \return The log file name
+ */
+
+/**
+ * \brief Open the log file
+ *
+ * The file is created if it doesn't exist, in which case the creation is made
+ * durable before the function returns. Records are appended to the existing
+ * contents.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int DurableLog::open()
+{
+    if (isOpen())
+        return -EBUSY;
+
+    int flags = O_WRONLY | O_APPEND | O_CLOEXEC;
+    bool created = true;
+
+    fd_ = UniqueFD(::open(name_.c_str(), flags | O_CREAT | O_EXCL, 0666));
+    if (!fd_.isValid() && errno == EEXIST) {
+        fd_ = UniqueFD(::open(name_.c_str(), flags));
+        created = false;
+    }
+
+    if (!fd_.isValid())
+        return -errno;
+
+    if (created) {
+        int ret = syncDirectory(name_);
+        if (ret < 0) {
+            LOG(DurableFile, Error)
+                    << "Failed to sync directory of " << name_ << ": "
+                    << strerror(-ret);
+            fd_.reset();
+            return ret;
+        }
+    }
+
+    {
+        MutexLocker locker(mutex_);
+        error_ = 0;
+        stop_ = false;
+    }
+
+    thread_->start();
+    return 0;
+}
+
+/**
+ * \fn DurableLog::isOpen()
+ * \brief Check if the log is open
+ * \return True if the log is open, false otherwise
+ */
+
+/**
+ * \brief Close the log
+ *
+ * Pending records are committed before the file is closed.
+ */
+void DurableLog::close()
+{
+    if (!isOpen())
+        return;
+
+    {
+        MutexLocker locker(mutex_);
+        stop_ = true;
+    }
+
+    cv_.notify_all();
+    thread_->wait();
+
+    fd_.reset();
+}
+
+/**
+ * \brief Append a record to the log
+ * \param[in] record The record data
+ *
+ * The record is written to the file and queued for the next commit. The
+ * \ref committed signal is emitted with the returned identifier once the
+ * record is durable, or if the commit fails.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return A positive record identifier on success, or a negative error code
+ * otherwise
+ */
+int64_t DurableLog::append(const Span<const uint8_t> &record)
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    uint64_t id = nextId_.fetch_add(1, std::memory_order_relaxed);
+
+    /*
+	 * Completion is delivered through the message queue of the appending
+	 * thread. Skip it for threads without an event dispatcher, where the
+	 * message would never be processed.
+	 */
+    std::unique_ptr<DurableLogRequest> request;
+    if (Thread::current()->hasEventDispatcher())
+        request = std::make_unique<DurableLogRequest>(state_, id);
+
+    MutexLocker locker(mutex_);
+
+    if (error_)
+        return error_;
+
+    /* A partially written record corrupts the log, stop appending. */
+    ssize_t ret = writeAll(fd_.get(), record);
+    if (ret < 0) {
+        error_ = ret;
+        return ret;
+    }
+
+    if (request)
+        pending_.push_back(request.release());
+    appended_++;
+
+    cv_.notify_all();
+    return id;
+}
+
+/**
+ * \brief Wait for all appended records to be committed
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success, or a negative error code if a commit failed
+ */
+int DurableLog::flush()
+{
+    MutexLocker locker(mutex_);
+
+    uint64_t target = appended_;
+    cv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) {
+        return synced_ >= target || error_;
+    });
+
+    return error_;
+}
+
+/**
+ * \var DurableLog::committed
+ * \brief Signal emitted when a record has been committed
+ *
+ * The signal is emitted in the thread that appended the record, with the
+ * record identifier returned by append() and the commit result, 0 on success
+ * or a negative error code otherwise. Slots shall not destroy the log.
+ */
+
+void DurableLog::run()
+{
+    MutexLocker locker(mutex_);
+
+    while (true) {
+        cv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) {
+            return stop_ || synced_ != appended_;
+        });
+
+        if (synced_ == appended_)
+            break;
+
+        /* Commit all records appended so far with a single sync. */
+        uint64_t appended = appended_;
+        std::vector<DurableLogRequest *> batch;
+        batch.swap(pending_);
+
+        locker.unlock();
+
+        int ret = fdatasync(fd_.get()) < 0 ? -errno : 0;
+        if (ret < 0)
+            LOG(DurableFile, Error)
+                    << "Failed to commit " << name_ << ": " << strerror(-ret);
+
+        for (DurableLogRequest *request : batch)
+            request->complete(ret);
+
+        locker.lock();
+
+        if (ret < 0 && !error_)
+            error_ = ret;
+
+        synced_ = appended;
+        cv_.notify_all();
+    }
+}
+
+} /* namespace zeus */
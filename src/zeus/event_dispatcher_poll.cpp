@@ -281,7 +281,7 @@ void EventDispatcherPoll::processNotifiers(const std::vector<struct pollfd> &pol
 			 * notifier immediately.
 			 */
             if (pfd.revents & POLLNVAL) {
-                LOG(Event, Warning)
+                LOG_RATE_LIMITED(Event, Warning, 10)
                         << "Disabling " << notifierType(event.type)
                         << " due to invalid file descriptor "
                         << pfd.fd;
@@ -0,0 +1,294 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: fd_cache.cpp - LRU cache of open file descriptors
+//
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <zeus/fd_cache.h>
+#include <zeus/unique_fd.h>
+
+/**
+ * \file fd_cache.h
+ * \brief LRU cache of open file descriptors
+ */
+
+namespace zeus {
+
+/**
+ * \class FdCache
+ * \brief Cache open file descriptors by path
+ *
+ * The FdCache class keeps recently used files open, to save the cost of the
+ * open() and close() system calls and of the path lookup when the same files
+ * are accessed repeatedly. Descriptors are cached per path and open mode, and
+ * returned as SharedFD instances. A File can be constructed from a cached
+ * descriptor with File::File(const SharedFD &, const std::string &).
+ *
+ * The cache holds up to capacity() descriptors, and evicts the least recently
+ * used one when full. Evicted descriptors are closed when the last SharedFD
+ * referencing them is destroyed.
+ *
+ * A cached descriptor keeps referring to the file it was opened on, even if the
+ * file is later deleted or replaced. Users shall invalidate the path when this
+ * happens, for instance by connecting a FileWatcher to the cache:
+ *
+ * \code{.cpp}
+ * watcher.deleted.connect(&cache, &FdCache::invalidate);
+ * watcher.created.connect(&cache, &FdCache::invalidate);
+ * watcher.moved.connect(&cache, &FdCache::invalidate);
+ * \endcode
+ *
+ * Atomic replacement of a file, as done by AtomicFile, is reported by the
+ * FileWatcher::moved signal. Paths are compared as strings, the files shall
+ * thus be spelled identically when added to the watcher and looked up in the
+ * cache.
+ *
+ * \context This class is \threadsafe.
+ */
+
+/**
+ * \var FdCache::kDefaultCapacity
+ * \brief The default maximum number of cached descriptors
+ */
+
+/**
+ * \struct FdCache::Statistics
+ * \brief Cache usage statistics
+ * \var FdCache::Statistics::hits
+ * \brief The number of lookups served from the cache
+ * \var FdCache::Statistics::misses
+ * \brief The number of lookups that opened the file
+ * \var FdCache::Statistics::evictions
+ * \brief The number of descriptors evicted to honour the capacity
+ * \var FdCache::Statistics::invalidations
+ * \brief The number of descriptors removed by invalidate() or clear()
+ */
+
+/**
+ * \brief Construct an FdCache
+ * \param[in] capacity The maximum number of cached descriptors
+ */
+FdCache::FdCache(size_t capacity)
+        : capacity_(capacity), stats_{}, generation_(0)
+{
+}
+
+FdCache::~FdCache()
+{
+}
+
+/**
+ * \brief Retrieve a descriptor for a file
+ * \param[in] path The file path
+ * \param[out] fd The file descriptor
+ * \param[in] mode The open mode
+ *
+ * Return the cached descriptor for \a path and \a mode if available, or open
+ * the file and add its descriptor to the cache otherwise. Files are opened
+ * with the same flags as File::open(). The file is opened without holding the
+ * cache lock, concurrent lookups are thus not blocked by slow file systems. If
+ * the cache is invalidated while the file is being opened, the descriptor is
+ * returned but not cached, as it may refer to the file being replaced.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FdCache::get(const std::string &path, SharedFD *fd, File::OpenMode mode)
+{
+    if (!(mode & File::OpenModeFlag::ReadWrite))
+        return -EINVAL;
+
+    Key key{ path, static_cast<File::OpenMode::Type>(mode) };
+    uint64_t generation;
+
+    {
+        MutexLocker locker(mutex_);
+
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            stats_.hits++;
+            *fd = it->second->fd;
+            return 0;
+        }
+
+        stats_.misses++;
+        generation = generation_;
+    }
+
+    int flags = static_cast<File::OpenMode::Type>(mode & File::OpenModeFlag::ReadWrite) - 1;
+    if (mode & File::OpenModeFlag::WriteOnly)
+        flags |= O_CREAT;
+
+    UniqueFD file;
+    if (mode & File::OpenModeFlag::Direct)
+        file = UniqueFD(::open(path.c_str(), flags | O_CLOEXEC | O_DIRECT, 0666));
+    if (!file.isValid())
+        file = UniqueFD(::open(path.c_str(), flags | O_CLOEXEC, 0666));
+    if (!file.isValid())
+        return -errno;
+
+    SharedFD shared(std::move(file));
+
+    /* Close evicted descriptors after releasing the lock. */
+    std::list<Entry> evicted;
+    MutexLocker locker(mutex_);
+
+    /* Another thread may have opened the file concurrently, use its descriptor. */
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        entries_.splice(entries_.begin(), entries_, it->second);
+        *fd = it->second->fd;
+        return 0;
+    }
+
+    *fd = shared;
+
+    if (capacity_ && generation == generation_) {
+        entries_.push_front({ key, std::move(shared) });
+        index_[key] = entries_.begin();
+        evict(&evicted);
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Remove the descriptors of a file from the cache
+ * \param[in] path The file path
+ *
+ * Remove the descriptors cached for \a path in all open modes. This function
+ * shall be called when the file is deleted, replaced or renamed, for the next
+ * lookup to open the new file.
+ */
+void FdCache::invalidate(const std::string &path)
+{
+    std::list<Entry> evicted;
+    MutexLocker locker(mutex_);
+
+    generation_++;
+
+    auto it = index_.lower_bound({ path, 0 });
+    while (it != index_.end() && it->first.first == path) {
+        evicted.splice(evicted.end(), entries_, it->second);
+        it = index_.erase(it);
+        stats_.invalidations++;
+    }
+}
+
+/**
+ * \brief Remove the descriptors of a renamed file from the cache
+ * \param[in] oldPath The old file path
+ * \param[in] newPath The new file path
+ *
+ * Remove the descriptors cached for both \a oldPath and \a newPath, as
+ * invalidate(const std::string &) would. This overload matches the
+ * FileWatcher::moved signal, for renames that replace a file.
+ */
+void FdCache::invalidate(const std::string &oldPath, const std::string &newPath)
+{
+    invalidate(oldPath);
+    invalidate(newPath);
+}
+
+/**
+ * \brief Remove all descriptors from the cache
+ */
+void FdCache::clear()
+{
+    std::list<Entry> evicted;
+    MutexLocker locker(mutex_);
+
+    generation_++;
+    stats_.invalidations += entries_.size();
+    evicted.swap(entries_);
+    index_.clear();
+}
+
+/**
+ * \brief Retrieve the maximum number of cached descriptors
+ * \return The cache capacity
+ */
+size_t FdCache::capacity() const
+{
+    MutexLocker locker(mutex_);
+    return capacity_;
+}
+
+/**
+ * \brief Set the maximum number of cached descriptors
+ * \param[in] capacity The cache capacity
+ *
+ * The least recently used descriptors are evicted if the cache holds more than
+ * \a capacity descriptors. A capacity of 0 disables caching.
+ */
+void FdCache::setCapacity(size_t capacity)
+{
+    std::list<Entry> evicted;
+    MutexLocker locker(mutex_);
+
+    capacity_ = capacity;
+    evict(&evicted);
+}
+
+/**
+ * \brief Retrieve the number of cached descriptors
+ * \return The number of cached descriptors
+ */
+size_t FdCache::size() const
+{
+    MutexLocker locker(mutex_);
+    return entries_.size();
+}
+
+/**
+ * \brief Retrieve the cache usage statistics
+ * \return The statistics accumulated since construction or the last call to
+ * resetStatistics()
+ */
+FdCache::Statistics FdCache::statistics() const
+{
+    MutexLocker locker(mutex_);
+    return stats_;
+}
+
+/**
+ * \brief Reset the cache usage statistics
+ */
+void FdCache::resetStatistics()
+{
+    MutexLocker locker(mutex_);
+    stats_ = {};
+}
+
+/*
+ * Move the least recently used entries in excess of the capacity to
+ * \a evicted, for the caller to close them without holding the lock.
+ */
+void FdCache::evict(std::list<Entry> *evicted)
+{
+    while (entries_.size() > capacity_) {
+        auto last = std::prev(entries_.end());
+        index_.erase(last->key);
+        evicted->splice(evicted->end(), entries_, last);
+        stats_.evictions++;
+    }
+}
+
+} /* namespace zeus */
@@ -0,0 +1,231 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: fd_pump.cpp - Zero-copy data pump between file descriptors
+//
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zeus/event_notifier.h>
+#include <zeus/fd_pump.h>
+#include <zeus/log.h>
+
+/**
+ * \file fd_pump.h
+ * \brief Zero-copy data pump between file descriptors
+ */
+
+namespace zeus {
+
+LOG_DEFINE_CATEGORY(FdPump)
+
+/**
+ * \class FdPump
+ * \brief Transfer data between file descriptors from the event loop
+ *
+ * The FdPump class moves data from an input file descriptor to an output file
+ * descriptor without copying it to user space. Data is spliced from the input
+ * to an internal pipe, and from the pipe to the output, with splice(). The
+ * pump is driven by EventNotifier instances, and waits in the event loop of
+ * its thread when the input has no data available or the output can't accept
+ * more data.
+ *
+ * The file descriptors are not owned by the pump and must stay valid while it
+ * runs. Sockets and pipes shall be set to non-blocking mode, otherwise the
+ * pump blocks the event loop. Regular files are supported as input, in which
+ * case data is read from the current position of the file.
+ *
+ * The pump is started with start(), and emits the \ref finished signal when
+ * the requested amount of data has been transferred, the end of the input is
+ * reached, or an error occurs.
+ */
+
+/**
+ * \brief Construct a pump between two file descriptors
+ * \param[in] in The input file descriptor
+ * \param[in] out The output file descriptor
+ * \param[in] parent The parent Object
+ */
+FdPump::FdPump(int in, int out, Object *parent)
+        : Object(parent), in_(in), out_(out), pipeSize_(0), running_(false),
+          toRead_(0), buffered_(0), transferred_(0)
+{
+    inNotifier_ = std::make_unique<EventNotifier>(in_, EventNotifier::Read, this);
+    inNotifier_->setEnabled(false);
+    inNotifier_->activated.connect(this, &FdPump::pump);
+
+    outNotifier_ = std::make_unique<EventNotifier>(out_, EventNotifier::Write, this);
+    outNotifier_->setEnabled(false);
+    outNotifier_->activated.connect(this, &FdPump::pump);
+}
+
+FdPump::~FdPump()
+{
+    stop();
+}
+
+/**
+ * \brief Start transferring data
+ * \param[in] size The maximum number of bytes to transfer
+ *
+ * Start transferring up to \a size bytes from the input to the output. The
+ * transfer starts when control returns to the event loop of the pump's thread.
+ * By default, data is transferred until the end of the input.
+ *
+ * \context This function is \threadbound.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FdPump::start(uint64_t size)
+{
+    if (running_)
+        return -EBUSY;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0) {
+        int ret = -errno;
+        LOG(FdPump, Error) << "Failed to create pipe: " << strerror(-ret);
+        return ret;
+    }
+
+    pipeOut_ = UniqueFD(fds[0]);
+    pipeIn_ = UniqueFD(fds[1]);
+
+    /* Enlarge the pipe to reduce the number of wakeups, on a best effort basis. */
+    fcntl(pipeIn_.get(), F_SETPIPE_SZ, 1024 * 1024);
+    int pipeSize = fcntl(pipeIn_.get(), F_GETPIPE_SZ);
+    pipeSize_ = pipeSize > 0 ? pipeSize : 65536;
+
+    running_ = true;
+    toRead_ = size;
+    buffered_ = 0;
+    transferred_ = 0;
+
+    inNotifier_->setEnabled(toRead_ > 0);
+    outNotifier_->setEnabled(!toRead_);
+
+    return 0;
+}
+
+/**
+ * \brief Stop transferring data
+ *
+ * Data read from the input but not written to the output yet is discarded. The
+ * \ref finished signal isn't emitted.
+ *
+ * \context This function is \threadbound.
+ */
+void FdPump::stop()
+{
+    if (!running_)
+        return;
+
+    running_ = false;
+    inNotifier_->setEnabled(false);
+    outNotifier_->setEnabled(false);
+    pipeIn_.reset();
+    pipeOut_.reset();
+}
+
+/**
+ * \fn FdPump::isRunning()
+ * \brief Check if the pump is transferring data
+ * \return True if the pump is running, false otherwise
+ */
+
+/**
+ * \fn FdPump::bytesTransferred()
+ * \brief Retrieve the number of bytes written to the output since start()
+ * \return The number of bytes transferred
+ */
+
+/**
+ * \var FdPump::finished
+ * \brief Signal emitted when the transfer completes
+ *
+ * The signal is emitted with 0 when all requested data has been transferred or
+ * the end of the input has been reached, or with a negative error code if the
+ * transfer failed. The pump is stopped when the signal is emitted.
+ */
+
+void FdPump::pump()
+{
+    while (running_) {
+        bool progress = false;
+
+        /* Fill the pipe from the input. */
+        if (toRead_ && buffered_ < pipeSize_) {
+            size_t length = std::min<uint64_t>(toRead_, pipeSize_ - buffered_);
+            ssize_t ret = splice(in_, nullptr, pipeIn_.get(), nullptr, length,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (ret > 0) {
+                buffered_ += ret;
+                toRead_ -= ret;
+                progress = true;
+            } else if (!ret) {
+                /* End of input. */
+                toRead_ = 0;
+            } else if (errno != EAGAIN && errno != EINTR) {
+                finish(-errno);
+                return;
+            }
+        }
+
+        /* Drain the pipe to the output. */
+        if (buffered_) {
+            ssize_t ret = splice(pipeOut_.get(), nullptr, out_, nullptr,
+                                 buffered_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (ret > 0) {
+                buffered_ -= ret;
+                transferred_ += ret;
+                progress = true;
+            } else if (ret < 0 && errno != EAGAIN && errno != EINTR) {
+                finish(-errno);
+                return;
+            }
+        }
+
+        if (!toRead_ && !buffered_) {
+            finish(0);
+            return;
+        }
+
+        if (!progress)
+            break;
+    }
+
+    /* Wait for the file descriptors that blocked the transfer. */
+    inNotifier_->setEnabled(toRead_ && buffered_ < pipeSize_);
+    outNotifier_->setEnabled(buffered_ > 0);
+}
+
+void FdPump::finish(int result)
+{
+    if (result < 0)
+        LOG(FdPump, Error)
+                << "Transfer failed after " << transferred_ << " bytes: "
+                << strerror(-result);
+
+    stop();
+    finished.emit(result);
+}
+
+} /* namespace zeus */
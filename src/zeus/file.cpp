@@ -18,16 +18,33 @@
 // File: file.cpp - File I/O operations
 //
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <zeus/file.h>
 #include <zeus/log.h>
+#include <zeus/mutex.h>
+#include <zeus/object.h>
 #include <zeus/shared_fd.h>
+#include <zeus/thread.h>
+#include <zeus/utils.h>
 
 /**
  * \file base/file.h
@@ -38,340 +55,2079 @@ namespace zeus {
 
 LOG_DEFINE_CATEGORY(File)
 
+/*
+ * Expand a memory region to page boundaries, as required by the madvise(),
+ * mlock() and mincore() family of functions.
+ */
+static std::pair<uint8_t *, size_t> pageAlign(const Span<const uint8_t> &region)
+{
+    static const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(region.data()) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(region.data()) + region.size();
+    end = (end + pageSize - 1) & ~(pageSize - 1);
+
+    return { reinterpret_cast<uint8_t *>(start), end - start };
+}
+
+/*
+ * Fault in the pages of a mapped memory region. MADV_POPULATE_READ is
+ * available since Linux 5.14, older kernels fall back to reading one byte per
+ * page.
+ */
+static int mapPrefetch(uint8_t *addr, size_t size)
+{
+    madvise(addr, size, MADV_WILLNEED);
+
+#ifdef MADV_POPULATE_READ
+    if (!madvise(addr, size, MADV_POPULATE_READ))
+        return 0;
+
+    if (errno != EINVAL)
+        return -errno;
+#endif
+
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const volatile uint8_t *data = addr;
+
+    for (size_t offset = 0; offset < size; offset += pageSize)
+        data[offset];
+
+    return 0;
+}
+
+/*
+ * State shared between a File and its asynchronous requests. The requests
+ * keep the state alive after the File is destroyed, until their completion
+ * has been delivered.
+ */
+class FileIoState
+{
+public:
+    FileIoState(File *file)
+        : file(file), nextId(1), bytesInFlight(0), pending(0)
+    {
+    }
+
+    /* The File, or nullptr once destroyed. Held while emitting completions. */
+    Mutex fileMutex;
+    File *file ZEUS_TSA_GUARDED_BY(fileMutex);
+
+    std::atomic<uint64_t> nextId;
+    std::atomic<size_t> bytesInFlight;
+
+    Mutex mutex;
+    ConditionVariable cv;
+    unsigned int pending ZEUS_TSA_GUARDED_BY(mutex);
+};
+
+/*
+ * An asynchronous I/O request. The request is an Object bound to the thread
+ * that submitted it, the engine completes it by invoking complete() in that
+ * thread, which emits the File::ioCompleted signal and deletes the request.
+ */
+class FileIoRequest : public Object
+{
+public:
+    using Operation = File::IoOperation;
+
+    FileIoRequest(std::shared_ptr<FileIoState> state, uint64_t id,
+                  File::IoOperation operation, int fd, off_t offset,
+                  uint8_t *data, size_t size)
+        : state_(std::move(state)), id_(id), operation_(operation), fd_(fd),
+          offset_(offset), data_(data), size_(size), done_(0)
+    {
+    }
+
+    File::IoOperation operation() const { return operation_; }
+    int fd() const { return fd_; }
+    off_t offset() const { return offset_ + done_; }
+    uint8_t *data() const { return data_ + done_; }
+    size_t remaining() const { return size_ - done_; }
+
+    bool advance(ssize_t result);
+    ssize_t execute();
+    void finish(ssize_t result);
+
+private:
+    void complete(ssize_t result);
+
+    std::shared_ptr<FileIoState> state_;
+    uint64_t id_;
+    File::IoOperation operation_;
+    int fd_;
+    off_t offset_;
+    uint8_t *data_;
+    size_t size_;
+    size_t done_;
+};
+
+/*
+ * Account for the result of a single read or write operation. Return true if
+ * the request is complete, or false if the remaining data needs to be
+ * transferred, in the same way as the retry loops of File::read() and
+ * File::write().
+ */
+bool FileIoRequest::advance(ssize_t result)
+{
+    if (result == -EINTR || result == -EAGAIN)
+        return false;
+
+    if (result <= 0 || operation_ == File::IoOperation::Sync ||
+        operation_ == File::IoOperation::Prefetch)
+        return true;
+
+    done_ += result;
+    return !remaining();
+}
+
+/*
+ * Perform the request synchronously, in an I/O worker thread, and return the
+ * result of the last operation.
+ */
+ssize_t FileIoRequest::execute()
+{
+    ssize_t ret;
+
+    do {
+        switch (operation_) {
+        case File::IoOperation::Read:
+            ret = pread(fd_, data(), remaining(), offset());
+            break;
+        case File::IoOperation::Write:
+            ret = pwrite(fd_, data(), remaining(), offset());
+            break;
+        case File::IoOperation::Prefetch:
+            ret = mapPrefetch(data_, size_);
+            break;
+        case File::IoOperation::Sync:
+        default:
+            ret = fsync(fd_);
+            break;
+        }
+
+        /* mapPrefetch() returns a negative error code already. */
+        if (ret < 0 && operation_ != File::IoOperation::Prefetch)
+            ret = -errno;
+    } while (!advance(ret));
+
+    return ret;
+}
+
+/*
+ * Release the I/O resources of the request and queue its completion to the
+ * requester thread. Called from an I/O engine thread with the final result of
+ * the last operation.
+ */
+void FileIoRequest::finish(ssize_t result)
+{
+    if ((operation_ == File::IoOperation::Read ||
+         operation_ == File::IoOperation::Write) &&
+        (done_ || result >= 0))
+        result = done_;
+
+    state_->bytesInFlight.fetch_sub(size_, std::memory_order_relaxed);
+
+    {
+        MutexLocker locker(state_->mutex);
+        if (!--state_->pending)
+            state_->cv.notify_all();
+    }
+
+    invokeMethod(&FileIoRequest::complete, ConnectionTypeQueued, result);
+}
+
+void FileIoRequest::complete(ssize_t result)
+{
+    {
+        MutexLocker locker(state_->fileMutex);
+        if (state_->file)
+            state_->file->ioCompleted.emit(id_, result);
+    }
+
+    delete this;
+}
+
+namespace {
+
+/* A thread running a member function of an I/O engine. */
+template<typename T>
+class FileIoThread : public Thread
+{
+public:
+    FileIoThread(T *object, void (T::*func)())
+        : object_(object), func_(func)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        (object_->*func_)();
+    }
+
+private:
+    T *object_;
+    void (T::*func_)();
+};
+
+/*
+ * Process-wide asynchronous I/O engine. At most queueDepth() requests are
+ * in flight, additional requests are queued in submission order. Backends
+ * implement start() to start processing a request, and call finish() when
+ * the request completes.
+ */
+class FileIoEngine
+{
+public:
+    static FileIoEngine *instance();
+
+    virtual ~FileIoEngine() = default;
+
+    void setQueueDepth(unsigned int depth);
+    void submit(FileIoRequest *request);
+    void finish(FileIoRequest *request, ssize_t result);
+
+protected:
+    static constexpr unsigned int kMaxQueueDepth = 256;
+
+    FileIoEngine();
+
+    virtual void start(FileIoRequest *request) ZEUS_TSA_REQUIRES(mutex_) = 0;
+
+    Mutex mutex_;
+
+private:
+    unsigned int depth_ ZEUS_TSA_GUARDED_BY(mutex_);
+    unsigned int inFlight_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::deque<FileIoRequest *> queue_ ZEUS_TSA_GUARDED_BY(mutex_);
+};
+
+FileIoEngine::FileIoEngine()
+        : depth_(32), inFlight_(0)
+{
+}
+
+void FileIoEngine::setQueueDepth(unsigned int depth)
+{
+    MutexLocker locker(mutex_);
+
+    depth_ = std::clamp(depth, 1U, kMaxQueueDepth);
+
+    while (inFlight_ < depth_ && !queue_.empty()) {
+        FileIoRequest *request = queue_.front();
+        queue_.pop_front();
+        inFlight_++;
+        start(request);
+    }
+}
+
+void FileIoEngine::submit(FileIoRequest *request)
+{
+    MutexLocker locker(mutex_);
+
+    if (inFlight_ >= depth_) {
+        queue_.push_back(request);
+        return;
+    }
+
+    inFlight_++;
+    start(request);
+}
+
+void FileIoEngine::finish(FileIoRequest *request, ssize_t result)
+{
+    request->finish(result);
+
+    MutexLocker locker(mutex_);
+
+    inFlight_--;
+
+    if (inFlight_ < depth_ && !queue_.empty()) {
+        FileIoRequest *next = queue_.front();
+        queue_.pop_front();
+        inFlight_++;
+        start(next);
+    }
+}
+
+/*
+ * Worker threads performing requests synchronously on behalf of an engine,
+ * started on demand up to a maximum count. Requests queued with an error are
+ * finished with that error without being performed, which allows an engine to
+ * fail a request without calling finish() with its lock held.
+ */
+class FileIoWorkers
+{
+public:
+    FileIoWorkers(FileIoEngine *engine);
+    ~FileIoWorkers();
+
+    void queue(FileIoRequest *request, int error = 0);
+
+private:
+    static constexpr unsigned int kMaxWorkers = 16;
+
+    void run();
+
+    FileIoEngine *engine_;
+
+    Mutex mutex_;
+    ConditionVariable cv_;
+    std::deque<std::pair<FileIoRequest *, int>> requests_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::vector<std::unique_ptr<Thread>> workers_ ZEUS_TSA_GUARDED_BY(mutex_);
+    unsigned int idle_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool stop_ ZEUS_TSA_GUARDED_BY(mutex_);
+};
+
+FileIoWorkers::FileIoWorkers(FileIoEngine *engine)
+        : engine_(engine), idle_(0), stop_(false)
+{
+}
+
+FileIoWorkers::~FileIoWorkers()
+{
+    std::vector<std::unique_ptr<Thread>> workers;
+
+    {
+        MutexLocker locker(mutex_);
+        stop_ = true;
+        workers = std::move(workers_);
+    }
+
+    cv_.notify_all();
+
+    for (std::unique_ptr<Thread> &worker : workers)
+        worker->wait();
+}
+
+void FileIoWorkers::queue(FileIoRequest *request, int error)
+{
+    {
+        MutexLocker locker(mutex_);
+
+        requests_.emplace_back(request, error);
+
+        if (!idle_ && workers_.size() < kMaxWorkers) {
+            auto worker = std::make_unique<FileIoThread<FileIoWorkers>>(this, &FileIoWorkers::run);
+            worker->start();
+            workers_.push_back(std::move(worker));
+            return;
+        }
+    }
+
+    cv_.notify_one();
+}
+
+void FileIoWorkers::run()
+{
+    MutexLocker locker(mutex_);
+
+    while (true) {
+        idle_++;
+        cv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) {
+            return stop_ || !requests_.empty();
+        });
+        idle_--;
+
+        if (requests_.empty())
+            break;
+
+        auto [request, error] = requests_.front();
+        requests_.pop_front();
+
+        locker.unlock();
+        ssize_t result = error ? error : request->execute();
+        engine_->finish(request, result);
+        locker.lock();
+    }
+}
+
+/*
+ * I/O worker pool backend. Requests are performed synchronously by worker
+ * threads.
+ */
+class FileIoWorkerPool : public FileIoEngine
+{
+public:
+    FileIoWorkerPool();
+
+protected:
+    void start(FileIoRequest *request) override ZEUS_TSA_REQUIRES(mutex_);
+
+private:
+    FileIoWorkers workers_;
+};
+
+FileIoWorkerPool::FileIoWorkerPool()
+        : workers_(this)
+{
+}
+
+void FileIoWorkerPool::start(FileIoRequest *request)
+{
+    workers_.queue(request);
+}
+
+/*
+ * io_uring backend. Requests are submitted to the kernel through the
+ * submission ring, and a completion thread waits for completions. Partial
+ * transfers are resubmitted for the remaining data.
+ *
+ * Requests rejected by io_uring_enter() fail with the submission error. If
+ * waiting for completions fails, the ring is considered broken: the requests
+ * in flight fail with the error, and all later requests are performed by
+ * worker threads.
+ */
+class FileIoUring : public FileIoEngine
+{
+public:
+    FileIoUring();
+    ~FileIoUring();
+
+    bool isValid() const { return fd_.isValid(); }
+
+protected:
+    void start(FileIoRequest *request) override ZEUS_TSA_REQUIRES(mutex_);
+
+private:
+    int push(uint8_t opcode, FileIoRequest *request) ZEUS_TSA_REQUIRES(mutex_);
+    void run();
+
+    UniqueFD fd_;
+
+    void *sqRing_;
+    size_t sqRingSize_;
+    void *cqRing_;
+    size_t cqRingSize_;
+    struct io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned int *sqHead_;
+    unsigned int *sqTail_;
+    unsigned int sqMask_;
+    unsigned int *sqArray_;
+    unsigned int *cqHead_;
+    unsigned int *cqTail_;
+    unsigned int cqMask_;
+    struct io_uring_cqe *cqes_;
+
+    std::unordered_set<FileIoRequest *> submitted_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool failed_ ZEUS_TSA_GUARDED_BY(mutex_);
+
+    FileIoWorkers workers_;
+    FileIoThread<FileIoUring> thread_;
+};
+
+FileIoUring::FileIoUring()
+        : sqRing_(MAP_FAILED), cqRing_(MAP_FAILED), sqes_(nullptr),
+          failed_(false), workers_(this), thread_(this, &FileIoUring::run)
+{
+    struct io_uring_params params = {};
+
+    UniqueFD fd(syscall(__NR_io_uring_setup, kMaxQueueDepth, &params));
+    if (!fd.isValid())
+        return;
+
+    /* IORING_OP_READ and IORING_OP_WRITE are supported since the same version. */
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+        return;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd.get(), IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+        return;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        cqRing_ = sqRing_;
+    else
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd.get(), IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED)
+        return;
+
+    void *sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd.get(), IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return;
+
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    uint8_t *sq = static_cast<uint8_t *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+
+    uint8_t *cq = static_cast<uint8_t *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    fd_ = std::move(fd);
+    thread_.start();
+}
+
+FileIoUring::~FileIoUring()
+{
+    /*
+	 * A no-op request without a FileIoRequest stops the thread, unless it
+	 * has stopped due to an error already.
+	 */
+    if (isValid()) {
+        MutexLocker locker(mutex_);
+        if (!failed_)
+            push(IORING_OP_NOP, nullptr);
+    }
+
+    thread_.wait();
+
+    if (sqes_)
+        munmap(sqes_, sqesSize_);
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+        munmap(cqRing_, cqRingSize_);
+    if (sqRing_ != MAP_FAILED)
+        munmap(sqRing_, sqRingSize_);
+}
+
+void FileIoUring::start(FileIoRequest *request)
+{
+    if (failed_) {
+        workers_.queue(request);
+        return;
+    }
+
+    int ret = 0;
+
+    switch (request->operation()) {
+    case FileIoRequest::Operation::Read:
+        ret = push(IORING_OP_READ, request);
+        break;
+    case FileIoRequest::Operation::Write:
+        ret = push(IORING_OP_WRITE, request);
+        break;
+    case FileIoRequest::Operation::Sync:
+        ret = push(IORING_OP_FSYNC, request);
+        break;
+    case FileIoRequest::Operation::Prefetch:
+        /*
+		 * IORING_OP_MADVISE with MADV_POPULATE_READ fails with -EINVAL
+		 * before Linux 5.14, and the kernel runs madvise requests in an
+		 * io-wq worker anyway. Use a worker thread, which falls back to
+		 * faulting pages in on older kernels.
+		 */
+        workers_.queue(request);
+        return;
+    }
+
+    /* The engine lock is held, finish the request from a worker thread. */
+    if (ret < 0)
+        workers_.queue(request, ret);
+}
+
+/*
+ * Queue a submission entry and submit it to the kernel. The number of
+ * requests in flight is bounded by the ring size, a free entry is thus always
+ * available. If the submission fails, the entry is removed from the ring and
+ * a negative error code is returned.
+ */
+int FileIoUring::push(uint8_t opcode, FileIoRequest *request)
+{
+    unsigned int tail = *sqTail_;
+    unsigned int index = tail & sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = -1;
+    sqe->user_data = reinterpret_cast<uintptr_t>(request);
+
+    if (request) {
+        sqe->fd = request->fd();
+        sqe->off = request->offset();
+        sqe->addr = reinterpret_cast<uintptr_t>(request->data());
+        sqe->len = std::min<size_t>(request->remaining(), INT32_MAX);
+    }
+
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, fd_.get(), 1, 0, 0, nullptr, 0);
+    } while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+
+    if (ret < 0) {
+        ret = -errno;
+
+        /*
+		 * Entries are only consumed by this function, with the engine
+		 * lock held. Remove the entry if the kernel hasn't consumed it,
+		 * to avoid submitting it later with the next entry.
+		 */
+        if (__atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == tail)
+            __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+        return ret;
+    }
+
+    if (request)
+        submitted_.insert(request);
+
+    return 0;
+}
+
+void FileIoUring::run()
+{
+    while (true) {
+        int ret = syscall(__NR_io_uring_enter, fd_.get(), 0, 1,
+                          IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0 && errno != EINTR)
+            break;
+
+        unsigned int head = *cqHead_;
+        unsigned int tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            const struct io_uring_cqe *cqe = &cqes_[head & cqMask_];
+            auto *request = reinterpret_cast<FileIoRequest *>(cqe->user_data);
+            int result = cqe->res;
+
+            /* Release the entry before completing the request. */
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+
+            if (!request)
+                return;
+
+            {
+                MutexLocker locker(mutex_);
+                submitted_.erase(request);
+
+                if (!request->advance(result)) {
+                    start(request);
+                    continue;
+                }
+            }
+
+            finish(request, result);
+        }
+    }
+
+    int error = -errno;
+
+    LOG(File, Error)
+        << "Failed to wait for io_uring completions: " << strerror(-error)
+        << ", falling back to worker threads";
+
+    /*
+	 * The completions of the requests in flight can't be reaped anymore,
+	 * fail them. Later requests are performed by worker threads.
+	 */
+    std::unordered_set<FileIoRequest *> requests;
+
+    {
+        MutexLocker locker(mutex_);
+        failed_ = true;
+        requests = std::move(submitted_);
+        submitted_.clear();
+    }
+
+    for (FileIoRequest *request : requests)
+        finish(request, error);
+}
+
+FileIoEngine *FileIoEngine::instance()
+{
+    static std::unique_ptr<FileIoEngine> engine = []() -> std::unique_ptr<FileIoEngine> {
+        const char *backend = utils::secure_getenv("ZEUS_FILE_IO_BACKEND");
+
+        if (!backend || strcmp(backend, "threads")) {
+            auto uring = std::make_unique<FileIoUring>();
+            if (uring->isValid())
+                return uring;
+        }
+
+        return std::make_unique<FileIoWorkerPool>();
+    }();
+
+    return engine.get();
+}
+
+/*
+ * Check the alignment of an I/O operation for direct I/O. A zero alignment
+ * disables the check, and a negative offset skips the offset check.
+ */
+bool isDirectIoAligned(const void *data, size_t size, off_t offset,
+                       size_t alignment)
+{
+    if (!alignment)
+        return true;
+
+    uintptr_t bits = reinterpret_cast<uintptr_t>(data) | size;
+    if (offset >= 0)
+        bits |= offset;
+
+    if (!(bits & (alignment - 1)))
+        return true;
+
+    LOG(File, Error)
+            << "Direct I/O requires " << alignment << " bytes alignment ("
+            << size << " bytes at " << data
+            << (offset >= 0 ? ", offset " + std::to_string(offset) : "")
+            << ")";
+    return false;
+}
+
+/*
+ * Query the alignment constraints for direct I/O, available since Linux 6.1.
+ * Default to the page size otherwise, which satisfies the logical block size
+ * of all common devices.
+ */
+size_t fileDirectIoAlignment(int fd)
+{
+#ifdef STATX_DIOALIGN
+    struct statx stx;
+    if (!statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) &&
+        (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align)
+        return std::max(stx.stx_dio_mem_align, stx.stx_dio_offset_align);
+#endif
+
+    return sysconf(_SC_PAGESIZE);
+}
+
+/*
+ * Transfer data between the file and a list of buffers. Buffers are checked
+ * for direct I/O \a alignment, see isDirectIoAligned(). The transfer function
+ * performs a single vectored operation starting at the given number of bytes
+ * already transferred, and returns its result or -1 with errno set. Partial
+ * transfers are retried for the remaining data, until all buffers have been
+ * processed, the end of the file is reached or an error occurs.
+ */
+template<typename T, typename Transfer>
+ssize_t fileTransferVectored(const Span<const Span<T>> &buffers,
+                             size_t alignment, Transfer transfer)
+{
+    static constexpr size_t kInlineIovecs = 8;
+
+    struct iovec inlineIovecs[kInlineIovecs];
+    std::vector<struct iovec> iovecs;
+    struct iovec *iov = inlineIovecs;
+
+    if (buffers.size() > kInlineIovecs) {
+        iovecs.resize(buffers.size());
+        iov = iovecs.data();
+    }
+
+    size_t count = 0;
+    for (const Span<T> &buffer : buffers) {
+        if (buffer.empty())
+            continue;
+
+        if (!isDirectIoAligned(buffer.data(), buffer.size(), -1, alignment))
+            return -EINVAL;
+
+        iov[count].iov_base = const_cast<uint8_t *>(buffer.data());
+        iov[count].iov_len = buffer.size();
+        count++;
+    }
+
+    size_t transferred = 0;
+    ssize_t ret = 0;
+
+    while (count) {
+        ret = transfer(iov, std::min<size_t>(count, IOV_MAX), transferred);
+        if (ret <= 0)
+            break;
+
+        transferred += ret;
+
+        /* Skip the fully transferred buffers and trim the partial one. */
+        size_t remaining = ret;
+        while (count && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count) {
+            iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+
+    if (ret < 0 && !transferred)
+        return -errno;
+
+    return transferred;
+}
+
+/*
+ * Transfer up to \a size bytes with a zero-copy system call. The transfer
+ * function performs a single transfer of at most the given length, starting
+ * at the given number of bytes already transferred, and returns its result or
+ * -1 with errno set. Transfers are repeated until \a size bytes have been
+ * transferred, the end of the source is reached or an error occurs.
+ */
+template<typename Transfer>
+ssize_t fileTransferLoop(size_t size, Transfer transfer)
+{
+    /* Limit the length to the largest value the system calls accept. */
+    static constexpr size_t kMaxTransfer = 0x7ffff000;
+
+    size_t transferred = 0;
+    ssize_t ret = 0;
+
+    while (transferred < size) {
+        ret = transfer(transferred, std::min(size - transferred, kMaxTransfer));
+        if (ret <= 0)
+            break;
+
+        transferred += ret;
+    }
+
+    if (ret < 0 && !transferred)
+        return -errno;
+
+    return transferred;
+}
+
+/*
+ * Check if a zero-copy transfer failed because the system call doesn't
+ * support the file descriptors, in which case a fallback can be used.
+ */
+bool fileTransferUnsupported(ssize_t ret)
+{
+    return ret == -EINVAL || ret == -ENOSYS || ret == -EXDEV ||
+           ret == -EOPNOTSUPP;
+}
+
+} /* namespace */
+
+/**
+ * \class AlignedBuffer
+ * \brief Memory buffer with a custom alignment
+ *
+ * The AlignedBuffer class allocates a memory buffer whose address and size are
+ * multiples of an alignment. It is primarily meant to allocate buffers for
+ * direct I/O with File, using File::directIoAlignment() as the alignment.
+ *
+ * Buffers are movable but not copyable, and free their memory when destroyed.
+ */
+
+/**
+ * \brief Construct an empty AlignedBuffer
+ */
+AlignedBuffer::AlignedBuffer()
+        : data_(nullptr), size_(0), alignment_(0)
+{
+}
+
+/**
+ * \brief Allocate an AlignedBuffer
+ * \param[in] size The buffer size in bytes
+ * \param[in] alignment The buffer alignment in bytes, as a power of two
+ *
+ * The \a size is rounded up to a multiple of \a alignment. If the allocation
+ * fails, the buffer is invalid.
+ */
+AlignedBuffer::AlignedBuffer(size_t size, size_t alignment)
+        : data_(nullptr), size_(0), alignment_(alignment)
+{
+    alignment = std::max(alignment, sizeof(void *));
+    size = (size + alignment - 1) & ~(alignment - 1);
+
+    void *data;
+    if (!size || posix_memalign(&data, alignment, size))
+        return;
+
+    data_ = static_cast<uint8_t *>(data);
+    size_ = size;
+}
+
+/**
+ * \brief Move-construct an AlignedBuffer
+ * \param[in] other The other AlignedBuffer
+ */
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other)
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          alignment_(std::exchange(other.alignment_, 0))
+{
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+    free(data_);
+}
+
+/**
+ * \brief Move-assign an AlignedBuffer
+ * \param[in] other The other AlignedBuffer
+ * \return A reference to this AlignedBuffer
+ */
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other)
+{
+    if (this == &other)
+        return *this;
+
+    free(data_);
+
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    alignment_ = std::exchange(other.alignment_, 0);
+
+    return *this;
+}
+
+/**
+ * \fn AlignedBuffer::isValid()
+ * \brief Check if the buffer has been allocated
+ * \return True if the buffer is valid, false otherwise
+ */
+
+/**
+ * \fn AlignedBuffer::data()
+ * \brief Retrieve the buffer memory
+ * \return The buffer memory, or nullptr if the buffer is invalid
+ */
+
+/**
+ * \fn AlignedBuffer::size()
+ * \brief Retrieve the buffer size
+ * \return The buffer size in bytes
+ */
+
+/**
+ * \fn AlignedBuffer::alignment()
+ * \brief Retrieve the buffer alignment
+ * \return The buffer alignment in bytes
+ */
+
+/**
+ * \fn AlignedBuffer::span()
+ * \brief Retrieve the buffer memory as a span
+ * \return The buffer memory span
+ */
+
+/**
+ * \class File
+ * \brief Interface for I/O operations on files
+ *
+ * The File class provides an interface to perform I/O operations on files. It
+ * wraps opening, closing and mapping files in memory, and handles the cleaning
+ * of allocated resources.
+ *
+ * File instances are usually constructed with a file name, but the name can be
+ * set later through the setFileName() function. Instances are not automatically
+ * opened when constructed, and shall be opened explictly with open().
+ *
+ * Files can be mapped to the process memory with map(). Mapped regions can be
+ * unmapped manually with munmap(), and are automatically unmapped when the File
+ * is destroyed or when it is used to reference another file with setFileName().
+ *
+ * Reads, writes and syncs can also be performed asynchronously with
+ * readAsync(), writeAsync() and syncAsync(). The operations are offloaded to
+ * the kernel through io_uring when available, or to a pool of I/O worker
+ * threads otherwise. The worker pool can be forced by setting the
+ * ZEUS_FILE_IO_BACKEND environment variable to "threads". Completion is
+ * reported through the ioCompleted signal, emitted in the thread that
+ * submitted the request, which shall have an event dispatcher. Submission
+ * fails with -ENOTSUP otherwise. The number of requests in flight in the
+ * process is limited by setAsyncQueueDepth(), additional requests are queued
+ * and submitted in order as earlier requests complete.
+ */
+
+/**
+ * \enum File::MapFlag
+ * \brief Flags for the File::map() function
+ * \var File::MapFlag::NoOption
+ * \brief No option (used as default value)
+ * \var File::MapFlag::Private
+ * \brief The memory region is mapped as private, changes are not reflected in
+ * the file constents
+ * \var File::MapFlag::Populate
+ * \brief Populate the page tables of the region when mapping it
+ * \var File::MapFlag::Sequential
+ * \brief The region will be accessed sequentially, read ahead aggressively
+ * \var File::MapFlag::Random
+ * \brief The region will be accessed randomly, disable read ahead
+ * \var File::MapFlag::WillNeed
+ * \brief The region will be accessed soon, start reading it in the background
+ * \var File::MapFlag::HugePage
+ * \brief Back the region with transparent huge pages when possible
+ * \var File::MapFlag::Locked
+ * \brief Lock the region in memory
+ */
+
+/**
+ * \typedef File::MapFlags
+ * \brief A bitwise combination of File::MapFlag values
+ */
+
+/**
+ * \enum File::OpenModeFlag
+ * \brief Mode in which a file is opened
+ * \var File::OpenModeFlag::NotOpen
+ * \brief The file is not open
+ * \var File::OpenModeFlag::ReadOnly
+ * \brief The file is open for reading
+ * \var File::OpenModeFlag::WriteOnly
+ * \brief The file is open for writing
+ * \var File::OpenModeFlag::ReadWrite
+ * \brief The file is open for reading and writing
+ * \var File::OpenModeFlag::Direct
+ * \brief The file is open for direct I/O, bypassing the page cache
+ */
+
 /**
- * \class File
- * \brief Interface for I/O operations on files
+ * \typedef File::OpenMode
+ * \brief A bitwise combination of File::OpenModeFlag values
+ */
+
+/**
+ * \enum File::AllocateFlag
+ * \brief Flags for the File::allocate() function
+ * \var File::AllocateFlag::NoOption
+ * \brief No option (used as default value)
+ * \var File::AllocateFlag::KeepSize
+ * \brief Don't modify the file size when allocating space past the end of the
+ * file
+ */
+
+/**
+ * \typedef File::AllocateFlags
+ * \brief A bitwise combination of File::AllocateFlag values
+ */
+
+/**
+ * \brief Construct a File to represent the file \a name
+ * \param[in] name The file name
+ *
+ * Upon construction the File object is closed and shall be opened with open()
+ * before performing I/O operations.
+ */
+File::File(const std::string &name)
+        : name_(name), mode_(OpenModeFlag::NotOpen), directAlignment_(0),
+          error_(0),
+          io_(std::make_shared<FileIoState>(this))
+{
+}
+
+/**
+ * \brief Construct an open File from a file descriptor
+ * \param[in] fd The file descriptor
+ * \param[in] name The file name
+ *
+ * The File is opened on a duplicate of \a fd, without looking up the file by
+ * name. This allows reusing descriptors cached by FdCache. The open mode is
+ * derived from the file status flags of \a fd, and \a name is only used for
+ * informational purposes.
+ *
+ * The duplicate shares the file position with \a fd and all other duplicates.
+ * Files that share a descriptor should thus use positional I/O functions such
+ * as readAt() and writeAt().
+ *
+ * If \a fd can't be duplicated, the File is closed and the error() status is
+ * set.
+ */
+File::File(const SharedFD &fd, const std::string &name)
+        : name_(name), mode_(OpenModeFlag::NotOpen), directAlignment_(0),
+          error_(0),
+          io_(std::make_shared<FileIoState>(this))
+{
+    fd_ = UniqueFD(fcntl(fd.get(), F_DUPFD_CLOEXEC, 0));
+    if (!fd_.isValid()) {
+        error_ = -errno;
+        return;
+    }
+
+    int flags = fcntl(fd_.get(), F_GETFL);
+
+    switch (flags & O_ACCMODE) {
+    case O_RDONLY:
+        mode_ = OpenModeFlag::ReadOnly;
+        break;
+    case O_WRONLY:
+        mode_ = OpenModeFlag::WriteOnly;
+        break;
+    default:
+        mode_ = OpenModeFlag::ReadWrite;
+        break;
+    }
+
+    if (flags & O_DIRECT) {
+        mode_ |= OpenModeFlag::Direct;
+        directAlignment_ = fileDirectIoAlignment(fd_.get());
+    }
+}
+
+/**
+ * \brief Construct a File without an associated name
+ *
+ * Before being used for any purpose, the file name shall be set with
+ * setFileName().
+ */
+File::File()
+        : mode_(OpenModeFlag::NotOpen), directAlignment_(0), error_(0),
+          io_(std::make_shared<FileIoState>(this))
+{
+}
+
+/**
+ * \brief Destroy a File instance
+ *
+ * Any memory mapping associated with the File is unmapped, and the File is
+ * closed if it is open. The destructor waits for all asynchronous operations
+ * to complete, their ioCompleted signal is not emitted. If a completion is
+ * being delivered in another thread, the destructor waits for the slots to
+ * return. The File shall thus not be destroyed from a slot connected to its
+ * ioCompleted signal.
+ */
+File::~File()
+{
+    unmapAll();
+    close();
+
+    MutexLocker locker(io_->fileMutex);
+    io_->file = nullptr;
+}
+
+/**
+ * \fn const std::string &File::fileName() const
+ * \brief Retrieve the file name
+ * \return The file name
+ */
+
+/**
+ * \brief Set the name of the file
+ * \param[in] name The name of the file
+ *
+ * The \a name can contain an absolute path, a relative path or no path at all.
+ * Calling this function on an open file results in undefined behaviour.
+ *
+ * Any memory mapping associated with the File is unmapped.
+ */
+void File::setFileName(const std::string &name)
+{
+    if (isOpen()) {
+        LOG(File, Error)
+                << "Can't set file name on already open file " << name_;
+        return;
+    }
+
+    unmapAll();
+
+    name_ = name;
+}
+
+/**
+ * \brief Check if the file specified by fileName() exists
+ *
+ * This function checks if the file specified by fileName() exists. The File
+ * instance doesn't need to be open to check for file existence, and this
+ * function may return false even if the file is open, if it was deleted from
+ * the file system.
+ *
+ * \return True if the the file exists, false otherwise
+ */
+bool File::exists() const
+{
+    return exists(name_);
+}
+
+/**
+ * \brief Open the file in the given mode
+ * \param[in] mode The open mode
+ *
+ * This function opens the file specified by fileName() in \a mode. If the file
+ * doesn't exist and the mode is WriteOnly or ReadWrite, this function will
+ * attempt to create the file with initial permissions set to 0666 (modified by
+ * the process' umask).
+ *
+ * The file is opened with the O_CLOEXEC flag, and will be closed automatically
+ * when a new binary is executed with one of the exec(3) functions.
+ *
+ * If \a mode contains OpenModeFlag::Direct, the file is opened with O_DIRECT
+ * and I/O operations bypass the page cache. Buffers, sizes and offsets must
+ * then be aligned to directIoAlignment(), see AlignedBuffer. If the file
+ * system doesn't support direct I/O, the file is opened without it, a warning
+ * is logged and the Direct flag is cleared from openMode().
+ *
+ * The error() status is updated.
+ *
+ * \return True on success, false otherwise
+ */
+bool File::open(File::OpenMode mode)
+{
+    if (isOpen()) {
+        LOG(File, Error) << "File " << name_ << " is already open";
+        return false;
+    }
+
+    int flags = static_cast<OpenMode::Type>(mode & OpenModeFlag::ReadWrite) - 1;
+    if (mode & OpenModeFlag::WriteOnly)
+        flags |= O_CREAT;
+
+    if (mode & OpenModeFlag::Direct) {
+        fd_ = UniqueFD(::open(name_.c_str(), flags | O_CLOEXEC | O_DIRECT, 0666));
+        if (!fd_.isValid() && errno == EINVAL) {
+            LOG(File, Warning)
+                    << "Direct I/O not supported for " << name_
+                    << ", using buffered I/O";
+            mode &= ~OpenMode(OpenModeFlag::Direct);
+        }
+    }
+
+    if (!fd_.isValid())
+        fd_ = UniqueFD(::open(name_.c_str(), flags | O_CLOEXEC, 0666));
+    if (!fd_.isValid()) {
+        error_ = -errno;
+        return false;
+    }
+
+    directAlignment_ = mode & OpenModeFlag::Direct
+                               ? fileDirectIoAlignment(fd_.get())
+                               : 0;
+
+    mode_ = mode;
+    error_ = 0;
+    return true;
+}
+
+/**
+ * \fn bool File::isOpen() const
+ * \brief Check if the file is open
+ * \return True if the file is open, false otherwise
+ */
+
+/**
+ * \fn OpenMode File::openMode() const
+ * \brief Retrieve the file open mode
+ * \return The file open mode
+ */
+
+/**
+ * \brief Close the file
+ *
+ * This function closes the File. If the File is not open, it performs no
+ * operation. Memory mappings created with map() are not destroyed when the
+ * file is closed.
+ *
+ * Asynchronous operations in flight are waited for before closing the file.
+ */
+void File::close()
+{
+    if (!fd_.isValid())
+        return;
+
+    waitAsync();
+    fd_.reset();
+    mode_ = OpenModeFlag::NotOpen;
+    directAlignment_ = 0;
+}
+
+/**
+ * \fn size_t File::directIoAlignment() const
+ * \brief Retrieve the alignment required for direct I/O
+ *
+ * When the file is open with OpenModeFlag::Direct, the memory address, size
+ * and file offset of all I/O operations must be multiples of the returned
+ * alignment. It is the logical block size of the underlying device as reported
+ * by the kernel, or the page size when the kernel doesn't report it.
+ *
+ * \return The direct I/O alignment in bytes, or 0 if the file isn't open for
+ * direct I/O
+ */
+
+/**
+ * \fn int File::error() const
+ * \brief Retrieve the file error status
+ *
+ * This function retrieves the error status from the last file open or I/O
+ * operation. The error status is a negative number as defined by errno.h. If
+ * no error occurred, this function returns 0.
+ *
+ * \return The file error status
+ */
+
+/**
+ * \brief Retrieve the file size
+ *
+ * This function retrieves the size of the file on the filesystem. The File
+ * instance shall be open to retrieve its size. The error() status is not
+ * modified, error codes are returned directly on failure.
+ *
+ * \return The file size in bytes on success, or a negative error code otherwise
+ */
+ssize_t File::size() const
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    struct stat st;
+    int ret = fstat(fd_.get(), &st);
+    if (ret < 0)
+        return -errno;
+
+    return st.st_size;
+}
+
+/**
+ * \brief Return current read or write position
+ *
+ * If the file is closed, this function returns 0.
+ *
+ * \return The current read or write position
+ */
+off_t File::pos() const
+{
+    if (!isOpen())
+        return 0;
+
+    return lseek(fd_.get(), 0, SEEK_CUR);
+}
+
+/**
+ * \brief Set the read or write position
+ * \param[in] pos The desired position
+ * \return The resulting offset from the beginning of the file on success, or a
+ * negative error code otherwise
+ */
+off_t File::seek(off_t pos)
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    off_t ret = lseek(fd_.get(), pos, SEEK_SET);
+    if (ret < 0)
+        return -errno;
+
+    return ret;
+}
+
+/**
+ * \brief Read data from the file
+ * \param[in] data Memory to read data into
  *
- * The File class provides an interface to perform I/O operations on files. It
- * wraps opening, closing and mapping files in memory, and handles the cleaning
- * of allocated resources.
+ * Read at most \a data.size() bytes from the file into \a data.data(), and
+ * return the number of bytes read. If less data than requested is available,
+ * the returned byte count may be smaller than the requested size. If no more
+ * data is available, 0 is returned.
  *
- * File instances are usually constructed with a file name, but the name can be
- * set later through the setFileName() function. Instances are not automatically
- * opened when constructed, and shall be opened explictly with open().
+ * The position of the file as returned by pos() is advanced by the number of
+ * bytes read. If an error occurs, the position isn't modified.
  *
- * Files can be mapped to the process memory with map(). Mapped regions can be
- * unmapped manually with munmap(), and are automatically unmapped when the File
- * is destroyed or when it is used to reference another file with setFileName().
+ * \return The number of bytes read on success, or a negative error code
+ * otherwise
  */
+ssize_t File::read(const Span<uint8_t> &data)
+{
+    if (!isOpen())
+        return -EINVAL;
 
-/**
- * \enum File::MapFlag
- * \brief Flags for the File::map() function
- * \var File::MapFlag::NoOption
- * \brief No option (used as default value)
- * \var File::MapFlag::Private
- * \brief The memory region is mapped as private, changes are not reflected in
- * the file constents
- */
+    ssize_t ret = checkDirectIo(data.data(), data.size(), -1);
+    if (ret < 0)
+        return ret;
 
-/**
- * \typedef File::MapFlags
- * \brief A bitwise combination of File::MapFlag values
- */
+    size_t readBytes = 0;
+
+    /* Retry in case of interrupted system calls. */
+    while (readBytes < data.size()) {
+        ret = ::read(fd_.get(), data.data() + readBytes,
+                     data.size() - readBytes);
+        if (ret <= 0)
+            break;
+
+        readBytes += ret;
+    }
+
+    if (ret < 0 && !readBytes)
+        return -errno;
+
+    return readBytes;
+}
 
 /**
- * \enum File::OpenModeFlag
- * \brief Mode in which a file is opened
- * \var File::OpenModeFlag::NotOpen
- * \brief The file is not open
- * \var File::OpenModeFlag::ReadOnly
- * \brief The file is open for reading
- * \var File::OpenModeFlag::WriteOnly
- * \brief The file is open for writing
- * \var File::OpenModeFlag::ReadWrite
- * \brief The file is open for reading and writing
+ * \brief Write data to the file
+ * \param[in] data Memory containing data to be written
+ *
+ * Write at most \a data.size() bytes from \a data.data() to the file, and
+ * return the number of bytes written. If the file system doesn't have enough
+ * space for the data, the returned byte count may be less than requested.
+ *
+ * The position of the file as returned by pos() is advanced by the number of
+ * bytes written. If an error occurs, the position isn't modified.
+ *
+ * \return The number of bytes written on success, or a negative error code
+ * otherwise
  */
+ssize_t File::write(const Span<const uint8_t> &data)
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    ssize_t ret = checkDirectIo(data.data(), data.size(), -1);
+    if (ret < 0)
+        return ret;
+
+    size_t writtenBytes = 0;
+
+    /* Retry in case of interrupted system calls. */
+    while (writtenBytes < data.size()) {
+        ret = ::write(fd_.get(), data.data() + writtenBytes,
+                      data.size() - writtenBytes);
+        if (ret <= 0)
+            break;
+
+        writtenBytes += ret;
+    }
+
+    if (data.size() && !writtenBytes)
+        return -errno;
+
+    return writtenBytes;
+}
 
 /**
- * \typedef File::OpenMode
- * \brief A bitwise combination of File::OpenModeFlag values
+ * \brief Read data from the file at a given offset
+ * \param[in] offset The offset within the file to read from
+ * \param[in] data Memory to read data into
+ *
+ * Read at most \a data.size() bytes from the file at \a offset into
+ * \a data.data(), and return the number of bytes read. This function behaves
+ * as read(), except that it doesn't use or modify the position of the file as
+ * returned by pos(). Multiple threads can thus read different regions of the
+ * same File concurrently.
+ *
+ * \return The number of bytes read on success, or a negative error code
+ * otherwise
  */
+ssize_t File::readAt(off_t offset, const Span<uint8_t> &data)
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    ssize_t ret = checkDirectIo(data.data(), data.size(), offset);
+    if (ret < 0)
+        return ret;
+
+    size_t readBytes = 0;
+
+    /* Retry in case of partial reads. */
+    while (readBytes < data.size()) {
+        ret = ::pread(fd_.get(), data.data() + readBytes,
+                      data.size() - readBytes, offset + readBytes);
+        if (ret <= 0)
+            break;
+
+        readBytes += ret;
+    }
+
+    if (ret < 0 && !readBytes)
+        return -errno;
+
+    return readBytes;
+}
 
 /**
- * \brief Construct a File to represent the file \a name
- * \param[in] name The file name
+ * \brief Write data to the file at a given offset
+ * \param[in] offset The offset within the file to write to
+ * \param[in] data Memory containing data to be written
  *
- * Upon construction the File object is closed and shall be opened with open()
- * before performing I/O operations.
+ * Write at most \a data.size() bytes from \a data.data() to the file at
+ * \a offset, and return the number of bytes written. This function behaves as
+ * write(), except that it doesn't use or modify the position of the file as
+ * returned by pos().
+ *
+ * \return The number of bytes written on success, or a negative error code
+ * otherwise
  */
-File::File(const std::string &name)
-        : name_(name), mode_(OpenModeFlag::NotOpen), error_(0)
+ssize_t File::writeAt(off_t offset, const Span<const uint8_t> &data)
 {
+    if (!isOpen())
+        return -EINVAL;
+
+    ssize_t ret = checkDirectIo(data.data(), data.size(), offset);
+    if (ret < 0)
+        return ret;
+
+    size_t writtenBytes = 0;
+
+    /* Retry in case of partial writes. */
+    while (writtenBytes < data.size()) {
+        ret = ::pwrite(fd_.get(), data.data() + writtenBytes,
+                       data.size() - writtenBytes, offset + writtenBytes);
+        if (ret <= 0)
+            break;
+
+        writtenBytes += ret;
+    }
+
+    if (data.size() && !writtenBytes)
+        return -errno;
+
+    return writtenBytes;
 }
 
 /**
- * \brief Construct a File without an associated name
+ * \brief Read data from the file into multiple buffers
+ * \param[in] buffers The buffers to read data into
  *
- * Before being used for any purpose, the file name shall be set with
- * setFileName().
+ * Read data from the file at the current position into \a buffers, filling
+ * each buffer in turn before moving to the next one, with a single system call
+ * when possible. Partial reads are handled as in read().
+ *
+ * The position of the file as returned by pos() is advanced by the number of
+ * bytes read.
+ *
+ * \return The total number of bytes read on success, or a negative error code
+ * otherwise
  */
-File::File()
-        : mode_(OpenModeFlag::NotOpen), error_(0)
+ssize_t File::readv(const Span<const Span<uint8_t>> &buffers)
 {
+    if (!isOpen())
+        return -EINVAL;
+
+    return fileTransferVectored(buffers, directAlignment_,
+                                [&](const struct iovec *iov, int count,
+                                    [[maybe_unused]] size_t done) {
+                                    return ::readv(fd_.get(), iov, count);
+                                });
 }
 
 /**
- * \brief Destroy a File instance
+ * \brief Write data to the file from multiple buffers
+ * \param[in] buffers The buffers containing data to be written
  *
- * Any memory mapping associated with the File is unmapped, and the File is
- * closed if it is open.
+ * Write the contents of \a buffers to the file at the current position, in
+ * order, with a single system call when possible. Partial writes are handled as
+ * in write().
+ *
+ * The position of the file as returned by pos() is advanced by the number of
+ * bytes written.
+ *
+ * \return The total number of bytes written on success, or a negative error
+ * code otherwise
  */
-File::~File()
+ssize_t File::writev(const Span<const Span<const uint8_t>> &buffers)
 {
-    unmapAll();
-    close();
+    if (!isOpen())
+        return -EINVAL;
+
+    return fileTransferVectored(buffers, directAlignment_,
+                                [&](const struct iovec *iov, int count,
+                                    [[maybe_unused]] size_t done) {
+                                    return ::writev(fd_.get(), iov, count);
+                                });
 }
 
 /**
- * \fn const std::string &File::fileName() const
- * \brief Retrieve the file name
- * \return The file name
+ * \brief Read data from the file at a given offset into multiple buffers
+ * \param[in] offset The offset within the file to read from
+ * \param[in] buffers The buffers to read data into
+ * \param[in] flags The preadv2() RWF_* flags
+ *
+ * This function behaves as readv(), except that it reads data at \a offset
+ * and doesn't use or modify the position of the file as returned by pos().
+ *
+ * The \a flags are passed to the kernel for each read. With RWF_NOWAIT, the
+ * function returns the data that was available without blocking, or -EAGAIN
+ * if no data was available.
+ *
+ * \return The total number of bytes read on success, or a negative error code
+ * otherwise
  */
+ssize_t File::readvAt(off_t offset, const Span<const Span<uint8_t>> &buffers,
+                      int flags)
+{
+    if (!isOpen())
+        return -EINVAL;
+
+    if (!isDirectIoAligned(nullptr, 0, offset, directAlignment_))
+        return -EINVAL;
+
+    return fileTransferVectored(buffers, directAlignment_,
+                                [&](const struct iovec *iov, int count,
+                                    size_t done) {
+                                    return ::preadv2(fd_.get(), iov, count,
+                                                     offset + done, flags);
+                                });
+}
 
 /**
- * \brief Set the name of the file
- * \param[in] name The name of the file
+ * \brief Write data to the file at a given offset from multiple buffers
+ * \param[in] offset The offset within the file to write to
+ * \param[in] buffers The buffers containing data to be written
+ * \param[in] flags The pwritev2() RWF_* flags
  *
- * The \a name can contain an absolute path, a relative path or no path at all.
- * Calling this function on an open file results in undefined behaviour.
+ * This function behaves as writev(), except that it writes data at \a offset
+ * and doesn't use or modify the position of the file as returned by pos().
  *
- * Any memory mapping associated with the File is unmapped.
+ * The \a flags are passed to the kernel for each write, and allow for
+ * instance requesting per-write data integrity with RWF_DSYNC.
+ *
+ * \return The total number of bytes written on success, or a negative error
+ * code otherwise
  */
-void File::setFileName(const std::string &name)
+ssize_t File::writevAt(off_t offset,
+                       const Span<const Span<const uint8_t>> &buffers,
+                       int flags)
 {
-    if (isOpen()) {
-        LOG(File, Error)
-                << "Can't set file name on already open file " << name_;
-        return;
-    }
+    if (!isOpen())
+        return -EINVAL;
 
-    unmapAll();
+    if (!isDirectIoAligned(nullptr, 0, offset, directAlignment_))
+        return -EINVAL;
 
-    name_ = name;
+    return fileTransferVectored(buffers, directAlignment_,
+                                [&](const struct iovec *iov, int count,
+                                    size_t done) {
+                                    return ::pwritev2(fd_.get(), iov, count,
+                                                      offset + done, flags);
+                                });
 }
 
 /**
- * \brief Check if the file specified by fileName() exists
+ * \brief Copy data from the file to another file
+ * \param[in] dest The destination file
+ * \param[in] offset The offset within the file to copy from
+ * \param[in] size The number of bytes to copy
+ * \param[in] destOffset The offset within \a dest to copy to
  *
- * This function checks if the file specified by fileName() exists. The File
- * instance doesn't need to be open to check for file existence, and this
- * function may return false even if the file is open, if it was deleted from
- * the file system.
+ * Copy up to \a size bytes from the file at \a offset to \a dest at
+ * \a destOffset, stopping early at the end of the file. The copy is performed
+ * in the kernel with copy_file_range(), which avoids copying data through user
+ * space and allows file systems to share extents or offload the copy to the
+ * storage device. When copy_file_range() isn't supported for the two files,
+ * data is copied through an intermediate buffer.
  *
- * \return True if the the file exists, false otherwise
+ * The positions of both files as returned by pos() aren't modified.
+ *
+ * \return The number of bytes copied on success, or a negative error code
+ * otherwise
  */
-bool File::exists() const
+ssize_t File::copyTo(File &dest, off_t offset, size_t size, off_t destOffset)
 {
-    return exists(name_);
+    if (!isOpen() || !dest.isOpen() || offset < 0 || destOffset < 0)
+        return -EINVAL;
+
+    ssize_t ret = fileTransferLoop(size, [&](size_t done, size_t length) {
+        loff_t in = offset + done;
+        loff_t out = destOffset + done;
+        return copy_file_range(fd_.get(), &in, dest.fd_.get(), &out,
+                               length, 0);
+    });
+    if (!fileTransferUnsupported(ret))
+        return ret;
+
+    return transferBuffered(dest.fd_.get(), offset, size, destOffset);
 }
 
 /**
- * \brief Open the file in the given mode
- * \param[in] mode The open mode
+ * \brief Transfer data from the file to a file descriptor
+ * \param[in] fd The destination file descriptor
+ * \param[in] offset The offset within the file to transfer from
+ * \param[in] size The number of bytes to transfer
  *
- * This function opens the file specified by fileName() in \a mode. If the file
- * doesn't exist and the mode is WriteOnly or ReadWrite, this function will
- * attempt to create the file with initial permissions set to 0666 (modified by
- * the process' umask).
+ * Write up to \a size bytes from the file at \a offset to \a fd, stopping
+ * early at the end of the file. Data is written at the current position of
+ * \a fd, which is typically a pipe or a socket. The transfer is performed in
+ * the kernel with splice() when \a fd is a pipe, and sendfile() otherwise,
+ * falling back to an intermediate buffer when neither is supported.
  *
- * The file is opened with the O_CLOEXEC flag, and will be closed automatically
- * when a new binary is executed with one of the exec(3) functions.
+ * If \a fd is non-blocking, the function returns the number of bytes
+ * transferred before \a fd would block, or -EAGAIN if no data could be
+ * transferred. See FdPump to transfer data from the event loop.
  *
- * The error() status is updated.
+ * The position of the file as returned by pos() isn't modified.
  *
- * \return True on success, false otherwise
+ * \return The number of bytes transferred on success, or a negative error
+ * code otherwise
  */
-bool File::open(File::OpenMode mode)
+ssize_t File::transferTo(int fd, off_t offset, size_t size)
 {
-    if (isOpen()) {
-        LOG(File, Error) << "File " << name_ << " is already open";
-        return false;
-    }
+    if (!isOpen() || offset < 0)
+        return -EINVAL;
 
-    int flags = static_cast<OpenMode::Type>(mode & OpenModeFlag::ReadWrite) - 1;
-    if (mode & OpenModeFlag::WriteOnly)
-        flags |= O_CREAT;
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return -errno;
 
-    fd_ = UniqueFD(::open(name_.c_str(), flags | O_CLOEXEC, 0666));
-    if (!fd_.isValid()) {
-        error_ = -errno;
-        return false;
+    ssize_t ret;
+
+    if (S_ISFIFO(st.st_mode)) {
+        ret = fileTransferLoop(size, [&](size_t done, size_t length) {
+            loff_t in = offset + done;
+            return splice(fd_.get(), &in, fd, nullptr, length, SPLICE_F_MOVE);
+        });
+    } else {
+        ret = fileTransferLoop(size, [&](size_t done, size_t length) {
+            off_t in = offset + done;
+            return sendfile(fd, fd_.get(), &in, length);
+        });
     }
 
-    mode_ = mode;
-    error_ = 0;
-    return true;
+    if (!fileTransferUnsupported(ret))
+        return ret;
+
+    return transferBuffered(fd, offset, size, -1);
+}
+
+/**
+ * \brief Allocate storage space for a region of the file
+ * \param[in] offset The offset of the region within the file
+ * \param[in] size The size of the region in bytes
+ * \param[in] flags Allocation flags
+ *
+ * Reserve disk space for \a size bytes at \a offset with fallocate(). Writes
+ * to the region are then guaranteed not to fail with -ENOSPC, and file systems
+ * allocate the region contiguously, which avoids the fragmentation caused by
+ * extending a file with small appends. Regions that don't contain data read as
+ * zeros.
+ *
+ * The file is extended if the region reaches past its end, unless \a flags
+ * contains AllocateFlag::KeepSize. Without this flag, file systems that don't
+ * support fallocate() are emulated by writing zeros, otherwise -EOPNOTSUPP is
+ * returned.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int File::allocate(off_t offset, off_t size, AllocateFlags flags)
+{
+    if (!isOpen() || offset < 0 || size <= 0)
+        return -EINVAL;
+
+    int mode = flags & AllocateFlag::KeepSize ? FALLOC_FL_KEEP_SIZE : 0;
+    if (fallocate(fd_.get(), mode, offset, size) == 0)
+        return 0;
+
+    if (errno != EOPNOTSUPP || mode)
+        return -errno;
+
+    /* posix_fallocate() returns the error code instead of setting errno. */
+    return -posix_fallocate(fd_.get(), offset, size);
 }
 
 /**
- * \fn bool File::isOpen() const
- * \brief Check if the file is open
- * \return True if the file is open, false otherwise
+ * \brief Truncate or extend the file to a given size
+ * \param[in] size The new file size in bytes
+ *
+ * Data past \a size is discarded and its storage released, including space
+ * reserved by allocate() with AllocateFlag::KeepSize. If the file is extended,
+ * the new region reads as zeros.
+ *
+ * \return 0 on success, or a negative error code otherwise
  */
+int File::truncate(off_t size)
+{
+    if (!isOpen() || size < 0)
+        return -EINVAL;
 
-/**
- * \fn OpenMode File::openMode() const
- * \brief Retrieve the file open mode
- * \return The file open mode
- */
+    if (ftruncate(fd_.get(), size) < 0)
+        return -errno;
+
+    return 0;
+}
 
 /**
- * \brief Close the file
+ * \brief Release the storage of a region of the file
+ * \param[in] offset The offset of the region within the file
+ * \param[in] size The size of the region in bytes
  *
- * This function closes the File. If the File is not open, it performs no
- * operation. Memory mappings created with map() are not destroyed when the
- * file is closed.
+ * Deallocate the region with fallocate(), turning it into a hole that reads as
+ * zeros. The file size isn't modified. File systems release whole blocks only,
+ * partial blocks at the edges of the region are zeroed instead.
+ *
+ * \return 0 on success, or a negative error code otherwise
  */
-void File::close()
+int File::punchHole(off_t offset, off_t size)
 {
-    if (!fd_.isValid())
-        return;
+    if (!isOpen() || offset < 0 || size <= 0)
+        return -EINVAL;
 
-    fd_.reset();
-    mode_ = OpenModeFlag::NotOpen;
+    if (fallocate(fd_.get(), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  offset, size) < 0)
+        return -errno;
+
+    return 0;
 }
 
 /**
- * \fn int File::error() const
- * \brief Retrieve the file error status
+ * \brief Start writeback of the dirty pages of a region of the file
+ * \param[in] offset The offset of the region within the file
+ * \param[in] size The size of the region in bytes, or 0 to extend the region
+ * to the end of the file
  *
- * This function retrieves the error status from the last file open or I/O
- * operation. The error status is a negative number as defined by errno.h. If
- * no error occurred, this function returns 0.
+ * Initiate writeback of the dirty pages in the region with sync_file_range(),
+ * without waiting for it to complete. Together with waitWriteback(), this
+ * allows a writer to keep the amount of dirty data bounded, instead of letting
+ * it accumulate until the kernel flushes it in bursts that stall all writers:
  *
- * \return The file error status
+ * \code{.cpp}
+ * file.writeAt(offset, chunk);
+ * file.startWriteback(offset, chunk.size());
+ *
+ * if (offset >= chunk.size())
+ *         file.waitWriteback(offset - chunk.size(), chunk.size());
+ * \endcode
+ *
+ * This function doesn't guarantee durability, as it neither flushes file
+ * metadata nor the storage device cache. Use fdatasync() or File::syncAsync()
+ * for durability.
+ *
+ * \return 0 on success, or a negative error code otherwise
  */
+int File::startWriteback(off_t offset, off_t size)
+{
+    if (!isOpen() || offset < 0 || size < 0)
+        return -EINVAL;
+
+    if (sync_file_range(fd_.get(), offset, size, SYNC_FILE_RANGE_WRITE) < 0)
+        return -errno;
+
+    return 0;
+}
 
 /**
- * \brief Retrieve the file size
+ * \brief Write back the dirty pages of a region of the file and wait
+ * \param[in] offset The offset of the region within the file
+ * \param[in] size The size of the region in bytes, or 0 to extend the region
+ * to the end of the file
  *
- * This function retrieves the size of the file on the filesystem. The File
- * instance shall be open to retrieve its size. The error() status is not
- * modified, error codes are returned directly on failure.
+ * Write back all dirty pages in the region with sync_file_range(), and wait
+ * until writeback completes, including writeback started by startWriteback().
+ * As for startWriteback(), this function doesn't guarantee durability.
  *
- * \return The file size in bytes on success, or a negative error code otherwise
+ * \return 0 on success, or a negative error code otherwise
  */
-ssize_t File::size() const
+int File::waitWriteback(off_t offset, off_t size)
 {
-    if (!isOpen())
+    if (!isOpen() || offset < 0 || size < 0)
         return -EINVAL;
 
-    struct stat st;
-    int ret = fstat(fd_.get(), &st);
-    if (ret < 0)
+    if (sync_file_range(fd_.get(), offset, size,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                SYNC_FILE_RANGE_WAIT_AFTER) < 0)
         return -errno;
 
-    return st.st_size;
+    return 0;
+}
+
+/*
+ * Copy data from the file to \a fd through an intermediate buffer, writing at
+ * \a destOffset, or at the current position of \a fd if \a destOffset is
+ * negative.
+ */
+ssize_t File::transferBuffered(int fd, off_t offset, size_t size,
+                               off_t destOffset)
+{
+    static constexpr size_t kBufferSize = 1024 * 1024;
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    /* Page alignment satisfies direct I/O constraints on either side. */
+    AlignedBuffer buffer(std::min(size, kBufferSize),
+                         std::max(directAlignment_, pageSize));
+    if (!buffer.isValid())
+        return size ? -ENOMEM : 0;
+
+    size_t transferred = 0;
+
+    while (transferred < size) {
+        size_t length = std::min(size - transferred, buffer.size());
+        ssize_t ret = ::pread(fd_.get(), buffer.data(), length,
+                              offset + transferred);
+        if (ret <= 0) {
+            if (ret < 0 && !transferred)
+                return -errno;
+            break;
+        }
+
+        size_t chunk = ret;
+        size_t written = 0;
+
+        while (written < chunk) {
+            if (destOffset >= 0)
+                ret = ::pwrite(fd, buffer.data() + written, chunk - written,
+                             destOffset + transferred + written);
+            else
+                ret = ::write(fd, buffer.data() + written, chunk - written);
+            if (ret <= 0)
+                break;
+
+            written += ret;
+        }
+
+        transferred += written;
+
+        if (written < chunk) {
+            if (!transferred)
+                return -errno;
+            break;
+        }
+    }
+
+    return transferred;
 }
 
 /**
- * \brief Return current read or write position
+ * \brief Read data from the file asynchronously
+ * \param[in] offset The offset within the file to read from
+ * \param[in] data Memory to read data into
  *
- * If the file is closed, this function returns 0.
+ * Queue a read of \a data.size() bytes at \a offset into \a data.data().
+ * Short reads are retried, the operation completes when the buffer is full,
+ * the end of the file is reached, or an error occurs. The position of the file
+ * as returned by pos() isn't modified.
  *
- * \return The current read or write position
+ * The \a data memory shall stay valid until the ioCompleted signal is emitted
+ * with the returned request identifier.
+ *
+ * \return A positive request identifier on success, or a negative error code
+ * otherwise
  */
-off_t File::pos() const
+int64_t File::readAsync(off_t offset, const Span<uint8_t> &data)
 {
-    if (!isOpen())
-        return 0;
+    if (!(mode_ & OpenModeFlag::ReadOnly))
+        return isOpen() ? -EBADF : -EINVAL;
 
-    return lseek(fd_.get(), 0, SEEK_CUR);
+    int ret = checkDirectIo(data.data(), data.size(), offset);
+    if (ret < 0)
+        return ret;
+
+    return submitAsync(IoOperation::Read, offset, data.data(), data.size());
 }
 
 /**
- * \brief Set the read or write position
- * \param[in] pos The desired position
- * \return The resulting offset from the beginning of the file on success, or a
- * negative error code otherwise
+ * \brief Write data to the file asynchronously
+ * \param[in] offset The offset within the file to write to
+ * \param[in] data Memory containing data to be written
+ *
+ * Queue a write of \a data.size() bytes from \a data.data() at \a offset.
+ * Short writes are retried, the operation completes when all data has been
+ * written or an error occurs. The position of the file as returned by pos()
+ * isn't modified.
+ *
+ * The \a data memory shall stay valid until the ioCompleted signal is emitted
+ * with the returned request identifier.
+ *
+ * \return A positive request identifier on success, or a negative error code
+ * otherwise
  */
-off_t File::seek(off_t pos)
+int64_t File::writeAsync(off_t offset, const Span<const uint8_t> &data)
 {
-    if (!isOpen())
-        return -EINVAL;
+    if (!(mode_ & OpenModeFlag::WriteOnly))
+        return isOpen() ? -EBADF : -EINVAL;
 
-    off_t ret = lseek(fd_.get(), pos, SEEK_SET);
+    int ret = checkDirectIo(data.data(), data.size(), offset);
     if (ret < 0)
-        return -errno;
+        return ret;
 
-    return ret;
+    return submitAsync(IoOperation::Write, offset,
+                       const_cast<uint8_t *>(data.data()), data.size());
 }
 
 /**
- * \brief Read data from the file
- * \param[in] data Memory to read data into
+ * \brief Flush the file to storage asynchronously
  *
- * Read at most \a data.size() bytes from the file into \a data.data(), and
- * return the number of bytes read. If less data than requested is available,
- * the returned byte count may be smaller than the requested size. If no more
- * data is available, 0 is returned.
+ * Queue an fsync() of the file. Requests are not ordered, a sync only covers
+ * the writes that have completed when it is submitted.
  *
- * The position of the file as returned by pos() is advanced by the number of
- * bytes read. If an error occurs, the position isn't modified.
- *
- * \return The number of bytes read on success, or a negative error code
+ * \return A positive request identifier on success, or a negative error code
  * otherwise
  */
-ssize_t File::read(const Span<uint8_t> &data)
+int64_t File::syncAsync()
 {
     if (!isOpen())
         return -EINVAL;
 
-    size_t readBytes = 0;
-    ssize_t ret = 0;
-
-    /* Retry in case of interrupted system calls. */
-    while (readBytes < data.size()) {
-        ret = ::read(fd_.get(), data.data() + readBytes,
-                     data.size() - readBytes);
-        if (ret <= 0)
-            break;
-
-        readBytes += ret;
-    }
-
-    if (ret < 0 && !readBytes)
-        return -errno;
+    return submitAsync(IoOperation::Sync, 0, nullptr, 0);
+}
 
-    return readBytes;
+/**
+ * \brief Retrieve the number of bytes of asynchronous operations in flight
+ *
+ * The count covers all read and write requests that have been submitted and
+ * haven't completed yet, including requests queued due to the queue depth
+ * limit.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The number of bytes in flight
+ */
+size_t File::bytesInFlight() const
+{
+    return io_->bytesInFlight.load(std::memory_order_relaxed);
 }
 
 /**
- * \brief Write data to the file
- * \param[in] data Memory containing data to be written
+ * \brief Set the maximum number of asynchronous operations in flight
+ * \param[in] depth The queue depth
  *
- * Write at most \a data.size() bytes from \a data.data() to the file, and
- * return the number of bytes written. If the file system doesn't have enough
- * space for the data, the returned byte count may be less than requested.
+ * The queue depth is shared by all File instances in the process, and is
+ * clamped to the [1, 256] range. It defaults to 32.
  *
- * The position of the file as returned by pos() is advanced by the number of
- * bytes written. If an error occurs, the position isn't modified.
+ * \context This function is \threadsafe.
+ */
+void File::setAsyncQueueDepth(unsigned int depth)
+{
+    FileIoEngine::instance()->setQueueDepth(depth);
+}
+
+/**
+ * \var File::ioCompleted
+ * \brief Signal emitted when an asynchronous operation completes
  *
- * \return The number of bytes written on success, or a negative error code
- * otherwise
+ * The signal is emitted in the thread that submitted the operation, with the
+ * request identifier and the operation result. The result is the number of
+ * bytes transferred for reads and writes, 0 for syncs and prefetches, or a
+ * negative error code. A read or write that fails after a partial transfer
+ * reports the number of bytes transferred.
+ *
+ * The thread shall run an event loop for the signal to be emitted.
+ * Asynchronous operations can't be submitted from threads without an event
+ * dispatcher, as their completion would never be delivered.
  */
-ssize_t File::write(const Span<const uint8_t> &data)
+
+int64_t File::submitAsync(IoOperation operation, off_t offset, uint8_t *data,
+                          size_t size)
 {
-    if (!isOpen())
+    if (offset < 0)
         return -EINVAL;
 
-    size_t writtenBytes = 0;
+    /* Completions are posted to the thread, which must process them. */
+    if (!Thread::current()->hasEventDispatcher())
+        return -ENOTSUP;
 
-    /* Retry in case of interrupted system calls. */
-    while (writtenBytes < data.size()) {
-        ssize_t ret = ::write(fd_.get(), data.data() + writtenBytes,
-                              data.size() - writtenBytes);
-        if (ret <= 0)
-            break;
+    uint64_t id = io_->nextId.fetch_add(1, std::memory_order_relaxed);
 
-        writtenBytes += ret;
+    io_->bytesInFlight.fetch_add(size, std::memory_order_relaxed);
+
+    {
+        MutexLocker locker(io_->mutex);
+        io_->pending++;
     }
 
-    if (data.size() && !writtenBytes)
-        return -errno;
+    FileIoEngine::instance()->submit(new FileIoRequest(io_, id, operation,
+                                                       fd_.get(), offset,
+                                                       data, size));
 
-    return writtenBytes;
+    return id;
+}
+
+void File::waitAsync()
+{
+    MutexLocker locker(io_->mutex);
+    io_->cv.wait(locker, [&]() ZEUS_TSA_REQUIRES(io_->mutex) {
+        return !io_->pending;
+    });
 }
 
 /**
@@ -392,6 +2148,13 @@ ssize_t File::write(const Span<const uint8_t> &data)
  * flags contains MapFlag::Private in which case the region is mapped in
  * read/write mode.
  *
+ * With MapFlag::Populate the page tables of the whole region are populated
+ * before the function returns, reading the file contents as needed. The
+ * MapFlag::Sequential, MapFlag::Random, MapFlag::WillNeed and
+ * MapFlag::HugePage flags are applied to the region with advise(), and
+ * MapFlag::Locked locks it in memory with lock(). Failures to apply those
+ * hints are logged but don't cause the mapping to fail.
+ *
  * The error() status is updated.
  *
  * \return The mapped memory on success, or an empty span otherwise
@@ -413,7 +2176,14 @@ Span<uint8_t> File::map(off_t offset, ssize_t size, File::MapFlags flags)
         size -= offset;
     }
 
+    if ((flags & MapFlag::Sequential) && (flags & MapFlag::Random)) {
+        error_ = -EINVAL;
+        return {};
+    }
+
     int mmapFlags = flags & MapFlag::Private ? MAP_PRIVATE : MAP_SHARED;
+    if (flags & MapFlag::Populate)
+        mmapFlags |= MAP_POPULATE;
 
     int prot = 0;
     if (mode_ & OpenModeFlag::ReadOnly)
@@ -431,8 +2201,25 @@ Span<uint8_t> File::map(off_t offset, ssize_t size, File::MapFlags flags)
 
     maps_.emplace(map, size);
 
+    Span<uint8_t> region{ static_cast<uint8_t *>(map), static_cast<size_t>(size) };
+
+    /* Hints are best effort, failures don't prevent using the mapping. */
+    int ret = advise(region, flags);
+    if (ret < 0)
+        LOG(File, Warning)
+                << "Failed to advise mapping of " << name_ << ": "
+                << strerror(-ret);
+
+    if (flags & MapFlag::Locked) {
+        ret = lock(region);
+        if (ret < 0)
+            LOG(File, Warning)
+                    << "Failed to lock mapping of " << name_ << ": "
+                    << strerror(-ret);
+    }
+
     error_ = 0;
-    return { static_cast<uint8_t *>(map), static_cast<size_t>(size) };
+    return region;
 }
 
 /**
@@ -451,6 +2238,8 @@ bool File::unmap(uint8_t *addr)
         return false;
     }
 
+    waitAsync();
+
     int ret = munmap(addr, iter->second);
     if (ret < 0) {
         error_ = -errno;
@@ -463,14 +2252,186 @@ bool File::unmap(uint8_t *addr)
     return true;
 }
 
+/**
+ * \brief Apply access pattern hints to a mapped region
+ * \param[in] region The memory region, within a mapping created by map()
+ * \param[in] advice The hints to apply
+ *
+ * Apply the MapFlag::Sequential, MapFlag::Random, MapFlag::WillNeed and
+ * MapFlag::HugePage hints in \a advice to \a region with madvise(). Other
+ * flags are ignored. The region is expanded to page boundaries.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int File::advise(const Span<const uint8_t> &region, MapFlags advice)
+{
+    static const struct {
+        MapFlag flag;
+        int advice;
+    } advices[] = {
+        { MapFlag::Sequential, MADV_SEQUENTIAL },
+        { MapFlag::Random, MADV_RANDOM },
+        { MapFlag::WillNeed, MADV_WILLNEED },
+        { MapFlag::HugePage, MADV_HUGEPAGE },
+    };
+
+    if (!isMapped(region))
+        return -EINVAL;
+
+    auto [addr, size] = pageAlign(region);
+
+    for (const auto &entry : advices) {
+        if (!(advice & entry.flag))
+            continue;
+
+        if (madvise(addr, size, entry.advice) < 0)
+            return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Fault in the pages of a mapped region
+ * \param[in] region The memory region, within a mapping created by map()
+ *
+ * Read the file contents backing \a region and populate the page tables, so
+ * that later accesses don't page fault. The function blocks until all pages
+ * are resident, see prefetchAsync() to prefetch in the background.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int File::prefetch(const Span<const uint8_t> &region)
+{
+    if (!isMapped(region))
+        return -EINVAL;
+
+    auto [addr, size] = pageAlign(region);
+    return mapPrefetch(addr, size);
+}
+
+/**
+ * \brief Fault in the pages of a mapped region in the background
+ * \param[in] region The memory region, within a mapping created by map()
+ *
+ * Queue a prefetch() of \a region on a background thread. Completion is
+ * reported through the ioCompleted signal, with the number of bytes in flight
+ * accounting for the region size. Unmapping a region waits for all
+ * asynchronous operations of the File to complete.
+ *
+ * \return A positive request identifier on success, or a negative error code
+ * otherwise
+ */
+int64_t File::prefetchAsync(const Span<const uint8_t> &region)
+{
+    if (!isMapped(region))
+        return -EINVAL;
+
+    auto [addr, size] = pageAlign(region);
+    return submitAsync(IoOperation::Prefetch, 0, addr, size);
+}
+
+/**
+ * \brief Lock a mapped region in memory
+ * \param[in] region The memory region, within a mapping created by map()
+ *
+ * Lock the pages of \a region in memory with mlock(), faulting them in if
+ * needed. Locked pages are never evicted, which guarantees fault-free access
+ * to hot data. The amount of locked memory is limited by RLIMIT_MEMLOCK for
+ * unprivileged processes.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int File::lock(const Span<const uint8_t> &region)
+{
+    if (!isMapped(region))
+        return -EINVAL;
+
+    auto [addr, size] = pageAlign(region);
+    if (mlock(addr, size) < 0)
+        return -errno;
+
+    return 0;
+}
+
+/**
+ * \brief Unlock a mapped region locked with lock()
+ * \param[in] region The memory region, within a mapping created by map()
+ * \return 0 on success, or a negative error code otherwise
+ */
+int File::unlock(const Span<const uint8_t> &region)
+{
+    if (!isMapped(region))
+        return -EINVAL;
+
+    auto [addr, size] = pageAlign(region);
+    if (munlock(addr, size) < 0)
+        return -errno;
+
+    return 0;
+}
+
+/**
+ * \brief Count the resident pages of a mapped region
+ * \param[in] region The memory region, within a mapping created by map()
+ *
+ * Query the residency of the pages of \a region in the page cache with
+ * mincore(). Compared to the number of pages in the region, this allows
+ * verifying that a region has been warmed up.
+ *
+ * \return The number of resident pages on success, or a negative error code
+ * otherwise
+ */
+ssize_t File::residentPages(const Span<const uint8_t> &region) const
+{
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    if (!isMapped(region))
+        return -EINVAL;
+
+    auto [addr, size] = pageAlign(region);
+    std::vector<unsigned char> pages(size / pageSize);
+
+    if (mincore(addr, size, pages.data()) < 0)
+        return -errno;
+
+    return std::count_if(pages.begin(), pages.end(),
+                         [](unsigned char page) { return page & 1; });
+}
+
 void File::unmapAll()
 {
+    if (maps_.empty())
+        return;
+
+    waitAsync();
+
     for (const auto &map : maps_)
         munmap(map.first, map.second);
 
     maps_.clear();
 }
 
+int File::checkDirectIo(const void *data, size_t size, off_t offset) const
+{
+    if (!isDirectIoAligned(data, size, offset, directAlignment_))
+        return -EINVAL;
+
+    return 0;
+}
+
+bool File::isMapped(const Span<const uint8_t> &region) const
+{
+    auto iter = maps_.upper_bound(const_cast<uint8_t *>(region.data()));
+    if (iter == maps_.begin())
+        return false;
+
+    --iter;
+
+    const uint8_t *start = static_cast<const uint8_t *>(iter->first);
+    return region.data() + region.size() <= start + iter->second;
+}
+
 /**
  * \brief Check if the file specified by \a name exists
  * \param[in] name The file name
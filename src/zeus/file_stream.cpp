@@ -0,0 +1,729 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: file_stream.cpp - Buffered streaming reader and writer over File
+//
+
+#include <algorithm>
+#include <deque>
+#include <errno.h>
+#include <functional>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include <zeus/file_stream.h>
+#include <zeus/mutex.h>
+#include <zeus/thread.h>
+
+/**
+ * \file file_stream.h
+ * \brief Buffered streaming reader and writer over File
+ */
+
+namespace zeus {
+
+/*
+ * Background job of a FileReader or FileWriter. Each reader and writer runs
+ * one job at a time, and waits for the previous job to complete before
+ * submitting a new one.
+ */
+class FileStreamJob
+{
+public:
+    FileStreamJob()
+        : busy_(false)
+    {
+    }
+
+    ~FileStreamJob()
+    {
+        wait();
+    }
+
+    void submit(std::function<void()> func);
+    void wait();
+    void run();
+
+private:
+    std::function<void()> func_;
+
+    Mutex mutex_;
+    ConditionVariable cv_;
+    bool busy_ ZEUS_TSA_GUARDED_BY(mutex_);
+};
+
+/*
+ * Process-wide pool of threads running the jobs of all readers and writers.
+ * Threads are started on demand, up to a maximum count.
+ */
+class FileStreamPool
+{
+public:
+    static FileStreamPool *instance();
+
+    ~FileStreamPool();
+
+    void submit(FileStreamJob *job);
+
+private:
+    static constexpr unsigned int kMaxWorkers = 8;
+
+    class Worker : public Thread
+    {
+    public:
+        Worker(FileStreamPool *pool)
+            : pool_(pool)
+        {
+        }
+
+    protected:
+        void run() override
+        {
+            pool_->run();
+        }
+
+    private:
+        FileStreamPool *pool_;
+    };
+
+    FileStreamPool();
+
+    void run();
+
+    Mutex mutex_;
+    ConditionVariable cv_;
+    std::deque<FileStreamJob *> jobs_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::vector<std::unique_ptr<Worker>> workers_ ZEUS_TSA_GUARDED_BY(mutex_);
+    unsigned int idle_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool stop_ ZEUS_TSA_GUARDED_BY(mutex_);
+};
+
+void FileStreamJob::submit(std::function<void()> func)
+{
+    {
+        MutexLocker locker(mutex_);
+        func_ = std::move(func);
+        busy_ = true;
+    }
+
+    FileStreamPool::instance()->submit(this);
+}
+
+void FileStreamJob::wait()
+{
+    MutexLocker locker(mutex_);
+    cv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) { return !busy_; });
+}
+
+void FileStreamJob::run()
+{
+    func_();
+
+    /* Notify with the lock held, the owner may destroy the job right after. */
+    MutexLocker locker(mutex_);
+    busy_ = false;
+    cv_.notify_all();
+}
+
+FileStreamPool::FileStreamPool()
+        : idle_(0), stop_(false)
+{
+}
+
+FileStreamPool::~FileStreamPool()
+{
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    {
+        MutexLocker locker(mutex_);
+        stop_ = true;
+        workers = std::move(workers_);
+    }
+
+    cv_.notify_all();
+
+    for (std::unique_ptr<Worker> &worker : workers)
+        worker->wait();
+}
+
+FileStreamPool *FileStreamPool::instance()
+{
+    static FileStreamPool pool;
+    return &pool;
+}
+
+void FileStreamPool::submit(FileStreamJob *job)
+{
+    {
+        MutexLocker locker(mutex_);
+
+        jobs_.push_back(job);
+
+        if (!idle_ && workers_.size() < kMaxWorkers) {
+            auto worker = std::make_unique<Worker>(this);
+            worker->start();
+            workers_.push_back(std::move(worker));
+            return;
+        }
+    }
+
+    cv_.notify_one();
+}
+
+void FileStreamPool::run()
+{
+    MutexLocker locker(mutex_);
+
+    while (true) {
+        idle_++;
+        cv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) {
+            return stop_ || !jobs_.empty();
+        });
+        idle_--;
+
+        if (jobs_.empty())
+            break;
+
+        FileStreamJob *job = jobs_.front();
+        jobs_.pop_front();
+
+        locker.unlock();
+        job->run();
+        locker.lock();
+    }
+}
+
+/*
+ * Compute the buffer alignment for a file, suitable for direct I/O when the
+ * file is open with File::OpenModeFlag::Direct.
+ */
+static size_t bufferAlignment(const File &file)
+{
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    return std::max(file.directIoAlignment(), pageSize);
+}
+
+/**
+ * \class FileReader
+ * \brief Buffered sequential reader for File
+ *
+ * The FileReader class streams the contents of a File through large aligned
+ * buffers, and is the preferred way to parse large files. Data is read ahead
+ * by a process-wide pool of background threads with double buffering: while
+ * the caller consumes one buffer, the next one is filled. Reads use
+ * File::readAt() and don't modify the position of the file.
+ *
+ * Lines and records are returned as views into the buffers, without copying,
+ * except when they span two buffers in which case they are assembled in an
+ * internal buffer. The returned views are valid until the next read call on
+ * the reader.
+ *
+ * Files open with File::OpenModeFlag::Direct are supported, the buffers are
+ * then aligned to File::directIoAlignment() and the data bypasses the page
+ * cache.
+ *
+ * The File shall stay open and shall not be modified concurrently for the
+ * lifetime of the reader.
+ */
+
+/**
+ * \var FileReader::kDefaultBufferSize
+ * \brief The default size of each of the two read buffers
+ */
+
+/**
+ * \brief Construct a FileReader
+ * \param[in] file The file to read
+ * \param[in] offset The offset within \a file to start reading from
+ * \param[in] bufferSize The size of each of the two read buffers
+ *
+ * Reading ahead starts immediately in the background.
+ */
+FileReader::FileReader(File &file, off_t offset, size_t bufferSize)
+        : file_(file), current_(1), length_(0), pos_(0), skip_(0),
+          offset_(offset), readOffset_(0), end_(false), error_(0),
+          job_(std::make_unique<FileStreamJob>())
+{
+    size_t alignment = bufferAlignment(file);
+
+    for (Chunk &chunk : chunks_) {
+        chunk.buffer = AlignedBuffer(bufferSize, alignment);
+        chunk.result = 0;
+
+        if (!chunk.buffer.isValid()) {
+            error_ = -ENOMEM;
+            end_ = true;
+            return;
+        }
+    }
+
+    /* Align reads for direct I/O, and skip the data before the offset. */
+    readOffset_ = offset & ~static_cast<off_t>(alignment - 1);
+    skip_ = offset - readOffset_;
+
+    readAhead(0);
+}
+
+FileReader::~FileReader()
+{
+}
+
+/**
+ * \brief Read the next line
+ * \param[out] line The line, without the delimiter
+ * \param[in] delimiter The line delimiter
+ *
+ * Read data up to the next \a delimiter. The last line of the file is returned
+ * even if it isn't terminated by a delimiter.
+ *
+ * \return True if a line has been read, or false at the end of the file or if
+ * an error occurred, in which case error() is set
+ */
+bool FileReader::readLine(std::string_view *line, char delimiter)
+{
+    carry_.clear();
+
+    while (true) {
+        if (pos_ >= length_) {
+            if (!fetch())
+                break;
+            continue;
+        }
+
+        const char *start = reinterpret_cast<const char *>(chunks_[current_].buffer.data()) + pos_;
+        size_t available = length_ - pos_;
+        const char *end = static_cast<const char *>(memchr(start, delimiter, available));
+
+        if (end) {
+            size_t size = end - start;
+
+            pos_ += size + 1;
+            offset_ += size + 1;
+
+            if (carry_.empty()) {
+                *line = { start, size };
+            } else {
+                carry_.append(start, size);
+                *line = carry_;
+            }
+
+            return true;
+        }
+
+        /* The line continues in the next buffer. */
+        carry_.append(start, available);
+        pos_ += available;
+        offset_ += available;
+    }
+
+    if (error_ || carry_.empty())
+        return false;
+
+    *line = carry_;
+    return true;
+}
+
+/**
+ * \brief Read the next fixed-size record
+ * \param[in] size The record size in bytes
+ * \param[out] record The record data
+ *
+ * If the file ends before a complete record, the partial record is consumed and
+ * error() is set to -ENODATA.
+ *
+ * \return True if a record has been read, or false at the end of the file or
+ * if an error occurred, in which case error() is set
+ */
+bool FileReader::readRecord(size_t size, Span<const uint8_t> *record)
+{
+    if (pos_ >= length_ && !fetch())
+        return false;
+
+    const uint8_t *start = chunks_[current_].buffer.data() + pos_;
+
+    if (length_ - pos_ >= size) {
+        pos_ += size;
+        offset_ += size;
+        *record = { start, size };
+        return true;
+    }
+
+    /* The record continues in the next buffer. */
+    carry_.clear();
+
+    while (carry_.size() < size) {
+        if (pos_ >= length_) {
+            if (!fetch())
+                break;
+            continue;
+        }
+
+        size_t length = std::min(size - carry_.size(), length_ - pos_);
+        carry_.append(reinterpret_cast<const char *>(chunks_[current_].buffer.data()) + pos_,
+                      length);
+        pos_ += length;
+        offset_ += length;
+    }
+
+    if (carry_.size() < size) {
+        if (!error_)
+            error_ = -ENODATA;
+        return false;
+    }
+
+    *record = { reinterpret_cast<const uint8_t *>(carry_.data()), size };
+    return true;
+}
+
+/**
+ * \fn FileReader::offset()
+ * \brief Retrieve the file offset of the next byte to be read
+ * \return The file offset of the next byte to be read
+ */
+
+/**
+ * \fn FileReader::error()
+ * \brief Retrieve the reader error status
+ * \return 0 if no error occurred, or a negative error code otherwise
+ */
+
+void FileReader::readAhead(unsigned int index)
+{
+    Chunk *chunk = &chunks_[index];
+    off_t offset = readOffset_;
+
+    readOffset_ += chunk->buffer.size();
+
+    job_->submit([this, chunk, offset]() {
+        chunk->result = file_.readAt(offset, chunk->buffer.span());
+    });
+}
+
+/*
+ * Switch to the buffer being read ahead, and start reading ahead in the
+ * buffer that has been consumed. Return false if no more data is available.
+ */
+bool FileReader::fetch()
+{
+    if (end_)
+        return false;
+
+    job_->wait();
+
+    current_ ^= 1;
+    Chunk &chunk = chunks_[current_];
+
+    if (chunk.result < 0) {
+        error_ = chunk.result;
+        end_ = true;
+        return false;
+    }
+
+    length_ = chunk.result;
+    pos_ = std::min(skip_, length_);
+    skip_ = 0;
+
+    /* A short read marks the end of the file. */
+    if (length_ < chunk.buffer.size())
+        end_ = true;
+    else
+        readAhead(current_ ^ 1);
+
+    return pos_ < length_;
+}
+
+/**
+ * \class FileWriter
+ * \brief Buffered sequential writer for File
+ *
+ * The FileWriter class accumulates data in large aligned buffers, and writes
+ * full buffers to the File from a process-wide pool of background threads
+ * while the caller fills the next buffer. Writes use File::writeAt() and don't
+ * modify the position of the file.
+ *
+ * Records can be written with write(), or built in place with reserve() and
+ * commit() to avoid copies. Buffered data is written when a buffer is full,
+ * and when flush() is called or the writer is destroyed.
+ *
+ * Write errors are sticky: after an error, all subsequent operations fail with
+ * the same error, reported by error().
+ *
+ * For files open with File::OpenModeFlag::Direct, buffers are aligned to
+ * File::directIoAlignment(), and only whole aligned blocks are written. An
+ * unaligned start offset is handled by reading the block that contains it
+ * first. The unaligned tail of a buffer is kept for the next write, and when
+ * flushing, it is written padded with the current file contents up to the
+ * alignment, after which the file is truncated back to its real end. Padding
+ * requires the file to be readable when data follows the end of the written
+ * data, flush() fails with -EBADF otherwise.
+ *
+ * The File shall stay open for the lifetime of the writer.
+ */
+
+/**
+ * \var FileWriter::kDefaultBufferSize
+ * \brief The default size of each of the two write buffers
+ */
+
+/**
+ * \brief Construct a FileWriter
+ * \param[in] file The file to write to
+ * \param[in] offset The offset within \a file to start writing at
+ * \param[in] bufferSize The size of each of the two write buffers
+ */
+FileWriter::FileWriter(File &file, off_t offset, size_t bufferSize)
+        : file_(file), current_(0), length_(0), directAlignment_(0),
+          writeOffset_(offset), pendingSize_(0), pendingResult_(0), error_(0),
+          job_(std::make_unique<FileStreamJob>())
+{
+    size_t alignment = bufferAlignment(file);
+
+    for (AlignedBuffer &buffer : buffers_) {
+        buffer = AlignedBuffer(bufferSize, alignment);
+        if (!buffer.isValid())
+            error_ = -ENOMEM;
+    }
+
+    if (error_ || !(file.openMode() & File::OpenModeFlag::Direct))
+        return;
+
+    directAlignment_ = file.directIoAlignment();
+
+    size_t head = directAlignment_ ? offset % directAlignment_ : 0;
+    if (!head)
+        return;
+
+    /* Start at the aligned block containing the offset, keeping its data. */
+    writeOffset_ = offset - head;
+    length_ = head;
+
+    ssize_t ret = file_.readAt(writeOffset_, { buffers_[0].data(), directAlignment_ });
+    if (ret < 0)
+        error_ = ret;
+    else if (static_cast<size_t>(ret) < head)
+        memset(buffers_[0].data() + ret, 0, head - ret);
+}
+
+/**
+ * \brief Destroy the FileWriter
+ *
+ * Buffered data is flushed to the file.
+ */
+FileWriter::~FileWriter()
+{
+    flush();
+}
+
+/**
+ * \brief Write data
+ * \param[in] data The data to write
+ *
+ * The data is copied to the write buffers, and written to the file in the
+ * background when a buffer is full.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FileWriter::write(const Span<const uint8_t> &data)
+{
+    const uint8_t *src = data.data();
+    size_t size = data.size();
+
+    while (size && !error_) {
+        AlignedBuffer &buffer = buffers_[current_];
+        size_t length = std::min(size, buffer.size() - length_);
+
+        memcpy(buffer.data() + length_, src, length);
+        length_ += length;
+        src += length;
+        size -= length;
+
+        if (length_ == buffer.size())
+            writeBehind();
+    }
+
+    return error_;
+}
+
+/**
+ * \brief Write a string
+ * \param[in] data The string to write
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FileWriter::write(std::string_view data)
+{
+    return write({ reinterpret_cast<const uint8_t *>(data.data()), data.size() });
+}
+
+/**
+ * \brief Reserve space for a record in the write buffer
+ * \param[in] size The record size in bytes
+ *
+ * Return a span of \a size bytes in the write buffer, to be filled by the
+ * caller and committed with commit(). If the current buffer doesn't have
+ * enough space left, its contents are written to the file first.
+ *
+ * \return The reserved space, or an empty span if \a size is larger than the
+ * buffer size or an error occurred
+ */
+Span<uint8_t> FileWriter::reserve(size_t size)
+{
+    if (error_ || size > buffers_[current_].size())
+        return {};
+
+    if (buffers_[current_].size() - length_ < size)
+        writeBehind();
+
+    /* With direct I/O, the unaligned tail carried over takes space. */
+    if (error_ || buffers_[current_].size() - length_ < size)
+        return {};
+
+    return { buffers_[current_].data() + length_, size };
+}
+
+/**
+ * \brief Commit data written to space returned by reserve()
+ * \param[in] size The number of bytes to commit
+ *
+ * The \a size shall not be larger than the size passed to reserve().
+ */
+void FileWriter::commit(size_t size)
+{
+    length_ += size;
+
+    if (length_ == buffers_[current_].size())
+        writeBehind();
+}
+
+/**
+ * \brief Write all buffered data to the file
+ *
+ * Write the current buffer and wait for all writes to complete. Flushing
+ * doesn't synchronize the file to storage.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FileWriter::flush()
+{
+    if (length_ && !error_)
+        writeBehind(true);
+
+    complete();
+
+    return error_;
+}
+
+/**
+ * \fn FileWriter::offset()
+ * \brief Retrieve the file offset of the next byte to be written
+ * \return The file offset of the next byte to be written
+ */
+
+/**
+ * \fn FileWriter::error()
+ * \brief Retrieve the writer error status
+ * \return 0 if no error occurred, or a negative error code otherwise
+ */
+
+/*
+ * Hand the current buffer to the background thread, once the previous write
+ * has completed, and switch to the other buffer.
+ *
+ * With direct I/O, the unaligned tail of the buffer is moved to the start of
+ * the other buffer, to be written with the following data. When flushing, the
+ * tail block is also written, padded with the current file contents, and the
+ * file is then truncated back to its real end if the padding extended it.
+ */
+void FileWriter::writeBehind(bool flush)
+{
+    complete();
+    if (error_)
+        return;
+
+    AlignedBuffer &buffer = buffers_[current_];
+    AlignedBuffer &next = buffers_[current_ ^ 1];
+    size_t tail = directAlignment_ ? length_ % directAlignment_ : 0;
+    size_t size = length_ - tail;
+    off_t truncateSize = -1;
+
+    if (tail && flush) {
+        off_t end = writeOffset_ + length_;
+        ssize_t fileSize = file_.size();
+
+        /* The other buffer is free, use it to read the tail block. */
+        ssize_t ret = file_.readAt(writeOffset_ + size,
+                                   { next.data(), directAlignment_ });
+
+        /* Padding with zeros would overwrite the data following the tail. */
+        if (ret < 0 && (fileSize < 0 || fileSize > end)) {
+            error_ = -EBADF;
+            return;
+        }
+
+        size_t valid = ret > 0 ? ret : 0;
+        if (valid < directAlignment_)
+            memset(next.data() + valid, 0, directAlignment_ - valid);
+
+        memcpy(buffer.data() + length_, next.data() + tail,
+               directAlignment_ - tail);
+        size += directAlignment_;
+
+        if (fileSize >= 0 && writeOffset_ + static_cast<off_t>(size) > fileSize)
+            truncateSize = std::max<off_t>(fileSize, end);
+    }
+
+    if (size) {
+        Span<const uint8_t> data{ buffer.data(), size };
+        off_t offset = writeOffset_;
+
+        pendingSize_ = size;
+        job_->submit([this, data, offset, truncateSize]() {
+            pendingResult_ = file_.writeAt(offset, data);
+            if (pendingResult_ >= 0 && truncateSize >= 0) {
+                int ret = file_.truncate(truncateSize);
+                if (ret < 0)
+                    pendingResult_ = ret;
+            }
+        });
+    }
+
+    if (tail)
+        memcpy(next.data(), buffer.data() + length_ - tail, tail);
+
+    writeOffset_ += length_ - tail;
+    current_ ^= 1;
+    length_ = tail;
+}
+
+/* Wait for the pending write to complete and record its result. */
+void FileWriter::complete()
+{
+    job_->wait();
+
+    if (!pendingSize_)
+        return;
+
+    if (pendingResult_ < 0)
+        error_ = pendingResult_;
+    else if (static_cast<size_t>(pendingResult_) < pendingSize_)
+        error_ = -ENOSPC;
+
+    pendingSize_ = 0;
+}
+
+} /* namespace zeus */
@@ -0,0 +1,409 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: file_watcher.cpp - inotify-based file system watcher
+//
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zeus/event_notifier.h>
+#include <zeus/file_watcher.h>
+#include <zeus/log.h>
+#include <zeus/timer.h>
+#include <zeus/utils.h>
+
+/**
+ * \file file_watcher.h
+ * \brief File system change notification
+ */
+
+namespace zeus {
+
+LOG_DEFINE_CATEGORY(FileWatcher)
+
+namespace {
+
+constexpr uint32_t kWatchMask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+std::string joinPath(const std::string &dir, const char *name)
+{
+    if (!dir.empty() && dir.back() == '/')
+        return dir + name;
+
+    return dir + "/" + name;
+}
+
+} /* namespace */
+
+/**
+ * \class FileWatcher
+ * \brief Watch files and directories for changes
+ *
+ * The FileWatcher class reports changes to files and directories with inotify,
+ * without polling. The inotify file descriptor is monitored by an
+ * EventNotifier, and the \ref modified, \ref created, \ref deleted and
+ * \ref moved signals are emitted in the thread the watcher is bound to.
+ *
+ * Watching a directory reports changes to its entries, and the deletion of the
+ * directory itself. Watching a file is implemented by watching its parent
+ * directory and filtering events by name, so that the file keeps being watched
+ * when it is deleted and created again, or atomically replaced by renaming
+ * another file over it as done by AtomicFile. The file doesn't need to exist
+ * when it is added, but its parent directory does.
+ *
+ * Events are coalesced over a configurable interval: all modifications of a
+ * file during the interval produce a single \ref modified signal, and
+ * modifications of a file that has just been created or moved to its path are
+ * folded into the \ref created or \ref moved signal. Signals are emitted in the
+ * order in which the events occurred. Paths are reported in the form they were
+ * passed to addPath(), or relative to the watched directory for its entries.
+ */
+
+/**
+ * \brief Construct a FileWatcher
+ * \param[in] parent The parent Object
+ */
+FileWatcher::FileWatcher(Object *parent)
+        : Object(parent), interval_(50)
+{
+    timer_ = std::make_unique<Timer>(this);
+    timer_->timeout.connect(this, &FileWatcher::flush);
+
+    fd_ = UniqueFD(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (!fd_.isValid()) {
+        LOG(FileWatcher, Error)
+                << "Failed to create inotify instance: " << strerror(errno);
+        return;
+    }
+
+    notifier_ = std::make_unique<EventNotifier>(fd_.get(), EventNotifier::Read, this);
+    notifier_->activated.connect(this, &FileWatcher::readEvents);
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+/**
+ * \brief Start watching a file or directory
+ * \param[in] path The path to watch
+ *
+ * \context This function is \threadbound.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FileWatcher::addPath(const std::string &path)
+{
+    if (!fd_.isValid())
+        return -EBADF;
+
+    if (paths_.count(path))
+        return -EEXIST;
+
+    struct stat st;
+    bool directory = stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    std::string dir = directory ? path : utils::dirname(path);
+
+    int wd = inotify_add_watch(fd_.get(), dir.c_str(), kWatchMask);
+    if (wd < 0) {
+        int ret = -errno;
+        LOG(FileWatcher, Error)
+                << "Failed to watch " << path << ": " << strerror(-ret);
+        return ret;
+    }
+
+    /* Paths in the same directory share the same watch descriptor. */
+    Watch &watch = watches_[wd];
+    if (directory) {
+        watch.path = path;
+        watch.directory = true;
+    } else {
+        if (watch.path.empty())
+            watch.path = dir;
+        watch.files[utils::basename(path.c_str())] = path;
+    }
+
+    paths_[path] = wd;
+    return 0;
+}
+
+/**
+ * \brief Stop watching a file or directory
+ * \param[in] path The path passed to addPath()
+ *
+ * Pending events for \a path that haven't been signalled yet are still
+ * delivered.
+ *
+ * \context This function is \threadbound.
+ *
+ * \return 0 on success, or a negative error code otherwise
+ */
+int FileWatcher::removePath(const std::string &path)
+{
+    auto it = paths_.find(path);
+    if (it == paths_.end())
+        return -ENOENT;
+
+    int wd = it->second;
+    paths_.erase(it);
+
+    Watch &watch = watches_[wd];
+    auto file = watch.files.find(utils::basename(path.c_str()));
+    if (file != watch.files.end() && file->second == path)
+        watch.files.erase(file);
+    else
+        watch.directory = false;
+
+    if (!watch.directory && watch.files.empty()) {
+        inotify_rm_watch(fd_.get(), wd);
+        watches_.erase(wd);
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Retrieve the watched paths
+ * \return The paths passed to addPath(), sorted alphabetically
+ */
+std::vector<std::string> FileWatcher::paths() const
+{
+    std::vector<std::string> paths;
+    paths.reserve(paths_.size());
+
+    for (const auto &[path, wd] : paths_)
+        paths.push_back(path);
+
+    return paths;
+}
+
+/**
+ * \brief Set the interval over which events are coalesced
+ * \param[in] interval The coalescing interval
+ *
+ * Signals are emitted at most \a interval after the first event they report.
+ * An interval of 0 only coalesces events read from the kernel at once. The
+ * default interval is 50ms.
+ */
+void FileWatcher::setCoalescingInterval(std::chrono::milliseconds interval)
+{
+    interval_ = interval;
+}
+
+/**
+ * \fn FileWatcher::coalescingInterval()
+ * \brief Retrieve the interval over which events are coalesced
+ * \return The coalescing interval
+ */
+
+/**
+ * \var FileWatcher::modified
+ * \brief Signal emitted when the contents or attributes of a file change
+ */
+
+/**
+ * \var FileWatcher::created
+ * \brief Signal emitted when a file is created
+ */
+
+/**
+ * \var FileWatcher::deleted
+ * \brief Signal emitted when a file is deleted
+ *
+ * Files moved out of the watched directories are reported as deleted, and
+ * watched directories stop being watched when they're deleted or moved.
+ */
+
+/**
+ * \var FileWatcher::moved
+ * \brief Signal emitted when a file is renamed
+ *
+ * The signal is emitted with the old and new paths of the file, when either of
+ * them is watched. Files moved into a watched directory from elsewhere are
+ * reported as created.
+ */
+
+void FileWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buffer[4096];
+
+    /* Moves are reported as two events, paired by a cookie. */
+    std::map<uint32_t, std::pair<std::string, bool>> moves;
+
+    while (true) {
+        ssize_t ret = read(fd_.get(), buffer, sizeof(buffer));
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                LOG(FileWatcher, Error)
+                        << "Failed to read events: " << strerror(errno);
+            break;
+        }
+
+        for (char *ptr = buffer; ptr < buffer + ret;) {
+            const auto *event = reinterpret_cast<const struct inotify_event *>(ptr);
+            ptr += sizeof(*event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                LOG(FileWatcher, Warning) << "Event queue overflow, events lost";
+                continue;
+            }
+
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end())
+                continue;
+
+            Watch &watch = it->second;
+
+            if (event->mask & IN_MOVE_SELF) {
+                if (watch.directory)
+                    queueEvent(EventType::Deleted, watch.path);
+
+                /*
+				 * The kernel keeps watching a moved directory at its new
+				 * location, remove the watch explicitly. The resulting
+				 * IN_IGNORED event is then skipped.
+				 */
+                inotify_rm_watch(fd_.get(), event->wd);
+            }
+
+            if (event->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+                LOG(FileWatcher, Debug) << "Stopped watching " << watch.path;
+
+                for (auto path = paths_.begin(); path != paths_.end();) {
+                    if (path->second == event->wd)
+                        path = paths_.erase(path);
+                    else
+                        ++path;
+                }
+
+                watches_.erase(it);
+                continue;
+            }
+
+            if (!event->len) {
+                if (watch.directory && event->mask & IN_DELETE_SELF)
+                    queueEvent(EventType::Deleted, watch.path);
+                continue;
+            }
+
+            auto file = watch.files.find(event->name);
+            bool watched = watch.directory || file != watch.files.end();
+            std::string path = file != watch.files.end()
+                                       ? file->second
+                                       : joinPath(watch.path, event->name);
+
+            if (event->mask & IN_MOVED_FROM) {
+                moves[event->cookie] = { path, watched };
+            } else if (event->mask & IN_MOVED_TO) {
+                auto move = moves.find(event->cookie);
+                if (move == moves.end()) {
+                    if (watched)
+                        queueEvent(EventType::Created, path);
+                    continue;
+                }
+
+                if (watched || move->second.second)
+                    queueEvent(EventType::Moved, move->second.first, path);
+                moves.erase(move);
+            } else if (!watched) {
+                continue;
+            } else if (event->mask & IN_CREATE) {
+                queueEvent(EventType::Created, path);
+            } else if (event->mask & IN_DELETE) {
+                queueEvent(EventType::Deleted, path);
+            } else {
+                queueEvent(EventType::Modified, path);
+            }
+        }
+    }
+
+    /* Files moved out of the watched directories. */
+    for (const auto &[cookie, move] : moves) {
+        if (move.second)
+            queueEvent(EventType::Deleted, move.first);
+    }
+
+    if (!interval_.count())
+        flush();
+}
+
+void FileWatcher::queueEvent(EventType type, const std::string &path,
+                             const std::string &target)
+{
+    switch (type) {
+    case EventType::Modified:
+        if (!modifiedPaths_.insert(path).second)
+            return;
+        break;
+
+    case EventType::Created:
+        /* Later modifications are implied by the creation. */
+        modifiedPaths_.insert(path);
+        break;
+
+    case EventType::Deleted:
+        modifiedPaths_.erase(path);
+        break;
+
+    case EventType::Moved:
+        modifiedPaths_.erase(path);
+        modifiedPaths_.insert(target);
+        break;
+    }
+
+    pending_.push_back({ type, path, target });
+
+    if (interval_.count() && !timer_->isRunning())
+        timer_->start(interval_);
+}
+
+void FileWatcher::flush()
+{
+    timer_->stop();
+
+    /* Slots may add or remove paths, work on a private list. */
+    std::vector<Event> events;
+    events.swap(pending_);
+    modifiedPaths_.clear();
+
+    for (const Event &event : events) {
+        switch (event.type) {
+        case EventType::Modified:
+            modified.emit(event.path);
+            break;
+        case EventType::Created:
+            created.emit(event.path);
+            break;
+        case EventType::Deleted:
+            deleted.emit(event.path);
+            break;
+        case EventType::Moved:
+            moved.emit(event.path, event.target);
+            break;
+        }
+    }
+}
+
+} /* namespace zeus */
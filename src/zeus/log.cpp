@@ -19,22 +19,43 @@
 //
 
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <list>
+#include <new>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <spawn.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/ucontext.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <syslog.h>
 #include <time.h>
+#include <unistd.h>
 #include <unordered_set>
 
 #include <zeus/backtrace.h>
 #include <zeus/log.h>
+#include <zeus/log_binary.h>
 #include <zeus/logging.h>
 #include <zeus/mutex.h>
+#include <zeus/semaphore.h>
+#include <zeus/span.h>
 #include <zeus/thread.h>
+#include <zeus/unique_fd.h>
 #include <zeus/utils.h>
 
 /**
@@ -64,6 +85,27 @@
  * of the file. The file must be writable and is truncated if it exists. If any
  * error occurs when opening the file, the file is ignored and the log is output
  * to std::cerr.
+ *
+ * Log messages are written synchronously by default. Setting the
+ * ZEUS_LOG_ASYNC environment variable enables asynchronous logging, with
+ * messages written by a background thread. The variable selects the overflow
+ * policy, and is either set to "block" or "drop". See logSetAsync() for more
+ * information.
+ *
+ * Additional log sinks, each with its own severity filter and format, can be
+ * attached with logAddFileSink() and the related functions. Log files can be
+ * rotated by size or time with logSetSinkRotation().
+ *
+ * Messages below a build-time severity floor are compiled out entirely, see
+ * ZEUS_LOG_MIN_SEVERITY.
+ *
+ * Log messages can also be recorded in memory only, with logSetFlightRecorder().
+ * The flight recorder keeps the most recent messages in a fixed-size ring
+ * buffer, and is dumped to stderr when a Fatal message is logged, or on demand
+ * with logDumpFlightRecorder().
+ *
+ * An optional crash handler, installed with logSetCrashHandler(), saves the
+ * call stack and the pending log messages when the process crashes.
  */
 
 /**
@@ -93,6 +135,19 @@ static int log_severity_to_syslog(LogSeverity severity)
     }
 }
 
+static bool log_format_valid(LoggingFormat format)
+{
+    switch (format) {
+    case LoggingFormatText:
+    case LoggingFormatJson:
+    case LoggingFormatLogfmt:
+    case LoggingFormatJournal:
+        return true;
+    default:
+        return false;
+    }
+}
+
 static const char *log_severity_name(LogSeverity severity)
 {
     static const char *const names[] = {
@@ -109,315 +164,3133 @@ static const char *log_severity_name(LogSeverity severity)
         return "UNKWN";
 }
 
-/**
- * \brief Log output
- *
- * The LogOutput class models a log output destination
+/*
+ * Write all of \a data to \a fd, retrying on partial writes and interrupts.
+ * This function is async-signal-safe.
  */
-class LogOutput
+static int log_write_fd(int fd, std::string_view data)
 {
-public:
-    LogOutput(const char *path, bool color);
-    LogOutput(std::ostream *stream, bool color);
-    LogOutput();
-    ~LogOutput();
+    while (!data.empty()) {
+        ssize_t written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno != EINTR)
+                return -errno;
+            continue;
+        }
 
-    bool isValid() const;
-    void write(const LogMessage &msg);
-    void write(const std::string &msg);
+        data.remove_prefix(written);
+    }
 
-private:
-    void writeSyslog(LogSeverity severity, const std::string &msg);
-    void writeStream(const std::string &msg);
+    return 0;
+}
 
-    std::ostream *stream_;
-    LoggingTarget target_;
-    bool color_;
-};
+namespace {
 
-/**
- * \brief Construct a log output based on a file
- * \param[in] path Full path to log file
- * \param[in] color True to output colored messages
+/*
+ * Call \a func with the contents of a flight recorder ring buffer, from the
+ * oldest to the newest message, in at most two contiguous chunks. When the
+ * ring has wrapped around, the oldest message is partly overwritten and is
+ * skipped. This function is async-signal-safe if \a func is.
  */
-LogOutput::LogOutput(const char *path, bool color)
-        : target_(LoggingTargetFile), color_(color)
+template<typename Func>
+void flightRecorderChunks(const char *data, uint64_t size, uint64_t position,
+                          Func &&func)
 {
-    stream_ = new std::ofstream(path);
+    uint64_t start = 0;
+
+    if (position > size) {
+        start = position - size;
+        while (start < position && data[start % size] != '\n')
+            start++;
+        start++;
+    }
+
+    while (start < position) {
+        size_t offset = start % size;
+        size_t len = std::min<uint64_t>(position - start, size - offset);
+        func(data + offset, len);
+        start += len;
+    }
 }
 
+constexpr char kFlightRecorderMagic[8] = { 'Z', 'E', 'U', 'S', 'R', 'I', 'N', 'G' };
+
+constexpr const char *kCrashReportHeader = "*** Crash report:";
+constexpr const char *kCrashReportFooter = "*** End of crash report ***";
+
+} /* namespace */
+
 /**
- * \brief Construct a log output based on a stream
- * \param[in] stream Stream to send log output to
- * \param[in] color True to output colored messages
+ * \brief In-memory ring buffer of formatted log messages
+ *
+ * The FlightRecorder stores formatted log messages in a fixed-size byte ring
+ * buffer, overwriting the oldest messages when the buffer is full. Space is
+ * reserved with a single atomic operation, messages are thus recorded without
+ * locking and without any I/O.
+ *
+ * The ring buffer is preceded by a header that stores its size and the total
+ * number of bytes written. When backed by a file, the memory is a shared
+ * mapping of the file, and the messages recorded until the process terminates
+ * survive in the file even when the process is killed. The file can be
+ * converted to text with logDecodeFlightRecorder().
+ *
+ * Concurrent writers are not serialized. A writer lapped by other writers
+ * while copying its message, or a dump performed while messages are being
+ * recorded, may produce a corrupted message. This is acceptable for a
+ * best-effort post-mortem record.
+ *
+ * The active recorder can be dumped from a signal handler at any time, which
+ * can't be synchronized with the destruction of the recorder. The memory
+ * mapping of a recorder is thus never unmapped, and stays valid for the
+ * lifetime of the process.
  */
-LogOutput::LogOutput(std::ostream *stream, bool color)
-        : stream_(stream), target_(LoggingTargetStream), color_(color)
+class FlightRecorder
 {
-}
+public:
+    FlightRecorder(size_t size, const char *path);
+    ~FlightRecorder();
+
+    bool isValid() const { return header_ != nullptr; }
+    void write(std::string_view str);
+
+    static int dumpActive(int fd);
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(FlightRecorder)
+
+    struct Header {
+        char magic[8];
+        uint64_t size;
+        std::atomic<uint64_t> position;
+    };
+
+    static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t));
+
+    struct Retired {
+        Header *header;
+        size_t size;
+        bool anonymous;
+    };
+
+    static Header *reuse(size_t size);
+    static void release(Header *header, size_t size, bool anonymous);
+
+    Header *header_;
+    char *data_;
+    size_t size_;
+    bool anonymous_;
+
+    static std::atomic<Header *> active_;
+    static std::atomic<unsigned int> dumping_;
+
+    static Mutex retiredMutex_;
+    static std::vector<Retired> retired_ ZEUS_TSA_GUARDED_BY(retiredMutex_);
+};
+
+std::atomic<FlightRecorder::Header *> FlightRecorder::active_ = nullptr;
+std::atomic<unsigned int> FlightRecorder::dumping_ = 0;
+Mutex FlightRecorder::retiredMutex_;
+std::vector<FlightRecorder::Retired> FlightRecorder::retired_;
 
 /**
- * \brief Construct a log output to syslog
+ * \brief Construct a flight recorder
+ * \param[in] size The ring buffer size in bytes
+ * \param[in] path The path to the file backing the ring buffer, or nullptr
+ *
+ * The ring buffer is allocated in anonymous memory if \a path is nullptr,
+ * otherwise the file at \a path is created or truncated, and mapped. The
+ * constructed recorder becomes the active recorder dumped by
+ * logDumpFlightRecorder().
  */
-LogOutput::LogOutput()
-        : stream_(nullptr), target_(LoggingTargetSyslog), color_(false)
+FlightRecorder::FlightRecorder(size_t size, const char *path)
+        : header_(nullptr), data_(nullptr), size_(size), anonymous_(!path)
 {
-    openlog("libcamera", LOG_PID, 0);
+    /*
+	 * The header of a retired mapping is already initialized for the same
+	 * size, only reset the position as a dump may still be reading it.
+	 */
+    if (!path) {
+        header_ = reuse(size);
+        if (header_) {
+            header_->position.store(0, std::memory_order_relaxed);
+            data_ = reinterpret_cast<char *>(header_ + 1);
+            active_.store(header_);
+            return;
+        }
+    }
+
+    size_t mapSize = sizeof(Header) + size;
+    UniqueFD fd;
+    int flags = MAP_SHARED;
+
+    if (path) {
+        fd = UniqueFD(open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        if (!fd.isValid() || ftruncate(fd.get(), mapSize) < 0)
+            return;
+    } else {
+        flags |= MAP_ANONYMOUS;
+    }
+
+    void *mem = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, flags,
+                     fd.get(), 0);
+    if (mem == MAP_FAILED)
+        return;
+
+    header_ = new (mem) Header;
+    memcpy(header_->magic, kFlightRecorderMagic, sizeof(header_->magic));
+    header_->size = size;
+    header_->position.store(0, std::memory_order_relaxed);
+    data_ = reinterpret_cast<char *>(header_ + 1);
+
+    active_.store(header_);
 }
 
-LogOutput::~LogOutput()
+FlightRecorder::~FlightRecorder()
 {
-    switch (target_) {
-    case LoggingTargetFile:
-        delete stream_;
-        break;
-    case LoggingTargetSyslog:
-        closelog();
-        break;
-    default:
-        break;
-    }
+    if (!header_)
+        return;
+
+    Header *header = header_;
+    active_.compare_exchange_strong(header, nullptr);
+
+    release(header_, size_, anonymous_);
 }
 
-/**
- * \brief Check if the log output is valid
- * \return True if the log output is valid
+/*
+ * Take the mapping of a retired anonymous recorder of \a size bytes, if any.
+ * A dump may still be reading it, which is harmless as it stays mapped.
  */
-bool LogOutput::isValid() const
+FlightRecorder::Header *FlightRecorder::reuse(size_t size)
 {
-    switch (target_) {
-    case LoggingTargetFile:
-        return stream_->good();
-    case LoggingTargetStream:
-        return stream_ != nullptr;
-    default:
-        return true;
+    MutexLocker locker(retiredMutex_);
+
+    for (auto it = retired_.begin(); it != retired_.end(); ++it) {
+        if (it->anonymous && it->size == size) {
+            Header *header = it->header;
+            retired_.erase(it);
+            return header;
+        }
     }
-}
 
-namespace {
+    return nullptr;
+}
 
 /*
- * For more information about ANSI escape codes, see
- * https://en.wikipedia.org/wiki/ANSI_escape_code#Colors.
+ * Retire the ring buffer of a recorder that isn't active anymore. Dumps
+ * account for themselves in dumping_ before loading active_, a dump in
+ * progress may thus still read any retired mapping. When no dump is in
+ * progress, all retired mappings are unmapped. Otherwise they're kept, and
+ * anonymous ones are reused by the next recorder of the same size.
  */
-constexpr const char *kColorReset = "\033[0m";
-constexpr const char *kColorGreen = "\033[0;32m";
-constexpr const char *kColorBrightRed = "\033[1;31m";
-constexpr const char *kColorBrightGreen = "\033[1;32m";
-constexpr const char *kColorBrightYellow = "\033[1;33m";
-constexpr const char *kColorBrightBlue = "\033[1;34m";
-constexpr const char *kColorBrightMagenta = "\033[1;35m";
-constexpr const char *kColorBrightCyan = "\033[1;36m";
-constexpr const char *kColorBrightWhite = "\033[1;37m";
+void FlightRecorder::release(Header *header, size_t size, bool anonymous)
+{
+    MutexLocker locker(retiredMutex_);
 
-} /* namespace */
+    retired_.push_back({ header, size, anonymous });
+
+    if (dumping_.load())
+        return;
+
+    for (const Retired &retired : retired_)
+        munmap(retired.header, sizeof(Header) + retired.size);
+
+    retired_.clear();
+}
 
 /**
- * \brief Write message to log output
- * \param[in] msg Message to write
+ * \brief Record a formatted message
+ * \param[in] str The formatted message
+ *
+ * Messages larger than the ring buffer are truncated to their end.
  */
-void LogOutput::write(const LogMessage &msg)
+void FlightRecorder::write(std::string_view str)
 {
-    static const char *const severityColors[] = {
-        kColorBrightCyan,
-        kColorBrightGreen,
-        kColorBrightYellow,
-        kColorBrightRed,
-        kColorBrightMagenta,
-    };
-
-    const char *categoryColor = color_ ? kColorBrightWhite : "";
-    const char *fileColor = color_ ? kColorBrightBlue : "";
-    const char *prefixColor = color_ ? kColorGreen : "";
-    const char *resetColor = color_ ? kColorReset : "";
-    const char *severityColor = "";
-    LogSeverity severity = msg.severity();
-    std::string str;
+    if (str.size() > size_)
+        str.remove_prefix(str.size() - size_);
 
-    if (color_) {
-        if (static_cast<unsigned int>(severity) < std::size(severityColors))
-            severityColor = severityColors[severity];
-        else
-            severityColor = kColorBrightWhite;
-    }
+    uint64_t position = header_->position.fetch_add(str.size(),
+                                                    std::memory_order_relaxed);
+    size_t offset = position % size_;
+    size_t len = std::min(str.size(), size_ - offset);
 
-    switch (target_) {
-    case LoggingTargetSyslog:
-        str = std::string(log_severity_name(severity)) + " " + msg.category().name() + " " + msg.fileInfo() + " ";
-        if (!msg.prefix().empty())
-            str += msg.prefix() + ": ";
-        str += msg.msg();
-        writeSyslog(severity, str);
-        break;
-    case LoggingTargetStream:
-    case LoggingTargetFile:
-        str = "[" + utils::time_point_to_string(msg.timestamp()) + "] [" + std::to_string(Thread::currentId()) + "] " + severityColor + log_severity_name(severity) + " " + categoryColor + msg.category().name() + " " + fileColor + msg.fileInfo() + " ";
-        if (!msg.prefix().empty())
-            str += prefixColor + msg.prefix() + ": ";
-        str += resetColor + msg.msg();
-        writeStream(str);
-        break;
-    default:
-        break;
-    }
+    memcpy(data_ + offset, str.data(), len);
+    memcpy(data_, str.data() + len, str.size() - len);
 }
 
 /**
- * \brief Write string to log output
- * \param[in] str String to write
+ * \brief Write the messages of the active recorder to a file descriptor
+ * \param[in] fd The file descriptor
+ *
+ * The active recorder is the most recently constructed recorder, until it is
+ * destroyed.
+ *
+ * \context This function is async-signal-safe.
+ *
+ * \return 0 on success, -ENOENT if no recorder is active, or another negative
+ * error code otherwise
  */
-void LogOutput::write(const std::string &str)
+int FlightRecorder::dumpActive(int fd)
 {
-    switch (target_) {
-    case LoggingTargetSyslog:
-        writeSyslog(LogDebug, str);
-        break;
-    case LoggingTargetStream:
-    case LoggingTargetFile:
-        writeStream(str);
-        break;
-    default:
-        break;
-    }
-}
+    dumping_.fetch_add(1);
 
-void LogOutput::writeSyslog(LogSeverity severity, const std::string &str)
-{
-    syslog(log_severity_to_syslog(severity), "%s", str.c_str());
-}
+    Header *header = active_.load();
+    int ret = -ENOENT;
 
-void LogOutput::writeStream(const std::string &str)
-{
-    stream_->write(str.c_str(), str.size());
-    stream_->flush();
+    if (header) {
+        const char *buffer = reinterpret_cast<const char *>(header + 1);
+        uint64_t position = header->position.load(std::memory_order_acquire);
+
+        ret = 0;
+        flightRecorderChunks(buffer, header->size, position, [&](const char *data, size_t len) {
+            if (!ret)
+                ret = log_write_fd(fd, { data, len });
+        });
+    }
+
+    dumping_.fetch_sub(1);
+    return ret;
 }
 
 /**
- * \brief Message logger
+ * \brief Log file with size and time based rotation
  *
- * The Logger class handles log configuration.
+ * The LogFileRotator writes log messages to the file at a fixed path, and
+ * rotates it when it exceeds a maximum size or at a fixed interval. Rotated
+ * segments are renamed to path.1, path.2, ... from the newest to the oldest,
+ * and optionally compressed with gzip to path.1.gz, path.2.gz, ...
+ *
+ * Messages are written with a single write() call to a file opened with
+ * O_APPEND. The active segment is accessed through an atomic shared pointer
+ * and accounts for its own size, a writer never takes a lock nor waits for a
+ * rotation to complete. The writer that pushes a segment over the size limit
+ * only wakes up the rotator thread.
+ *
+ * The rotator thread prepares the next segment, preallocated to the maximum
+ * size with fallocate() to limit fragmentation, renames the files and swaps
+ * the active segment. The previous segment is released by the last writer
+ * holding it, which releases its unused preallocated space and closes it. The
+ * rotator thread then compresses it.
  */
-class Logger
+class LogFileRotator : public Thread
 {
 public:
-    ~Logger();
-
-    static Logger *instance();
+    LogFileRotator(const std::string &path, size_t maxSize, unsigned int count,
+                   std::chrono::seconds interval, bool compress);
+    ~LogFileRotator();
 
-    void write(const LogMessage &msg);
-    void backtrace();
+    bool isValid() const { return segment_ != nullptr; }
+    void configure(size_t maxSize, unsigned int count,
+                   std::chrono::seconds interval, bool compress);
+    void write(std::string_view str);
 
-    int logSetFile(const char *path, bool color);
-    int logSetStream(std::ostream *stream, bool color);
-    int logSetTarget(LoggingTarget target);
-    void logSetLevel(const char *category, const char *level);
+protected:
+    void run() override;
 
 private:
-    Logger();
+    ZEUS_DISABLE_COPY_AND_MOVE(LogFileRotator)
 
-    void parseLogFile();
-    void parseLogLevels();
-    static LogSeverity parseLogLevel(const std::string &level);
+    struct Segment {
+        ~Segment();
 
-    friend LogCategory;
-    void registerCategory(LogCategory *category);
-    LogCategory *findCategory(const char *name) const;
+        UniqueFD fd;
+        std::atomic<size_t> size;
+        LogFileRotator *rotator = nullptr;
+    };
 
-    static bool destroyed_;
+    std::shared_ptr<Segment> openSegment(const std::string &path);
+    std::string segmentName(unsigned int index, bool compress) const;
+    void rotate(unsigned int count, bool compress);
+    void segmentReleased();
 
-    std::vector<LogCategory *> categories_;
-    std::list<std::pair<std::string, LogSeverity>> levels_;
+    const std::string path_;
+    std::atomic<size_t> maxSize_;
+
+    std::shared_ptr<Segment> segment_;
+    std::atomic<bool> pending_;
 
-    std::shared_ptr<LogOutput> output_;
+    Mutex mutex_;
+    ConditionVariable cv_;
+    unsigned int count_ ZEUS_TSA_GUARDED_BY(mutex_);
+    std::chrono::seconds interval_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool compress_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool reconfigured_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool released_ ZEUS_TSA_GUARDED_BY(mutex_);
+    bool stop_ ZEUS_TSA_GUARDED_BY(mutex_);
 };
 
-bool Logger::destroyed_ = false;
+/**
+ * \brief Construct a log file rotator and start its thread
+ * \param[in] path The path to the active log file
+ * \param[in] maxSize The size above which the file is rotated, 0 to disable
+ * size-based rotation
+ * \param[in] count The number of rotated segments to keep
+ * \param[in] interval The rotation interval, 0 to disable time-based rotation
+ * \param[in] compress True to compress the rotated segments
+ *
+ * The file at \a path is opened in append mode, its content is preserved.
+ */
+LogFileRotator::LogFileRotator(const std::string &path, size_t maxSize,
+                               unsigned int count, std::chrono::seconds interval,
+                               bool compress)
+        : path_(path), maxSize_(maxSize), pending_(false), count_(count),
+          interval_(interval), compress_(compress), reconfigured_(false),
+          released_(false), stop_(false)
+{
+    segment_ = openSegment(path_);
+    if (!segment_)
+        return;
+
+    start();
+}
 
 /**
- * \enum LoggingTarget
- * \brief Log destination type
- * \var LoggingTargetNone
- * \brief No logging destination
- * \sa Logger::logSetTarget
- * \var LoggingTargetSyslog
- * \brief Log to syslog
- * \sa Logger::logSetTarget
- * \var LoggingTargetFile
- * \brief Log to file
- * \sa Logger::logSetFile
- * \var LoggingTargetStream
- * \brief Log to stream
- * \sa Logger::logSetStream
+ * \brief Stop the rotator thread and release the active segment
  */
+LogFileRotator::~LogFileRotator()
+{
+    {
+        MutexLocker locker(mutex_);
+        stop_ = true;
+    }
+
+    cv_.notify_one();
+    wait();
+}
 
 /**
- * \brief Direct logging to a file
- * \param[in] path Full path to the log file
- * \param[in] color True to output colored messages
- *
- * This function directs the log output to the file identified by \a path. The
- * previous log target, if any, is closed, and all new log messages will be
- * written to the new log file.
+ * \brief Update the rotation parameters
+ * \param[in] maxSize The size above which the file is rotated, 0 to disable
+ * size-based rotation
+ * \param[in] count The number of rotated segments to keep
+ * \param[in] interval The rotation interval, 0 to disable time-based rotation
+ * \param[in] compress True to compress the rotated segments
  *
- * \a color controls whether or not the messages will be colored with standard
+ * The active segment is kept, and the next rotation interval starts now.
+ */
+void LogFileRotator::configure(size_t maxSize, unsigned int count,
+                               std::chrono::seconds interval, bool compress)
+{
+    maxSize_.store(maxSize, std::memory_order_relaxed);
+
+    {
+        MutexLocker locker(mutex_);
+        count_ = count;
+        interval_ = interval;
+        compress_ = compress;
+        reconfigured_ = true;
+    }
+
+    cv_.notify_one();
+}
+
+/**
+ * \brief Write a formatted message to the active segment
+ * \param[in] str The formatted message
+ */
+void LogFileRotator::write(std::string_view str)
+{
+    std::shared_ptr<Segment> segment = std::atomic_load(&segment_);
+    size_t maxSize = maxSize_.load(std::memory_order_relaxed);
+
+    while (!str.empty()) {
+        ssize_t ret = ::write(segment->fd.get(), str.data(), str.size());
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        size_t size = segment->size.fetch_add(ret, std::memory_order_relaxed) + ret;
+        str.remove_prefix(ret);
+
+        if (!maxSize || size < maxSize ||
+            pending_.exchange(true, std::memory_order_relaxed))
+            continue;
+
+        MutexLocker locker(mutex_);
+        cv_.notify_one();
+    }
+}
+
+LogFileRotator::Segment::~Segment()
+{
+    /* Release the preallocated space past the end of the file. */
+    if (fd.isValid())
+        ftruncate(fd.get(), size.load(std::memory_order_relaxed));
+
+    fd.reset();
+
+    if (rotator)
+        rotator->segmentReleased();
+}
+
+std::shared_ptr<LogFileRotator::Segment> LogFileRotator::openSegment(const std::string &path)
+{
+    auto segment = std::make_shared<Segment>();
+    size_t maxSize = maxSize_.load(std::memory_order_relaxed);
+
+    segment->fd = UniqueFD(open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                                0644));
+    if (!segment->fd.isValid())
+        return nullptr;
+
+    struct stat st;
+    if (fstat(segment->fd.get(), &st) < 0)
+        return nullptr;
+
+    segment->size.store(st.st_size, std::memory_order_relaxed);
+
+    /*
+	 * Preallocation is an optimization only, ignore errors from file
+	 * systems that don't support it.
+	 */
+    if (maxSize > static_cast<size_t>(st.st_size))
+        fallocate(segment->fd.get(), FALLOC_FL_KEEP_SIZE, st.st_size,
+                  maxSize - st.st_size);
+
+    return segment;
+}
+
+std::string LogFileRotator::segmentName(unsigned int index, bool compress) const
+{
+    std::string name = path_ + "." + std::to_string(index);
+    if (compress)
+        name += ".gz";
+    return name;
+}
+
+void LogFileRotator::rotate(unsigned int count, bool compress)
+{
+    std::string next = path_ + ".next";
+    unlink(next.c_str());
+
+    std::shared_ptr<Segment> segment = openSegment(next);
+    if (!segment)
+        return;
+
+    /*
+	 * Shift the rotated segments, dropping the oldest one. Segments are
+	 * compressed after being renamed, the newest segment is thus renamed
+	 * to its uncompressed name.
+	 */
+    if (count) {
+        unlink(segmentName(count, compress).c_str());
+        for (unsigned int i = count - 1; i > 0; --i)
+            rename(segmentName(i, compress).c_str(),
+                   segmentName(i + 1, compress).c_str());
+    }
+
+    std::string rotated = path_ + ".1";
+    if (count)
+        rename(path_.c_str(), rotated.c_str());
+    else
+        unlink(path_.c_str());
+    rename(next.c_str(), path_.c_str());
+
+    bool compressRotated = compress && count;
+
+    /*
+	 * Only this thread replaces the active segment, it can be accessed
+	 * directly. When the previous segment has to be compressed, the last
+	 * writer holding it notifies its release.
+	 */
+    if (compressRotated) {
+        MutexLocker locker(mutex_);
+        released_ = false;
+        segment_->rotator = this;
+    }
+
+    std::atomic_store(&segment_, std::move(segment));
+
+    if (!compressRotated)
+        return;
+
+    {
+        MutexLocker locker(mutex_);
+        cv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) {
+            return released_;
+        });
+    }
+
+    const char *argv[] = { "gzip", "-f", rotated.c_str(), nullptr };
+    pid_t pid;
+
+    if (posix_spawnp(&pid, "gzip", nullptr, nullptr,
+                     const_cast<char *const *>(argv), environ))
+        return;
+
+    int ret;
+    do {
+        ret = waitpid(pid, nullptr, 0);
+    } while (ret == -1 && errno == EINTR);
+}
+
+void LogFileRotator::segmentReleased()
+{
+    {
+        MutexLocker locker(mutex_);
+        released_ = true;
+    }
+
+    cv_.notify_one();
+}
+
+void LogFileRotator::run()
+{
+    using clock = std::chrono::steady_clock;
+
+    MutexLocker locker(mutex_);
+
+    clock::time_point deadline = clock::now() + interval_;
+    auto ready = [&]() ZEUS_TSA_REQUIRES(mutex_) {
+        return stop_ || reconfigured_ || pending_.load(std::memory_order_relaxed);
+    };
+
+    while (true) {
+        if (interval_.count())
+            cv_.wait_until(locker, deadline, ready);
+        else
+            cv_.wait(locker, ready);
+
+        if (stop_)
+            break;
+
+        if (reconfigured_) {
+            reconfigured_ = false;
+            deadline = clock::now() + interval_;
+        }
+
+        /*
+		 * Writers still holding the previous segment after a rotation
+		 * may request another one, check the size of the active
+		 * segment.
+		 */
+        size_t maxSize = maxSize_.load(std::memory_order_relaxed);
+        bool rotate = pending_.exchange(false, std::memory_order_relaxed) &&
+                      maxSize && segment_->size.load(std::memory_order_relaxed) >= maxSize;
+
+        /* Skip empty segments on time-based rotation. */
+        if (interval_.count() && clock::now() >= deadline) {
+            while (deadline <= clock::now())
+                deadline += interval_;
+
+            if (segment_->size.load(std::memory_order_relaxed))
+                rotate = true;
+        }
+
+        if (!rotate)
+            continue;
+
+        unsigned int count = count_;
+        bool compress = compress_;
+
+        locker.unlock();
+        this->rotate(count, compress);
+        locker.lock();
+    }
+}
+
+/**
+ * \brief Log output
+ *
+ * The LogOutput class models a log output destination
+ */
+struct LogRecord;
+class JournalSocket;
+
+namespace {
+class LogLineBuffer;
+} /* namespace */
+
+class LogOutput
+{
+public:
+    LogOutput(const char *path, bool color);
+    LogOutput(std::ostream *stream, bool color);
+    LogOutput(size_t size, const char *path);
+    LogOutput(LoggingTarget target, const char *path);
+    LogOutput();
+    ~LogOutput();
+
+    bool isValid() const;
+    LoggingTarget target() const { return target_; }
+    void setFormat(LoggingFormat format) { format_.store(format, std::memory_order_relaxed); }
+    unsigned int formatKey() const;
+    std::string_view format(const LogMessage &msg, LogLineBuffer &line) const;
+    std::string formatString(const std::string &str) const;
+    void write(LogSeverity severity, std::string_view msg);
+    void write(const std::string &msg);
+    void write(Span<const LogRecord> records);
+    int setRotation(size_t maxSize, unsigned int count,
+                    std::chrono::seconds interval, bool compress);
+
+private:
+    void writeSyslog(LogSeverity severity, std::string_view msg);
+    void writeStream(std::string_view msg);
+
+    std::ostream *stream_;
+    LoggingTarget target_;
+    bool color_;
+    std::atomic<LoggingFormat> format_;
+    std::unique_ptr<FlightRecorder> recorder_;
+    std::unique_ptr<JournalSocket> journal_;
+    std::string path_;
+    std::shared_ptr<LogFileRotator> rotator_;
+
+    /* Serializes writes to the file stream with its replacement by a rotator. */
+    Mutex streamMutex_;
+};
+
+/**
+ * \brief A formatted log message queued for asynchronous output
+ */
+struct LogRecord {
+    /**
+	 * \brief The log output the message has been formatted for
+	 */
+    std::shared_ptr<LogOutput> output;
+    /**
+	 * \brief The log message severity
+	 */
+    LogSeverity severity;
+    /**
+	 * \brief The formatted log message
+	 */
+    std::string msg;
+};
+
+/**
+ * \brief Client of the journald native protocol socket
+ *
+ * The JournalSocket sends log entries to journald as datagrams over a
+ * non-blocking Unix socket. Each datagram contains the fields of one entry in
+ * the journal native protocol format, as produced by formatJournal() without
+ * the terminating empty line. Batches of entries are sent with a single
+ * sendmmsg() call.
+ *
+ * Entries that don't fit in a datagram are written to a sealed memfd, whose
+ * file descriptor is passed to journald. Entries that can't be sent without
+ * blocking, when the socket buffer is full, are dropped and accounted for,
+ * and the number of dropped entries is reported once the socket accepts data
+ * again.
+ */
+class JournalSocket
+{
+public:
+    static constexpr const char *kDefaultPath = "/run/systemd/journal/socket";
+
+    explicit JournalSocket(const char *path);
+
+    bool isValid() const { return fd_.isValid(); }
+    void send(std::string_view entry);
+    void send(Span<const LogRecord> records);
+
+private:
+    ZEUS_DISABLE_COPY_AND_MOVE(JournalSocket)
+
+    static constexpr unsigned int kMaxBatchSize = 64;
+
+    static std::string_view datagram(std::string_view entry);
+    bool sendLarge(std::string_view entry);
+    void sent(bool success);
+
+    UniqueFD fd_;
+    std::atomic<uint64_t> dropped_;
+};
+
+/**
+ * \brief Connect to the journal socket
+ * \param[in] path The path to the journal socket, or nullptr for the default
+ * journald socket
+ */
+JournalSocket::JournalSocket(const char *path)
+        : dropped_(0)
+{
+    struct sockaddr_un addr = {};
+
+    if (!path)
+        path = kDefaultPath;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return;
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    UniqueFD fd(socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+    if (!fd.isValid())
+        return;
+
+    if (connect(fd.get(), reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) < 0)
+        return;
+
+    fd_ = std::move(fd);
+}
+
+/*
+ * Strip the empty line that terminates an entry in the journal export format.
+ * The native protocol doesn't use a terminator.
+ */
+std::string_view JournalSocket::datagram(std::string_view entry)
+{
+    if (!entry.empty() && entry.back() == '\n')
+        entry.remove_suffix(1);
+    return entry;
+}
+
+/**
+ * \brief Send an entry to the journal
+ * \param[in] entry The entry in the journal export format
+ */
+void JournalSocket::send(std::string_view entry)
+{
+    std::string_view data = datagram(entry);
+    ssize_t ret;
+
+    do {
+        ret = ::send(fd_.get(), data.data(), data.size(), MSG_NOSIGNAL);
+    } while (ret == -1 && errno == EINTR);
+
+    if (ret == -1 && errno == EMSGSIZE)
+        sent(sendLarge(data));
+    else
+        sent(ret != -1);
+}
+
+/**
+ * \brief Send a batch of entries to the journal
+ * \param[in] records The records, formatted in the journal export format
+ */
+void JournalSocket::send(Span<const LogRecord> records)
+{
+    struct mmsghdr msgs[kMaxBatchSize];
+    struct iovec iovs[kMaxBatchSize];
+
+    while (!records.empty()) {
+        unsigned int count = std::min<size_t>(records.size(), kMaxBatchSize);
+
+        for (unsigned int i = 0; i < count; ++i) {
+            std::string_view data = datagram(records[i].msg);
+
+            iovs[i].iov_base = const_cast<char *>(data.data());
+            iovs[i].iov_len = data.size();
+
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int ret;
+        do {
+            ret = sendmmsg(fd_.get(), msgs, count, MSG_NOSIGNAL);
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret > 0) {
+            sent(true);
+            records = records.subspan(ret);
+            continue;
+        }
+
+        /* The first record of the batch failed, skip it. */
+        if (errno == EMSGSIZE)
+            sent(sendLarge(datagram(records[0].msg)));
+        else
+            sent(false);
+
+        records = records.subspan(1);
+    }
+}
+
+/*
+ * Send an entry too large for a datagram through a sealed memory file, as
+ * supported by journald.
+ */
+bool JournalSocket::sendLarge(std::string_view entry)
+{
+    UniqueFD memfd(memfd_create("zeus-log", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!memfd.isValid())
+        return false;
+
+    while (!entry.empty()) {
+        ssize_t ret = ::write(memfd.get(), entry.data(), entry.size());
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        entry.remove_prefix(ret);
+    }
+
+    if (fcntl(memfd.get(), F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+        return false;
+
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control = {};
+
+    struct msghdr msg = {};
+    msg.msg_control = &control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+
+    int fd = memfd.get();
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+    ssize_t ret;
+    do {
+        ret = sendmsg(fd_.get(), &msg, MSG_NOSIGNAL);
+    } while (ret == -1 && errno == EINTR);
+
+    return ret != -1;
+}
+
+/*
+ * Account for an entry that has been sent or dropped. Once an entry has been
+ * sent, report the number of entries dropped since the previous report.
+ */
+void JournalSocket::sent(bool success)
+{
+    if (!success) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (!dropped_.load(std::memory_order_relaxed))
+        return;
+
+    uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+    if (!dropped)
+        return;
+
+    std::string report = "MESSAGE=" + std::to_string(dropped) +
+                         " log messages dropped\nPRIORITY=4\nSYSLOG_IDENTIFIER=" +
+                         program_invocation_short_name + "\n";
+
+    if (::send(fd_.get(), report.data(), report.size(), MSG_NOSIGNAL) == -1)
+        dropped_.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Construct a log output based on a file
+ * \param[in] path Full path to log file
+ * \param[in] color True to output colored messages
+ */
+LogOutput::LogOutput(const char *path, bool color)
+        : target_(LoggingTargetFile), color_(color), format_(LoggingFormatText),
+          path_(path)
+{
+    stream_ = new std::ofstream(path);
+}
+
+/**
+ * \brief Construct a log output based on a stream
+ * \param[in] stream Stream to send log output to
+ * \param[in] color True to output colored messages
+ */
+LogOutput::LogOutput(std::ostream *stream, bool color)
+        : stream_(stream), target_(LoggingTargetStream), color_(color),
+          format_(LoggingFormatText)
+{
+}
+
+/**
+ * \brief Construct a log output to a flight recorder
+ * \param[in] size The flight recorder ring buffer size in bytes
+ * \param[in] path The path to the file backing the ring buffer, or nullptr
+ */
+LogOutput::LogOutput(size_t size, const char *path)
+        : stream_(nullptr), target_(LoggingTargetFlightRecorder), color_(false),
+          format_(LoggingFormatText), recorder_(std::make_unique<FlightRecorder>(size, path))
+{
+}
+
+/**
+ * \brief Construct a log output to the journal
+ * \param[in] target The log target, shall be LoggingTargetJournal
+ * \param[in] path The path to the journal socket, or nullptr for the default
+ * journald socket
+ */
+LogOutput::LogOutput(LoggingTarget target, const char *path)
+        : stream_(nullptr), target_(target), color_(false),
+          format_(LoggingFormatJournal), journal_(std::make_unique<JournalSocket>(path))
+{
+    ASSERT(target == LoggingTargetJournal);
+}
+
+/**
+ * \brief Construct a log output to syslog
+ *
+ * Messages are identified by the program name.
+ */
+LogOutput::LogOutput()
+        : stream_(nullptr), target_(LoggingTargetSyslog), color_(false),
+          format_(LoggingFormatText)
+{
+    openlog(nullptr, LOG_PID, 0);
+}
+
+LogOutput::~LogOutput()
+{
+    switch (target_) {
+    case LoggingTargetFile:
+        delete stream_;
+        break;
+    case LoggingTargetSyslog:
+        closelog();
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * \brief Check if the log output is valid
+ * \return True if the log output is valid
+ */
+bool LogOutput::isValid() const
+{
+    switch (target_) {
+    case LoggingTargetFile:
+        return stream_ ? stream_->good() : rotator_ != nullptr;
+    case LoggingTargetStream:
+        return stream_ != nullptr;
+    case LoggingTargetFlightRecorder:
+        return recorder_->isValid();
+    case LoggingTargetJournal:
+        return journal_->isValid();
+    default:
+        return true;
+    }
+}
+
+namespace {
+
+/*
+ * For more information about ANSI escape codes, see
+ * https://en.wikipedia.org/wiki/ANSI_escape_code#Colors.
+ */
+constexpr const char *kColorReset = "\033[0m";
+constexpr const char *kColorGreen = "\033[0;32m";
+constexpr const char *kColorBrightRed = "\033[1;31m";
+constexpr const char *kColorBrightGreen = "\033[1;32m";
+constexpr const char *kColorBrightYellow = "\033[1;33m";
+constexpr const char *kColorBrightBlue = "\033[1;34m";
+constexpr const char *kColorBrightMagenta = "\033[1;35m";
+constexpr const char *kColorBrightCyan = "\033[1;36m";
+constexpr const char *kColorBrightWhite = "\033[1;37m";
+
+/*
+ * Buffer to format log lines, reused for all the messages of a thread. The
+ * buffer only grows, formatting a line doesn't allocate memory once the buffer
+ * has reached the size of the longest line.
+ */
+class LogLineBuffer
+{
+public:
+    LogLineBuffer()
+        : size_(0), cachedSecond_(~0ULL), cachedPrefixSize_(0)
+    {
+    }
+
+    void clear() { size_ = 0; }
+    std::string_view view() const { return { data_.data(), size_ }; }
+
+    void append(std::string_view str)
+    {
+        memcpy(reserve(str.size()), str.data(), str.size());
+        size_ += str.size();
+    }
+
+    void append(char c)
+    {
+        *reserve(1) = c;
+        size_++;
+    }
+
+    void appendDec(uint64_t value, unsigned int width = 0);
+    void appendTimestamp(const utils::time_point &time);
+
+    void appendField(const LogField &field, LoggingFormat format);
+    void appendJsonString(std::string_view str);
+    void appendLogfmtString(std::string_view str);
+    void appendJournalField(std::string_view key, std::string_view value);
+    void appendJournalKey(std::string_view key);
+
+private:
+    char *reserve(size_t size)
+    {
+        if (size_ + size > data_.size())
+            data_.resize(std::max(data_.size() * 2, size_ + size));
+        return data_.data() + size_;
+    }
+
+    std::vector<char> data_;
+    size_t size_;
+
+    uint64_t cachedSecond_;
+    char cachedPrefix_[32];
+    size_t cachedPrefixSize_;
+};
+
+void LogLineBuffer::appendDec(uint64_t value, unsigned int width)
+{
+    char digits[20];
+    size_t len = std::to_chars(digits, digits + sizeof(digits), value).ptr - digits;
+    size_t pad = width > len ? width - len : 0;
+
+    char *dst = reserve(pad + len);
+    memset(dst, '0', pad);
+    memcpy(dst + pad, digits, len);
+    size_ += pad + len;
+}
+
+/*
+ * Format the timestamp as utils::time_point_to_string() does. The "H:MM:SS."
+ * prefix only changes once per second and is cached.
+ */
+void LogLineBuffer::appendTimestamp(const utils::time_point &time)
+{
+    uint64_t nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             time.time_since_epoch())
+                             .count();
+    uint64_t secs = nsecs / 1000000000ULL;
+
+    if (secs != cachedSecond_) {
+        char *end = cachedPrefix_ + sizeof(cachedPrefix_);
+        char *p = std::to_chars(cachedPrefix_, end, secs / (60 * 60)).ptr;
+        unsigned int minutes = (secs / 60) % 60;
+        unsigned int seconds = secs % 60;
+
+        *p++ = ':';
+        *p++ = '0' + minutes / 10;
+        *p++ = '0' + minutes % 10;
+        *p++ = ':';
+        *p++ = '0' + seconds / 10;
+        *p++ = '0' + seconds % 10;
+        *p++ = '.';
+
+        cachedPrefixSize_ = p - cachedPrefix_;
+        cachedSecond_ = secs;
+    }
+
+    append({ cachedPrefix_, cachedPrefixSize_ });
+    appendDec(nsecs % 1000000000ULL, 9);
+}
+
+/*
+ * Format the value of a non-string field in \a buf, and return it. Non-finite
+ * floating point values are returned as an empty string.
+ */
+std::string_view formatFieldValue(const LogField &field, char (&buf)[32])
+{
+    char *end = buf;
+
+    switch (field.type()) {
+    case LogField::Bool:
+        return field.boolValue() ? "true" : "false";
+    case LogField::Int:
+        end = std::to_chars(buf, buf + sizeof(buf), field.intValue()).ptr;
+        break;
+    case LogField::UInt:
+        end = std::to_chars(buf, buf + sizeof(buf), field.uintValue()).ptr;
+        break;
+    case LogField::Double:
+        if (std::isfinite(field.doubleValue()))
+            end = std::to_chars(buf, buf + sizeof(buf), field.doubleValue()).ptr;
+        break;
+    case LogField::String:
+        return field.stringValue();
+    }
+
+    return { buf, static_cast<size_t>(end - buf) };
+}
+
+/*
+ * Append a field as a key/value pair in the given format. Text uses the logfmt
+ * syntax. The journal export format value is terminated by a newline, other
+ * formats are not terminated.
+ */
+void LogLineBuffer::appendField(const LogField &field, LoggingFormat format)
+{
+    char buf[32];
+    std::string_view value = formatFieldValue(field, buf);
+    bool isString = field.type() == LogField::String;
+
+    switch (format) {
+    case LoggingFormatJson:
+        appendJsonString(field.key());
+        append(':');
+        if (isString)
+            appendJsonString(value);
+        else
+            append(value.empty() ? "null" : value);
+        break;
+
+    case LoggingFormatJournal:
+        appendJournalKey(field.key());
+        appendJournalField({}, value);
+        break;
+
+    case LoggingFormatText:
+    case LoggingFormatLogfmt:
+    default:
+        append(field.key());
+        append('=');
+        if (isString)
+            appendLogfmtString(value);
+        else
+            append(value);
+        break;
+    }
+}
+
+void LogLineBuffer::appendJsonString(std::string_view str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    append('"');
+
+    for (char c : str) {
+        switch (c) {
+        case '"':
+            append("\\\"");
+            break;
+        case '\\':
+            append("\\\\");
+            break;
+        case '\n':
+            append("\\n");
+            break;
+        case '\t':
+            append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                append("\\u00");
+                append(hex[c >> 4]);
+                append(hex[c & 0xf]);
+            } else {
+                append(c);
+            }
+            break;
+        }
+    }
+
+    append('"');
+}
+
+/*
+ * Append a logfmt value, quoted and escaped only if it is empty or contains
+ * spaces, quotes, equal signs or control characters.
+ */
+void LogLineBuffer::appendLogfmtString(std::string_view str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    bool quote = str.empty() ||
+                 std::any_of(str.begin(), str.end(), [](char c) {
+                     return c == ' ' || c == '"' || c == '=' || c == '\\' ||
+                            static_cast<unsigned char>(c) < 0x20;
+                 });
+
+    if (!quote) {
+        append(str);
+        return;
+    }
+
+    append('"');
+
+    for (char c : str) {
+        switch (c) {
+        case '"':
+            append("\\\"");
+            break;
+        case '\\':
+            append("\\\\");
+            break;
+        case '\n':
+            append("\\n");
+            break;
+        case '\r':
+            append("\\r");
+            break;
+        case '\t':
+            append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                append("\\x");
+                append(hex[c >> 4]);
+                append(hex[c & 0xf]);
+            } else {
+                append(c);
+            }
+            break;
+        }
+    }
+
+    append('"');
+}
+
+/*
+ * Append a field in the journal export and native protocol formats. Values
+ * that contain a newline use the binary-safe form, with the key followed by a
+ * newline and the value size as a 64-bit little-endian integer. A key already
+ * written with appendJournalKey() is passed as an empty \a key.
+ */
+void LogLineBuffer::appendJournalField(std::string_view key, std::string_view value)
+{
+    append(key);
+
+    if (value.find('\n') == std::string_view::npos) {
+        append('=');
+        append(value);
+        append('\n');
+        return;
+    }
+
+    append('\n');
+
+    uint64_t size = value.size();
+    for (unsigned int i = 0; i < sizeof(size); ++i)
+        append(static_cast<char>(size >> (i * 8)));
+
+    append(value);
+    append('\n');
+}
+
+/*
+ * Journal field names consist of uppercase letters, digits and underscores,
+ * and must start with a letter. Convert the key accordingly.
+ */
+void LogLineBuffer::appendJournalKey(std::string_view key)
+{
+    if (key.empty() || !isalpha(static_cast<unsigned char>(key[0])))
+        append("FIELD_");
+
+    for (char c : key) {
+        unsigned char uc = static_cast<unsigned char>(c);
+        append(isalnum(uc) ? static_cast<char>(toupper(uc)) : '_');
+    }
+}
+
+/* Retrieve the message text without the trailing newline. */
+std::string_view messageText(const LogMessage &msg)
+{
+    std::string_view text = msg.msgView();
+    if (!text.empty() && text.back() == '\n')
+        text.remove_suffix(1);
+    return text;
+}
+
+/* Retrieve the severity name without the alignment padding. */
+std::string_view severityName(LogSeverity severity)
+{
+    std::string_view name = log_severity_name(severity);
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    return name;
+}
+
+void formatJson(LogLineBuffer &line, const LogMessage &msg)
+{
+    line.append("{\"time\":\"");
+    line.appendTimestamp(msg.timestamp());
+    line.append("\",\"tid\":");
+    line.appendDec(Thread::currentId());
+    line.append(",\"severity\":\"");
+    line.append(severityName(msg.severity()));
+    line.append("\",\"category\":");
+    line.appendJsonString(msg.category().name());
+    line.append(",\"file\":");
+    line.appendJsonString(msg.fileName());
+    line.append(",\"line\":");
+    line.appendDec(msg.line());
+    if (!msg.prefix().empty()) {
+        line.append(",\"prefix\":");
+        line.appendJsonString(msg.prefix());
+    }
+    line.append(",\"msg\":");
+    line.appendJsonString(messageText(msg));
+
+    for (const LogField &field : msg.fields()) {
+        line.append(',');
+        line.appendField(field, LoggingFormatJson);
+    }
+
+    if (!msg.backtrace().empty()) {
+        line.append(",\"backtrace\":");
+        line.appendJsonString(msg.backtrace());
+    }
+
+    line.append("}\n");
+}
+
+void formatLogfmt(LogLineBuffer &line, const LogMessage &msg)
+{
+    line.append("time=");
+    line.appendTimestamp(msg.timestamp());
+    line.append(" tid=");
+    line.appendDec(Thread::currentId());
+    line.append(" severity=");
+    line.append(severityName(msg.severity()));
+    line.append(" category=");
+    line.appendLogfmtString(msg.category().name());
+    line.append(" file=");
+    line.appendLogfmtString(msg.fileName());
+    line.append(" line=");
+    line.appendDec(msg.line());
+    if (!msg.prefix().empty()) {
+        line.append(" prefix=");
+        line.appendLogfmtString(msg.prefix());
+    }
+    line.append(" msg=");
+    line.appendLogfmtString(messageText(msg));
+
+    for (const LogField &field : msg.fields()) {
+        line.append(' ');
+        line.appendField(field, LoggingFormatLogfmt);
+    }
+
+    if (!msg.backtrace().empty()) {
+        line.append(" backtrace=");
+        line.appendLogfmtString(msg.backtrace());
+    }
+
+    line.append('\n');
+}
+
+/*
+ * Format a message as a journal export format entry, terminated by an empty
+ * line. The fields, without the empty line, also form a valid journald native
+ * protocol datagram.
+ */
+void formatJournal(LogLineBuffer &line, const LogMessage &msg)
+{
+    char buf[32];
+    char *end;
+
+    line.appendJournalField("MESSAGE", messageText(msg));
+
+    end = std::to_chars(buf, buf + sizeof(buf),
+                        log_severity_to_syslog(msg.severity()))
+                  .ptr;
+    line.appendJournalField("PRIORITY", { buf, static_cast<size_t>(end - buf) });
+
+    line.appendJournalField("CATEGORY", msg.category().name());
+    line.appendJournalField("CODE_FILE", msg.fileName());
+
+    end = std::to_chars(buf, buf + sizeof(buf), msg.line()).ptr;
+    line.appendJournalField("CODE_LINE", { buf, static_cast<size_t>(end - buf) });
+
+    end = std::to_chars(buf, buf + sizeof(buf), Thread::currentId()).ptr;
+    line.appendJournalField("TID", { buf, static_cast<size_t>(end - buf) });
+
+    line.appendJournalField("SYSLOG_IDENTIFIER", program_invocation_short_name);
+
+    if (!msg.prefix().empty())
+        line.appendJournalField("PREFIX", msg.prefix());
+
+    for (const LogField &field : msg.fields())
+        line.appendField(field, LoggingFormatJournal);
+
+    if (!msg.backtrace().empty())
+        line.appendJournalField("BACKTRACE", msg.backtrace());
+
+    line.append('\n');
+}
+
+} /* namespace */
+
+/**
+ * \brief Format a message for the log output
+ * \param[in] msg Message to format
+ *
+ * The format depends on the log output format and target. The text format
+ * includes color escape codes if the log output is colored, and appends the
+ * message fields as logfmt key/value pairs. The JSON, logfmt and journal
+ * formats encode the message fields directly, without color.
+ *
+ * The message is formatted in the \a line buffer, which is cleared first.
+ * Once the buffer has grown to the size of the longest line, formatting a
+ * message doesn't allocate memory.
+ *
+ * \return The formatted message, valid until the \a line buffer is modified
+ */
+std::string_view LogOutput::format(const LogMessage &msg, LogLineBuffer &line) const
+{
+    line.clear();
+
+    if (target_ == LoggingTargetJournal) {
+        formatJournal(line, msg);
+        return line.view();
+    }
+
+    switch (format_.load(std::memory_order_relaxed)) {
+    case LoggingFormatJson:
+        formatJson(line, msg);
+        return line.view();
+    case LoggingFormatLogfmt:
+        formatLogfmt(line, msg);
+        return line.view();
+    case LoggingFormatJournal:
+        formatJournal(line, msg);
+        return line.view();
+    default:
+        break;
+    }
+
+    static const char *const severityColors[] = {
+        kColorBrightCyan,
+        kColorBrightGreen,
+        kColorBrightYellow,
+        kColorBrightRed,
+        kColorBrightMagenta,
+    };
+
+    const char *categoryColor = color_ ? kColorBrightWhite : "";
+    const char *fileColor = color_ ? kColorBrightBlue : "";
+    const char *prefixColor = color_ ? kColorGreen : "";
+    const char *resetColor = color_ ? kColorReset : "";
+    const char *severityColor = "";
+    LogSeverity severity = msg.severity();
+
+    if (color_) {
+        if (static_cast<unsigned int>(severity) < std::size(severityColors))
+            severityColor = severityColors[severity];
+        else
+            severityColor = kColorBrightWhite;
+    }
+
+    switch (target_) {
+    case LoggingTargetSyslog:
+        line.append(log_severity_name(severity));
+        line.append(' ');
+        line.append(msg.category().name());
+        line.append(' ');
+        line.append(msg.fileName());
+        line.append(':');
+        line.appendDec(msg.line());
+        line.append(' ');
+        if (!msg.prefix().empty()) {
+            line.append(msg.prefix());
+            line.append(": ");
+        }
+        break;
+    case LoggingTargetStream:
+    case LoggingTargetFile:
+    case LoggingTargetFlightRecorder:
+        line.append('[');
+        line.appendTimestamp(msg.timestamp());
+        line.append("] [");
+        line.appendDec(Thread::currentId());
+        line.append("] ");
+        line.append(severityColor);
+        line.append(log_severity_name(severity));
+        line.append(' ');
+        line.append(categoryColor);
+        line.append(msg.category().name());
+        line.append(' ');
+        line.append(fileColor);
+        line.append(msg.fileName());
+        line.append(':');
+        line.appendDec(msg.line());
+        line.append(' ');
+        if (!msg.prefix().empty()) {
+            line.append(prefixColor);
+            line.append(msg.prefix());
+            line.append(": ");
+        }
+        line.append(resetColor);
+        break;
+    default:
+        break;
+    }
+
+    if (msg.fields().empty()) {
+        line.append(msg.msgView());
+    } else {
+        line.append(messageText(msg));
+        for (const LogField &field : msg.fields()) {
+            line.append(' ');
+            line.appendField(field, LoggingFormatText);
+        }
+        line.append('\n');
+    }
+
+    /* The text format is meant for humans, keep the backtrace readable. */
+    if (severity == LogFatal) {
+        if (msg.backtrace().empty()) {
+            line.append("Backtrace not available\n");
+        } else {
+            line.append("Backtrace:\n");
+            line.append(msg.backtrace());
+        }
+    }
+
+    return line.view();
+}
+
+/**
+ * \brief Identify the format of the log output
+ *
+ * Log outputs with the same format key produce identical formatted messages,
+ * which allows formatting a message once for all of them.
+ *
+ * \return The format key
+ */
+unsigned int LogOutput::formatKey() const
+{
+    if (target_ == LoggingTargetJournal)
+        return LoggingFormatJournal;
+
+    LoggingFormat format = format_.load(std::memory_order_relaxed);
+    if (format != LoggingFormatText)
+        return format;
+
+    /* The text format depends on the color and on the syslog target. */
+    return LoggingFormatJournal + 1 + (color_ ? 1 : 0) +
+           (target_ == LoggingTargetSyslog ? 2 : 0);
+}
+
+/**
+ * \brief Write a formatted message to log output
+ * \param[in] severity The message severity
+ * \param[in] str The message, formatted with format()
+ */
+void LogOutput::write(LogSeverity severity, std::string_view str)
+{
+    switch (target_) {
+    case LoggingTargetSyslog:
+        writeSyslog(severity, str);
+        break;
+    case LoggingTargetStream:
+    case LoggingTargetFile:
+        writeStream(str);
+        break;
+    case LoggingTargetFlightRecorder:
+        recorder_->write(str);
+        break;
+    case LoggingTargetJournal:
+        journal_->send(str);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * \brief Format a string for the log output
+ * \param[in] str The string
+ *
+ * Strings are written as-is to all targets but the journal, which requires
+ * them to be wrapped in a journal entry.
+ *
+ * \return The formatted string
+ */
+std::string LogOutput::formatString(const std::string &str) const
+{
+    if (target_ != LoggingTargetJournal)
+        return str;
+
+    std::string_view text(str);
+    if (!text.empty() && text.back() == '\n')
+        text.remove_suffix(1);
+
+    LogLineBuffer line;
+    line.appendJournalField("MESSAGE", text);
+    line.appendJournalField("PRIORITY", std::to_string(log_severity_to_syslog(LogDebug)));
+    line.appendJournalField("SYSLOG_IDENTIFIER", program_invocation_short_name);
+    line.append('\n');
+
+    return std::string(line.view());
+}
+
+/**
+ * \brief Write string to log output
+ * \param[in] str String to write
+ */
+void LogOutput::write(const std::string &str)
+{
+    switch (target_) {
+    case LoggingTargetSyslog:
+        writeSyslog(LogDebug, str);
+        break;
+    case LoggingTargetStream:
+    case LoggingTargetFile:
+        writeStream(str);
+        break;
+    case LoggingTargetFlightRecorder:
+        recorder_->write(str);
+        break;
+    case LoggingTargetJournal:
+        journal_->send(formatString(str));
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * \brief Write a batch of formatted records to log output
+ * \param[in] records The records to write
+ *
+ * For stream and file targets the records are concatenated and written with a
+ * single write and flush operation. For the journal target the records are
+ * sent with a single system call.
+ */
+void LogOutput::write(Span<const LogRecord> records)
+{
+    switch (target_) {
+    case LoggingTargetSyslog:
+        for (const LogRecord &record : records)
+            writeSyslog(record.severity, record.msg);
+        break;
+    case LoggingTargetStream:
+    case LoggingTargetFile: {
+        size_t size = 0;
+        for (const LogRecord &record : records)
+            size += record.msg.size();
+
+        std::string batch;
+        batch.reserve(size);
+        for (const LogRecord &record : records)
+            batch += record.msg;
+
+        writeStream(batch);
+        break;
+    }
+    case LoggingTargetFlightRecorder:
+        for (const LogRecord &record : records)
+            recorder_->write(record.msg);
+        break;
+    case LoggingTargetJournal:
+        journal_->send(records);
+        break;
+    default:
+        break;
+    }
+}
+
+void LogOutput::writeSyslog(LogSeverity severity, std::string_view str)
+{
+    syslog(log_severity_to_syslog(severity), "%.*s",
+           static_cast<int>(str.size()), str.data());
+}
+
+/**
+ * \brief Enable rotation of the log file
+ * \param[in] maxSize The size above which the file is rotated, 0 to disable
+ * size-based rotation
+ * \param[in] count The number of rotated files to keep
+ * \param[in] interval The rotation interval, 0 to disable time-based rotation
+ * \param[in] compress True to compress the rotated files
+ *
+ * Once rotation is enabled, messages are written to the file through a
+ * LogFileRotator, and the file stream is closed. Calling this function again
+ * updates the rotation parameters of the rotator, the file being written is
+ * kept.
+ *
+ * \return Zero on success, -EINVAL if the output is not a file, or a negative
+ * error code if the file can't be reopened
+ */
+int LogOutput::setRotation(size_t maxSize, unsigned int count,
+                           std::chrono::seconds interval, bool compress)
+{
+    if (target_ != LoggingTargetFile)
+        return -EINVAL;
+
+    std::shared_ptr<LogFileRotator> rotator = std::atomic_load(&rotator_);
+    if (rotator) {
+        rotator->configure(maxSize, count, interval, compress);
+        return 0;
+    }
+
+    MutexLocker locker(streamMutex_);
+
+    stream_->flush();
+
+    rotator = std::make_shared<LogFileRotator>(path_, maxSize, count,
+                                               interval, compress);
+    if (!rotator->isValid())
+        return -errno;
+
+    std::atomic_store(&rotator_, std::move(rotator));
+
+    /* The rotator has its own file descriptor, the stream isn't used anymore. */
+    delete stream_;
+    stream_ = nullptr;
+
+    return 0;
+}
+
+void LogOutput::writeStream(std::string_view str)
+{
+    if (target_ == LoggingTargetFile) {
+        std::shared_ptr<LogFileRotator> rotator = std::atomic_load(&rotator_);
+        if (!rotator) {
+            MutexLocker locker(streamMutex_);
+            if (stream_) {
+                stream_->write(str.data(), str.size());
+                stream_->flush();
+                return;
+            }
+
+            rotator = std::atomic_load(&rotator_);
+        }
+
+        rotator->write(str);
+        return;
+    }
+
+    stream_->write(str.data(), str.size());
+    stream_->flush();
+}
+
+/**
+ * \brief Asynchronous log writer
+ *
+ * The AsyncLogWriter class decouples formatting of log messages from their
+ * output. Producers push formatted records to a lock-free bounded ring buffer,
+ * and a background thread drains the ring and writes the records to their log
+ * output in batches.
+ *
+ * The ring buffer is a bounded multi-producer single-consumer queue, where
+ * each slot carries a sequence number that tells producers and the consumer
+ * whether the slot is free or filled. Producers only synchronize through an
+ * atomic enqueue position, the mutex is only used to wake up the writer thread
+ * when it is idle and to wait for the ring to drain.
+ */
+class AsyncLogWriter : public Thread
+{
+public:
+    AsyncLogWriter(LoggingOverflowPolicy policy, unsigned int capacity);
+    ~AsyncLogWriter();
+
+    void push(LogRecord &&record);
+    void flush();
+    void dump(int fd) const;
+    void notifyRetired(Semaphore *semaphore) { retired_ = semaphore; }
+
+    static AsyncLogWriter *active();
+
+protected:
+    void run() override;
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    static constexpr unsigned int kMaxBatchSize = 256;
+
+    bool tryPush(LogRecord &record);
+    bool tryPop(LogRecord *record);
+    void wake();
+    void reportDropped(uint64_t dropped, Span<const LogRecord> records);
+
+    LoggingOverflowPolicy policy_;
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+
+    std::atomic<size_t> enqueuePos_;
+    size_t dequeuePos_;
+    std::atomic<size_t> writtenPos_;
+    std::atomic<uint64_t> dropped_;
+
+    Mutex mutex_;
+    ConditionVariable wakeCv_;
+    ConditionVariable writtenCv_;
+    std::atomic<bool> idle_;
+    bool stop_ ZEUS_TSA_GUARDED_BY(mutex_);
+
+    Semaphore *retired_;
+
+    static std::atomic<AsyncLogWriter *> active_;
+};
+
+std::atomic<AsyncLogWriter *> AsyncLogWriter::active_ = nullptr;
+
+/**
+ * \brief Construct an asynchronous log writer and start its thread
+ * \param[in] policy The policy applied when the ring buffer is full
+ * \param[in] capacity The ring buffer capacity, rounded up to a power of two
+ */
+AsyncLogWriter::AsyncLogWriter(LoggingOverflowPolicy policy, unsigned int capacity)
+        : policy_(policy), enqueuePos_(0), dequeuePos_(0), writtenPos_(0),
+          dropped_(0), idle_(false), stop_(false), retired_(nullptr)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    slots_ = std::make_unique<Slot[]>(size);
+    for (size_t i = 0; i < size; ++i)
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    mask_ = size - 1;
+
+    start();
+
+    active_.store(this, std::memory_order_release);
+}
+
+/**
+ * \brief Stop the writer thread after writing all pending records
+ *
+ * The semaphore passed to notifyRetired(), if any, is released once the thread
+ * has stopped.
+ */
+AsyncLogWriter::~AsyncLogWriter()
+{
+    AsyncLogWriter *writer = this;
+    active_.compare_exchange_strong(writer, nullptr, std::memory_order_acq_rel);
+
+    {
+        MutexLocker locker(mutex_);
+        stop_ = true;
+    }
+
+    wakeCv_.notify_one();
+    wait();
+
+    if (retired_)
+        retired_->release();
+}
+
+/**
+ * \brief Queue a formatted record for output
+ * \param[in] record The record
+ *
+ * If the ring buffer is full, the record is dropped or the caller blocks until
+ * space is available, depending on the overflow policy.
+ */
+void AsyncLogWriter::push(LogRecord &&record)
+{
+    while (true) {
+        size_t written = writtenPos_.load(std::memory_order_acquire);
+        if (tryPush(record))
+            break;
+
+        if (policy_ == LoggingOverflowDrop) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        /*
+		 * Wait for the writer thread to make progress. The written
+		 * position is sampled before trying to push, as the writer may
+		 * drain the whole ring in the meantime.
+		 */
+        MutexLocker locker(mutex_);
+        wakeCv_.notify_one();
+        writtenCv_.wait(locker, [&]() {
+            return writtenPos_.load(std::memory_order_acquire) != written;
+        });
+    }
+
+    /* Pairs with the fence in run() to avoid missed wakeups. */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_.load(std::memory_order_relaxed))
+        wake();
+}
+
+/**
+ * \brief Wait until all records queued so far have been written
+ */
+void AsyncLogWriter::flush()
+{
+    size_t target = enqueuePos_.load(std::memory_order_acquire);
+
+    MutexLocker locker(mutex_);
+    wakeCv_.notify_one();
+    writtenCv_.wait(locker, [&]() {
+        return writtenPos_.load(std::memory_order_acquire) >= target;
+    });
+}
+
+/**
+ * \brief Write the records that have not been written yet to a file descriptor
+ * \param[in] fd The file descriptor
+ *
+ * This function is meant to save pending messages when the process crashes.
+ * The records are read without synchronizing with the writer thread, records
+ * being written concurrently may be output twice or corrupted.
+ *
+ * \context This function is async-signal-safe.
+ */
+void AsyncLogWriter::dump(int fd) const
+{
+    size_t end = enqueuePos_.load(std::memory_order_acquire);
+
+    for (size_t pos = writtenPos_.load(std::memory_order_acquire); pos < end; ++pos) {
+        const Slot &slot = slots_[pos & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            continue;
+
+        log_write_fd(fd, slot.record.msg);
+    }
+}
+
+/**
+ * \brief Retrieve the active asynchronous log writer
+ * \context This function is async-signal-safe.
+ * \return The most recently constructed writer, or nullptr if it has been
+ * destroyed
+ */
+AsyncLogWriter *AsyncLogWriter::active()
+{
+    return active_.load(std::memory_order_acquire);
+}
+
+bool AsyncLogWriter::tryPush(LogRecord &record)
+{
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    Slot *slot;
+
+    while (true) {
+        slot = &slots_[pos & mask_];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->record = std::move(record);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AsyncLogWriter::tryPop(LogRecord *record)
+{
+    Slot *slot = &slots_[dequeuePos_ & mask_];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    if (seq != dequeuePos_ + 1)
+        return false;
+
+    *record = std::move(slot->record);
+    slot->record.output.reset();
+    slot->sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+    dequeuePos_++;
+    return true;
+}
+
+void AsyncLogWriter::wake()
+{
+    MutexLocker locker(mutex_);
+    wakeCv_.notify_one();
+}
+
+/*
+ * Write a report of \a dropped messages to the outputs of \a records, as a
+ * separate warning message formatted by each output.
+ */
+void AsyncLogWriter::reportDropped(uint64_t dropped, Span<const LogRecord> records)
+{
+    LogMessage msg(__FILE__, __LINE__, LogCategory::defaultCategory(),
+                   LogWarning);
+    msg.stream() << dropped << " log messages dropped" << std::endl;
+
+    LogLineBuffer line;
+    std::vector<const LogOutput *> outputs;
+
+    for (const LogRecord &record : records) {
+        LogOutput *output = record.output.get();
+        if (std::find(outputs.begin(), outputs.end(), output) != outputs.end())
+            continue;
+
+        outputs.push_back(output);
+
+        LogRecord report{ record.output, LogWarning,
+                          std::string(output->format(msg, line)) };
+        output->write(Span<const LogRecord>{ &report, 1 });
+    }
+
+    /* The report has been written, don't log the message again. */
+    msg.severity_ = LogInvalid;
+}
+
+void AsyncLogWriter::run()
+{
+    std::vector<LogRecord> batch(kMaxBatchSize);
+
+    while (true) {
+        unsigned int count = 0;
+        while (count < kMaxBatchSize && tryPop(&batch[count]))
+            count++;
+
+        /* Write runs of consecutive records that share the same output. */
+        for (unsigned int start = 0; start < count;) {
+            unsigned int end = start + 1;
+            while (end < count && batch[end].output == batch[start].output)
+                end++;
+
+            batch[start].output->write(Span<const LogRecord>{ &batch[start], end - start });
+            start = end;
+        }
+
+        /*
+		 * Report dropped messages after the records of the batch. The
+		 * ring is full when messages are dropped, so there's always at
+		 * least one record whose output to report to.
+		 */
+        if (count) {
+            uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+            if (dropped)
+                reportDropped(dropped, Span<const LogRecord>{ batch.data(), count });
+        }
+
+        for (unsigned int i = 0; i < count; ++i)
+            batch[i].output.reset();
+
+        MutexLocker locker(mutex_);
+
+        if (count) {
+            writtenPos_.store(dequeuePos_, std::memory_order_release);
+            writtenCv_.notify_all();
+            continue;
+        }
+
+        if (stop_)
+            break;
+
+        /*
+		 * The ring is empty, sleep until a producer wakes us up. The idle
+		 * flag is set before checking the ring one last time to avoid
+		 * missing records pushed concurrently.
+		 */
+        idle_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Slot *slot = &slots_[dequeuePos_ & mask_];
+        wakeCv_.wait(locker, [&]() ZEUS_TSA_REQUIRES(mutex_) {
+            return stop_ || slot->sequence.load(std::memory_order_acquire) == dequeuePos_ + 1;
+        });
+        idle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * \brief Crash signal handler
+ *
+ * The CrashHandler catches the signals raised by program crashes, and writes
+ * a crash report to a file descriptor opened when the handler is installed.
+ * The report contains the signal, the raw instruction pointers of the call
+ * stack, the memory mappings of the process, and the log messages that have
+ * not been written yet: the flight recorder contents and the messages queued
+ * to the asynchronous log writer.
+ *
+ * Only async-signal-safe operations are performed in the handler. No symbol
+ * is resolved, the report is converted to a readable form offline with
+ * logDecodeCrashReport(). The handler then restores the action in place when
+ * it was installed, or the default action if the signal was ignored, and lets
+ * the signal be delivered again. A previously installed handler thus runs
+ * after the report, and the default action terminates the process with the
+ * original signal.
+ *
+ * The alternate signal stack is only set up for the installing thread, stack
+ * overflows in other threads can't be reported.
+ */
+class CrashHandler
+{
+public:
+    static int install(int fd);
+    static void uninstall();
+
+private:
+    static constexpr int kSignals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    static constexpr size_t kStackSize = 64 * 1024;
+    static constexpr unsigned int kMaxFrames = 64;
+
+    static void handler(int signal, siginfo_t *info, void *context)
+        ZEUS_TSA_NO_THREAD_SAFETY_ANALYSIS;
+    static void writeReport(int fd, int signal, const siginfo_t *info,
+                            const void *context);
+
+    static Mutex mutex_;
+    static std::atomic<int> fd_;
+    static std::atomic<bool> crashing_;
+    static std::unique_ptr<char[]> stack_ ZEUS_TSA_GUARDED_BY(mutex_);
+    static struct sigaction previous_[std::size(kSignals)] ZEUS_TSA_GUARDED_BY(mutex_);
+};
+
+Mutex CrashHandler::mutex_;
+std::atomic<int> CrashHandler::fd_ = -1;
+std::atomic<bool> CrashHandler::crashing_ = false;
+std::unique_ptr<char[]> CrashHandler::stack_;
+struct sigaction CrashHandler::previous_[std::size(CrashHandler::kSignals)];
+
+/**
+ * \brief Install the crash handler
+ * \param[in] fd The file descriptor to write crash reports to
+ *
+ * The file descriptor is duplicated, the caller keeps ownership of \a fd.
+ * Installing the handler again replaces the file descriptor.
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int CrashHandler::install(int fd)
+{
+    MutexLocker locker(mutex_);
+
+    UniqueFD crashFd(fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    if (!crashFd.isValid())
+        return -errno;
+
+    /*
+	 * Capture a backtrace once, to load the unwinder before it is needed
+	 * in signal context.
+	 */
+    void *addresses[1];
+    Backtrace::capture(addresses, std::size(addresses));
+
+    /* Handle stack overflows in the installing thread. */
+    if (!stack_) {
+        stack_ = std::make_unique<char[]>(kStackSize);
+
+        stack_t stack = {};
+        stack.ss_sp = stack_.get();
+        stack.ss_size = kStackSize;
+        sigaltstack(&stack, nullptr);
+    }
+
+    int previousFd = fd_.exchange(crashFd.release());
+    if (previousFd != -1) {
+        close(previousFd);
+        return 0;
+    }
+
+    struct sigaction action = {};
+    action.sa_sigaction = &CrashHandler::handler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    for (unsigned int i = 0; i < std::size(kSignals); ++i)
+        sigaction(kSignals[i], &action, &previous_[i]);
+
+    return 0;
+}
+
+/**
+ * \brief Uninstall the crash handler
+ *
+ * Restore the signal actions in place when the handler was installed, and
+ * close the crash report file descriptor.
+ */
+void CrashHandler::uninstall()
+{
+    MutexLocker locker(mutex_);
+
+    int fd = fd_.load();
+    if (fd == -1)
+        return;
+
+    for (unsigned int i = 0; i < std::size(kSignals); ++i)
+        sigaction(kSignals[i], &previous_[i], nullptr);
+
+    fd_.store(-1);
+    close(fd);
+}
+
+void CrashHandler::handler(int signal, siginfo_t *info, void *context)
+{
+    int savedErrno = errno;
+
+    /*
+	 * Only report the first crash. Other threads crashing concurrently
+	 * wait for the process to be terminated.
+	 */
+    if (crashing_.exchange(true)) {
+        while (true)
+            pause();
+    }
+
+    int fd = fd_.load();
+    if (fd != -1)
+        writeReport(fd, signal, info, context);
+
+    /*
+	 * Restore the previous action, without taking the lock as the
+	 * handler may have interrupted install() or uninstall(). An ignored
+	 * fault would be raised again forever, use the default action instead.
+	 */
+    for (unsigned int i = 0; i < std::size(kSignals); ++i) {
+        if (kSignals[i] != signal)
+            continue;
+
+        struct sigaction action = previous_[i];
+        if (!(action.sa_flags & SA_SIGINFO) && action.sa_handler == SIG_IGN)
+            action.sa_handler = SIG_DFL;
+
+        sigaction(signal, &action, nullptr);
+        break;
+    }
+
+    /*
+	 * Faults are raised again when the faulting instruction is restarted,
+	 * signals sent by a process need to be raised explicitly. The signal
+	 * is then delivered to the previous action.
+	 */
+    if (info->si_code <= 0)
+        raise(signal);
+
+    errno = savedErrno;
+}
+
+void CrashHandler::writeReport(int fd, int signal, const siginfo_t *info,
+                               const void *context)
+{
+    static const std::pair<int, const char *> names[] = {
+        { SIGSEGV, "SIGSEGV" },
+        { SIGBUS, "SIGBUS" },
+        { SIGILL, "SIGILL" },
+        { SIGFPE, "SIGFPE" },
+        { SIGABRT, "SIGABRT" },
+    };
+
+    char buf[32];
+    auto dec = [&](uint64_t value) {
+        return std::string_view(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr - buf);
+    };
+    auto hex = [&](uintptr_t value) {
+        buf[0] = '0';
+        buf[1] = 'x';
+        char *end = std::to_chars(buf + 2, buf + sizeof(buf), value, 16).ptr;
+        return std::string_view(buf, end - buf);
+    };
+
+    const char *name = "unknown";
+    for (const auto &[sig, str] : names) {
+        if (sig == signal)
+            name = str;
+    }
+
+    log_write_fd(fd, kCrashReportHeader);
+    log_write_fd(fd, " signal ");
+    log_write_fd(fd, dec(signal));
+    log_write_fd(fd, " (");
+    log_write_fd(fd, name);
+    log_write_fd(fd, ") at address ");
+    log_write_fd(fd, hex(reinterpret_cast<uintptr_t>(info->si_addr)));
+    log_write_fd(fd, " in thread ");
+    log_write_fd(fd, dec(gettid()));
+    log_write_fd(fd, "\n");
+
+#if defined(__x86_64__)
+    const ucontext_t *uc = static_cast<const ucontext_t *>(context);
+    log_write_fd(fd, "pc ");
+    log_write_fd(fd, hex(uc->uc_mcontext.gregs[REG_RIP]));
+    log_write_fd(fd, "\n");
+#elif defined(__aarch64__)
+    const ucontext_t *uc = static_cast<const ucontext_t *>(context);
+    log_write_fd(fd, "pc ");
+    log_write_fd(fd, hex(uc->uc_mcontext.pc));
+    log_write_fd(fd, "\n");
+#else
+    (void)context;
+#endif
+
+    void *addresses[kMaxFrames];
+    unsigned int count = Backtrace::capture(addresses, kMaxFrames);
+
+    log_write_fd(fd, "Backtrace:\n");
+    for (unsigned int i = 0; i < count; ++i) {
+        log_write_fd(fd, "#");
+        log_write_fd(fd, dec(i));
+        log_write_fd(fd, " ");
+        log_write_fd(fd, hex(reinterpret_cast<uintptr_t>(addresses[i])));
+        log_write_fd(fd, "\n");
+    }
+
+    /* The memory map allows resolving the addresses offline. */
+    log_write_fd(fd, "Maps:\n");
+
+    int maps = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if (maps != -1) {
+        char data[4096];
+        ssize_t size;
+
+        while ((size = read(maps, data, sizeof(data))) > 0)
+            log_write_fd(fd, { data, static_cast<size_t>(size) });
+
+        close(maps);
+    }
+
+    log_write_fd(fd, "Log:\n");
+    logDumpFlightRecorder(fd);
+
+    AsyncLogWriter *writer = AsyncLogWriter::active();
+    if (writer)
+        writer->dump(fd);
+
+    logDumpBinary();
+
+    log_write_fd(fd, kCrashReportFooter);
+    log_write_fd(fd, "\n");
+}
+
+/**
+ * \brief A log output with its severity filter
+ *
+ * Log sinks are immutable once published in the logger sink list. Changing
+ * the configuration of a sink replaces it with a modified copy that shares
+ * the same log output.
+ */
+struct LogSink {
+    bool accepts(const LogCategory &category, LogSeverity severity) const;
+
+    /**
+	 * \brief The sink identifier, 0 for the primary sink
+	 */
+    int id;
+    /**
+	 * \brief The log output
+	 */
+    std::shared_ptr<LogOutput> output;
+    /**
+	 * \brief The minimum severity of messages output to the sink
+	 */
+    LogSeverity severity;
+    /**
+	 * \brief Per-category minimum severity overrides, as pattern and
+	 * severity pairs
+	 */
+    std::vector<std::pair<std::string, LogSeverity>> levels;
+};
+
+/**
+ * \brief Check if a category name matches a pattern
+ * \param[in] pattern The pattern
+ * \param[in] name The category name
+ *
+ * A '*' in the pattern matches all the remaining characters of the name.
+ *
+ * \return True if \a name matches \a pattern, false otherwise
+ */
+static bool log_category_matches(const std::string &pattern, const std::string &name)
+{
+    for (unsigned int i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == '*')
+            return true;
+
+        if (i >= name.size() || name[i] != pattern[i])
+            return false;
+    }
+
+    return pattern.size() == name.size();
+}
+
+/**
+ * \brief Check if a message is output to the sink
+ * \param[in] category The message category
+ * \param[in] severity The message severity
+ *
+ * Fatal messages are output to all sinks.
+ *
+ * \return True if the message shall be output, false otherwise
+ */
+bool LogSink::accepts(const LogCategory &category, LogSeverity severity) const
+{
+    if (severity == LogFatal)
+        return true;
+
+    for (const auto &[pattern, level] : levels) {
+        if (log_category_matches(pattern, category.name()))
+            return severity >= level;
+    }
+
+    return severity >= this->severity;
+}
+
+using LogSinkList = std::vector<LogSink>;
+
+/**
+ * \brief Message logger
+ *
+ * The Logger class handles log configuration.
+ */
+class Logger
+{
+public:
+    ~Logger();
+
+    static Logger *instance();
+
+    void write(const LogMessage &msg);
+    void flush();
+
+    int logSetFile(const char *path, bool color);
+    int logSetStream(std::ostream *stream, bool color);
+    int logSetFlightRecorder(size_t size, const char *path);
+    int logSetTarget(LoggingTarget target);
+    int logSetFormat(LoggingFormat format);
+    int logAddSink(std::shared_ptr<LogOutput> output);
+    int logRemoveSink(int sink);
+    int logSetSinkLevel(int sink, const char *category, const char *level);
+    int logSetSinkFormat(int sink, LoggingFormat format);
+    int logSetSinkRotation(int sink, size_t maxSize, unsigned int count,
+                           std::chrono::seconds interval, bool compress);
+    void logSetLevel(const char *category, const char *level);
+    int logSetAsync(bool enable, LoggingOverflowPolicy policy,
+                    unsigned int capacity);
+    void logSetCollapseRepeated(bool enable);
+
+private:
+    Logger();
+
+    void setOutput(std::shared_ptr<LogOutput> output);
+    template<typename Func>
+    int updateSink(int sink, Func &&func);
+    void writeString(const LogSink &sink, const std::string &str);
+    std::shared_ptr<AsyncLogWriter> asyncWriter();
+
+    bool collapseRepeated(const LogMessage &msg);
+    void writeRepeated() ZEUS_TSA_REQUIRES(repeatMutex_);
+
+    void parseLogFile();
+    void parseLogFormat();
+    void parseLogAsync();
+    void parseLogLevels();
+    static LogSeverity parseLogLevel(const std::string &level);
+
+    friend LogCategory;
+    void registerCategory(LogCategory *category);
+    LogCategory *findCategory(const char *name) const;
+
+    static bool destroyed_;
+
+    std::vector<LogCategory *> categories_;
+    std::list<std::pair<std::string, LogSeverity>> levels_;
+
+    Mutex sinksMutex_;
+    std::shared_ptr<const LogSinkList> sinks_;
+    int nextSinkId_ ZEUS_TSA_GUARDED_BY(sinksMutex_);
+    std::atomic<LoggingFormat> format_;
+    std::shared_ptr<AsyncLogWriter> writer_;
+    Mutex asyncMutex_;
+    std::atomic<bool> switching_;
+    Semaphore writerRetired_;
+
+    std::atomic<bool> collapse_;
+    Mutex repeatMutex_;
+    const LogCategory *lastCategory_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+    LogSeverity lastSeverity_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+    const char *lastFileName_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+    unsigned int lastLine_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+    std::string lastPrefix_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+    std::string lastMsg_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+    unsigned int repeated_ ZEUS_TSA_GUARDED_BY(repeatMutex_);
+};
+
+bool Logger::destroyed_ = false;
+
+/**
+ * \enum LoggingTarget
+ * \brief Log destination type
+ * \var LoggingTargetNone
+ * \brief No logging destination
+ * \sa Logger::logSetTarget
+ * \var LoggingTargetSyslog
+ * \brief Log to syslog
+ * \sa Logger::logSetTarget
+ * \var LoggingTargetFile
+ * \brief Log to file
+ * \sa Logger::logSetFile
+ * \var LoggingTargetStream
+ * \brief Log to stream
+ * \sa Logger::logSetStream
+ * \var LoggingTargetFlightRecorder
+ * \brief Log to an in-memory flight recorder
+ * \sa Logger::logSetFlightRecorder
+ * \var LoggingTargetJournal
+ * \brief Log to the systemd journal with the native protocol
+ * \sa Logger::logSetTarget
+ */
+
+/**
+ * \brief Direct logging to a file
+ * \param[in] path Full path to the log file
+ * \param[in] color True to output colored messages
+ *
+ * This function directs the log output to the file identified by \a path. The
+ * previous log target, if any, is closed, and all new log messages will be
+ * written to the new log file.
+ *
+ * \a color controls whether or not the messages will be colored with standard
  * ANSI escape codes. This is done regardless of whether \a path refers to a
  * standard file or a TTY, the caller is responsible for disabling coloring when
  * not suitable for the log target.
  *
- * If the function returns an error, the log target is not changed.
+ * If the function returns an error, the log target is not changed.
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int logSetFile(const char *path, bool color)
+{
+    return Logger::instance()->logSetFile(path, color);
+}
+
+/**
+ * \brief Direct logging to a stream
+ * \param[in] stream Stream to send log output to
+ * \param[in] color True to output colored messages
+ *
+ * This function directs the log output to \a stream. The previous log target,
+ * if any, is closed, and all new log messages will be written to the new log
+ * stream.
+ *
+ * \a color controls whether or not the messages will be colored with standard
+ * ANSI escape codes. This is done regardless of whether \a stream refers to a
+ * standard file or a TTY, the caller is responsible for disabling coloring when
+ * not suitable for the log target.
+ *
+ * If the function returns an error, the log file is not changed
+ *
+ * \return Zero on success, or a negative error code otherwise.
+ */
+int logSetStream(std::ostream *stream, bool color)
+{
+    return Logger::instance()->logSetStream(stream, color);
+}
+
+/**
+ * \enum LoggingFormat
+ * \brief Log message format
+ * \var LoggingFormatText
+ * \brief Human-readable text, with message fields appended as key=value pairs
+ * \var LoggingFormatJson
+ * \brief One JSON object per line (JSON lines)
+ * \var LoggingFormatLogfmt
+ * \brief One logfmt line of key=value pairs per message
+ * \var LoggingFormatJournal
+ * \brief systemd journal export format, one entry per message
+ */
+
+/**
+ * \brief Set the log message format
+ * \param[in] format The log format
+ *
+ * This function selects how log messages are encoded by the log output. The
+ * structured formats encode the message metadata (timestamp, thread ID,
+ * severity, category, location and prefix), the message text and the message
+ * fields (see LogField) as separate keys, and are meant to be consumed by log
+ * processing tools. The format applies to the current and future log outputs.
+ *
+ * The format can also be set with the ZEUS_LOG_FORMAT environment variable,
+ * to "json", "logfmt" or "journal".
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int logSetFormat(LoggingFormat format)
+{
+    return Logger::instance()->logSetFormat(format);
+}
+
+/**
+ * \brief Direct logging to an in-memory flight recorder
+ * \param[in] size The flight recorder size in bytes
+ * \param[in] path The path to a file backing the flight recorder (optional)
+ *
+ * This function sets the logging output to a flight recorder, a fixed-size
+ * ring buffer of \a size bytes that stores the most recent formatted
+ * messages. Recording a message costs a memory copy, without any I/O or lock,
+ * which allows keeping detailed log levels enabled permanently.
+ *
+ * If \a path is specified, the file at \a path is created or truncated and
+ * mapped as the ring buffer. The recorded messages are then kept in the file
+ * even if the process is killed, and can be converted to text with
+ * logDecodeFlightRecorder().
+ *
+ * The recorded messages are written to stderr when a Fatal message is logged,
+ * and can be written to any file descriptor with logDumpFlightRecorder(),
+ * including from a signal handler.
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int logSetFlightRecorder(size_t size, const char *path)
+{
+    return Logger::instance()->logSetFlightRecorder(size, path);
+}
+
+/**
+ * \brief Set the logging target
+ * \param[in] target Logging destination
+ *
+ * This function sets the logging output to the target specified by \a target.
+ * The allowed values of \a target are LoggingTargetNone, LoggingTargetSyslog
+ * and LoggingTargetJournal. LoggingTargetNone will send the log output to
+ * nowhere, LoggingTargetSyslog will send the log output to syslog, and
+ * LoggingTargetJournal will send the log output to the systemd journal. The
+ * previous log target, if any, is closed, and all new log messages will be
+ * written to the new log destination.
+ *
+ * The journal target sends each message as a journal entry with the message
+ * category, source file and line, and thread ID in separate fields, see
+ * logAddJournalSink() for more information.
+ *
+ * LoggingTargetFile, LoggingTargetStream and LoggingTargetFlightRecorder are
+ * not valid values for \a target. Use logSetFile(), logSetStream() and
+ * logSetFlightRecorder() instead, respectively.
+ *
+ * If the function returns an error, the log file is not changed.
+ *
+ * \return Zero on success, or a negative error code otherwise.
+ */
+int logSetTarget(LoggingTarget target)
+{
+    return Logger::instance()->logSetTarget(target);
+}
+
+/**
+ * \enum LoggingOverflowPolicy
+ * \brief Policy applied when the asynchronous log buffer is full
+ * \var LoggingOverflowBlock
+ * \brief Block the logging thread until space is available
+ * \var LoggingOverflowDrop
+ * \brief Drop the message and count it, the number of dropped messages is
+ * reported in the log
+ */
+
+/**
+ * \brief Enable or disable asynchronous logging
+ * \param[in] enable True to enable asynchronous logging, false to disable it
+ * \param[in] policy The policy applied when the log buffer is full
+ * \param[in] capacity The number of messages the log buffer can hold
+ *
+ * When asynchronous logging is enabled, log messages are formatted in the
+ * context of the logging thread and queued to a bounded lock-free buffer. A
+ * background thread writes the queued messages to the log target in batches,
+ * so slow log targets don't stall the logging threads.
+ *
+ * The \a policy selects whether logging threads block or drop messages when
+ * the buffer is full. The \a capacity is rounded up to the next power of two.
+ *
+ * Pending messages are written before a Fatal message, when asynchronous
+ * logging is disabled, and when the logger is destroyed at exit. Calling this
+ * function when asynchronous logging is already enabled replaces the buffer
+ * after flushing it.
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int logSetAsync(bool enable, LoggingOverflowPolicy policy,
+                unsigned int capacity)
+{
+    return Logger::instance()->logSetAsync(enable, policy, capacity);
+}
+
+/**
+ * \brief Write all pending asynchronous log messages
+ *
+ * This function blocks until all messages logged so far have been written to
+ * the log target. It returns immediately if asynchronous logging is disabled.
+ * The repeat count of the last message is written first when repeated messages
+ * are collapsed.
+ */
+void logFlush()
+{
+    Logger::instance()->flush();
+}
+
+/**
+ * \brief Enable or disable collapsing of repeated log messages
+ * \param[in] enable True to collapse repeated messages, false otherwise
+ *
+ * When enabled, a message identical to the previous message (same category,
+ * severity, location, prefix and text) is not output. The number of collapsed
+ * messages is instead reported with a "last message repeated N times" line
+ * when a different message is logged, or when the log is flushed with
+ * logFlush(). Fatal messages are never collapsed.
+ *
+ * Comparing messages requires serializing all logging threads, collapsing is
+ * thus disabled by default.
+ */
+void logSetCollapseRepeated(bool enable)
+{
+    Logger::instance()->logSetCollapseRepeated(enable);
+}
+
+/**
+ * \brief Add a log sink writing to a file
+ * \param[in] path Full path to the log file
+ * \param[in] color True to output colored messages
+ *
+ * Log sinks output log messages in addition to the primary log output set by
+ * logSetFile(), logSetStream(), logSetFlightRecorder() and logSetTarget().
+ * Each sink has its own severity filter, configured with logSetSinkLevel(),
+ * and its own format, configured with logSetSinkFormat(). A new sink outputs
+ * all messages in the text format.
+ *
+ * Messages are filtered by the log level of their category first, see
+ * logSetLevel(). Sink severity filters can only restrict the messages output
+ * to a sink further.
+ *
+ * Messages are formatted at most once for all sinks that share the same
+ * format. Sinks can be added and removed at any time, concurrently with
+ * logging, without locking the logging threads.
+ *
+ * \return The sink identifier on success, or a negative error code otherwise
+ */
+int logAddFileSink(const char *path, bool color)
+{
+    return Logger::instance()->logAddSink(std::make_shared<LogOutput>(path, color));
+}
+
+/**
+ * \brief Add a log sink writing to a stream
+ * \param[in] stream Stream to send log output to
+ * \param[in] color True to output colored messages
+ *
+ * The \a stream shall remain valid until the sink is removed. See
+ * logAddFileSink() for more information about log sinks.
+ *
+ * \return The sink identifier on success, or a negative error code otherwise
+ */
+int logAddStreamSink(std::ostream *stream, bool color)
+{
+    return Logger::instance()->logAddSink(std::make_shared<LogOutput>(stream, color));
+}
+
+/**
+ * \brief Add a log sink writing to syslog
+ *
+ * See logAddFileSink() for more information about log sinks.
+ *
+ * \return The sink identifier on success, or a negative error code otherwise
+ */
+int logAddSyslogSink()
+{
+    return Logger::instance()->logAddSink(std::make_shared<LogOutput>());
+}
+
+/**
+ * \brief Add a log sink writing to the systemd journal
+ * \param[in] path The path to the journal socket (optional)
+ *
+ * Messages are sent to the journal with the journald native protocol, as
+ * entries with the MESSAGE, PRIORITY, CATEGORY, CODE_FILE, CODE_LINE, TID and
+ * SYSLOG_IDENTIFIER fields, the message prefix in the PREFIX field if any, and
+ * the message structured fields. The sink always uses this format, regardless
+ * of the log format.
+ *
+ * The journal socket is non-blocking. Messages that can't be sent immediately
+ * are dropped and counted, and the number of dropped messages is reported to
+ * the journal later. With asynchronous logging, batches of messages are sent
+ * with a single system call.
+ *
+ * Messages are sent to the journald socket by default. The \a path parameter
+ * allows sending them to a different datagram socket, for instance for
+ * testing purpose.
+ *
+ * See logAddFileSink() for more information about log sinks.
+ *
+ * \return The sink identifier on success, or a negative error code otherwise
+ */
+int logAddJournalSink(const char *path)
+{
+    return Logger::instance()->logAddSink(std::make_shared<LogOutput>(LoggingTargetJournal, path));
+}
+
+/**
+ * \brief Add a log sink writing to an in-memory flight recorder
+ * \param[in] size The flight recorder size in bytes
+ * \param[in] path The path to a file backing the flight recorder (optional)
+ *
+ * See logSetFlightRecorder() for more information about the flight recorder,
+ * and logAddFileSink() for more information about log sinks.
+ *
+ * \return The sink identifier on success, or a negative error code otherwise
+ */
+int logAddFlightRecorderSink(size_t size, const char *path)
+{
+    if (!size)
+        return -EINVAL;
+
+    return Logger::instance()->logAddSink(std::make_shared<LogOutput>(size, path));
+}
+
+/**
+ * \brief Remove a log sink
+ * \param[in] sink The sink identifier
+ *
+ * The sink output is closed when the logging threads that may be writing to
+ * it complete their write. Sink 0 identifies the primary log output.
  *
- * \return Zero on success, or a negative error code otherwise
+ * \return Zero on success, or -ENOENT if the sink doesn't exist
  */
-int logSetFile(const char *path, bool color)
+int logRemoveSink(int sink)
 {
-    return Logger::instance()->logSetFile(path, color);
+    return Logger::instance()->logRemoveSink(sink);
 }
 
 /**
- * \brief Direct logging to a stream
- * \param[in] stream Stream to send log output to
- * \param[in] color True to output colored messages
+ * \brief Set the severity filter of a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] category The category pattern, or "*" for all categories
+ * \param[in] level The log level
  *
- * This function directs the log output to \a stream. The previous log target,
- * if any, is closed, and all new log messages will be written to the new log
- * stream.
+ * This function sets the minimum severity of messages output to \a sink. When
+ * \a category is "*", the level applies to all categories without a specific
+ * level. Otherwise it applies to the categories matching the \a category
+ * pattern, where a '*' matches all the remaining characters. Patterns are
+ * matched in the order they have been set. The \a level uses the syntax of
+ * logSetLevel(). Sink 0 identifies the primary log output.
  *
- * \a color controls whether or not the messages will be colored with standard
- * ANSI escape codes. This is done regardless of whether \a stream refers to a
- * standard file or a TTY, the caller is responsible for disabling coloring when
- * not suitable for the log target.
+ * Fatal messages are output to all sinks regardless of their severity filter.
  *
- * If the function returns an error, the log file is not changed
+ * \return Zero on success, -EINVAL if the level is invalid, or -ENOENT if the
+ * sink doesn't exist
+ */
+int logSetSinkLevel(int sink, const char *category, const char *level)
+{
+    return Logger::instance()->logSetSinkLevel(sink, category, level);
+}
+
+/**
+ * \brief Set the format of a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] format The log format
  *
- * \return Zero on success, or a negative error code otherwise.
+ * Sink 0 identifies the primary log output.
+ *
+ * \return Zero on success, -EINVAL if the format is invalid, or -ENOENT if the
+ * sink doesn't exist
  */
-int logSetStream(std::ostream *stream, bool color)
+int logSetSinkFormat(int sink, LoggingFormat format)
 {
-    return Logger::instance()->logSetStream(stream, color);
+    return Logger::instance()->logSetSinkFormat(sink, format);
 }
 
 /**
- * \brief Set the logging target
- * \param[in] target Logging destination
+ * \brief Rotate the log file of a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] maxSize The size in bytes above which the file is rotated, or 0
+ * to disable size-based rotation
+ * \param[in] count The number of rotated files to keep
+ * \param[in] interval The rotation interval, or 0 to disable time-based
+ * rotation
+ * \param[in] compress True to compress the rotated files with gzip
  *
- * This function sets the logging output to the target specified by \a target.
- * The allowed values of \a target are LoggingTargetNone and
- * LoggingTargetSyslog. LoggingTargetNone will send the log output to nowhere,
- * and LoggingTargetSyslog will send the log output to syslog. The previous
- * log target, if any, is closed, and all new log messages will be written to
- * the new log destination.
+ * This function enables rotation of the log file written by \a sink, which
+ * must be a file sink. When the file grows beyond \a maxSize bytes, or when
+ * \a interval has elapsed since the last rotation and the file isn't empty, the
+ * file is renamed with a ".1" suffix, previously rotated files are renamed
+ * with an incremented suffix, and logging continues in a new file. At most
+ * \a count rotated files are kept, the oldest being deleted. If \a compress is
+ * true, rotated files are compressed to "<name>.gz" by running gzip.
  *
- * LoggingTargetFile and LoggingTargetStream are not valid values for \a target.
- * Use logSetFile() and logSetStream() instead, respectively.
+ * Rotation is performed by a background thread. Logging threads are never
+ * blocked by a rotation, messages logged while the files are being rotated
+ * are written to the previous file. Unlike external rotation by copy and
+ * truncation, no message is lost. As the log file is written in append mode,
+ * the maximum size may be exceeded by the messages written concurrently with
+ * the rotation.
  *
- * If the function returns an error, the log file is not changed.
+ * Sink 0 identifies the primary log output.
  *
- * \return Zero on success, or a negative error code otherwise.
+ * \return Zero on success, -EINVAL if the sink doesn't log to a file, -ENOENT
+ * if the sink doesn't exist, or another negative error code if the log file
+ * can't be reopened
  */
-int logSetTarget(LoggingTarget target)
+int logSetSinkRotation(int sink, size_t maxSize, unsigned int count,
+                       std::chrono::seconds interval, bool compress)
 {
-    return Logger::instance()->logSetTarget(target);
+    return Logger::instance()->logSetSinkRotation(sink, maxSize, count,
+                                                  interval, compress);
+}
+
+/**
+ * \brief Write the flight recorder contents to a file descriptor
+ * \param[in] fd The file descriptor
+ *
+ * This function writes the messages stored in the flight recorder to \a fd,
+ * from the oldest to the most recent. It is async-signal-safe, and can be
+ * called from a crash signal handler.
+ *
+ * \return Zero on success, -ENOENT if no flight recorder is active, or another
+ * negative error code otherwise
+ */
+int logDumpFlightRecorder(int fd)
+{
+    return FlightRecorder::dumpActive(fd);
+}
+
+/**
+ * \brief Convert a file-backed flight recorder to text
+ * \param[in] input The input stream for the flight recorder file
+ * \param[in] output The output stream for the messages
+ *
+ * This function reads a flight recorder file created by logSetFlightRecorder()
+ * and writes the recorded messages to \a output, from the oldest to the most
+ * recent.
+ *
+ * \return Zero on success, or -EINVAL if the input is not a valid flight
+ * recorder file
+ */
+int logDecodeFlightRecorder(std::istream &input, std::ostream &output)
+{
+    std::vector<char> data{ std::istreambuf_iterator<char>(input),
+                            std::istreambuf_iterator<char>() };
+
+    /* Magic, size and position, as stored in FlightRecorder::Header. */
+    constexpr size_t headerSize = sizeof(kFlightRecorderMagic) + 2 * sizeof(uint64_t);
+    if (data.size() < headerSize ||
+        memcmp(data.data(), kFlightRecorderMagic, sizeof(kFlightRecorderMagic)))
+        return -EINVAL;
+
+    uint64_t size;
+    uint64_t position;
+    memcpy(&size, data.data() + sizeof(kFlightRecorderMagic), sizeof(size));
+    memcpy(&position, data.data() + sizeof(kFlightRecorderMagic) + sizeof(size),
+           sizeof(position));
+
+    if (!size || data.size() - headerSize < size)
+        return -EINVAL;
+
+    flightRecorderChunks(data.data() + headerSize, size, position,
+                         [&](const char *chunk, size_t len) {
+                             output.write(chunk, len);
+                         });
+
+    return 0;
+}
+
+/**
+ * \brief Install or remove the crash handler
+ * \param[in] fd The file descriptor to write crash reports to, or -1 to remove
+ * the crash handler
+ *
+ * This function installs a handler for the SIGSEGV, SIGBUS, SIGILL, SIGFPE and
+ * SIGABRT signals. When the process crashes, the handler writes a crash report
+ * to \a fd. The signal is then delivered to the handler installed previously,
+ * if any, or terminates the process with the original signal. The report
+ * contains the raw instruction pointers of the call stack of the crashing
+ * thread, the memory mappings of the process, and the log messages not
+ * written yet, from the flight recorder and from the asynchronous log queue.
+ *
+ * The crash handler performs async-signal-safe operations only. In particular
+ * it doesn't resolve symbols, which is deferred to logDecodeCrashReport(). The
+ * call stack is captured with Backtrace::capture(), and is only available when
+ * a backtrace backend is compiled in.
+ * The file descriptor \a fd is opened by the caller beforehand, for instance
+ * on a file or on stderr, and is duplicated by this function.
+ *
+ * An alternate signal stack is set up for the calling thread, to report stack
+ * overflows in that thread. Alternate signal stacks are per-thread, stack
+ * overflows in other threads are not reported.
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int logSetCrashHandler(int fd)
+{
+    if (fd < 0) {
+        CrashHandler::uninstall();
+        return 0;
+    }
+
+    return CrashHandler::install(fd);
+}
+
+/**
+ * \brief Convert a crash report to a readable form
+ * \param[in] input The input stream for the crash report
+ * \param[in] output The output stream for the decoded report
+ *
+ * This function reads a crash report written by the crash handler installed
+ * with logSetCrashHandler(), and resolves the raw instruction pointers to the
+ * module they belong to and their offset in the module file, using the memory
+ * mappings recorded in the report. The module and offset can be passed to
+ * tools such as addr2line to retrieve the function and source line. Except
+ * for the innermost frame, the addresses are return addresses, and point
+ * after the call instruction.
+ *
+ * \return Zero on success, or -EINVAL if the input is not a crash report
+ */
+int logDecodeCrashReport(std::istream &input, std::ostream &output)
+{
+    struct Mapping {
+        uintptr_t start;
+        uintptr_t end;
+        uintptr_t offset;
+        std::string path;
+    };
+
+    std::vector<std::string> lines;
+    std::string line;
+
+    if (!std::getline(input, line) ||
+        line.compare(0, strlen(kCrashReportHeader), kCrashReportHeader))
+        return -EINVAL;
+
+    lines.push_back(line);
+    while (std::getline(input, line))
+        lines.push_back(line);
+
+    auto maps = std::find(lines.begin(), lines.end(), "Maps:");
+    auto log = std::find(maps, lines.end(), "Log:");
+
+    /* Parse "start-end perms offset dev inode path" lines. */
+    std::vector<Mapping> mappings;
+    for (auto it = maps == lines.end() ? maps : maps + 1; it != log; ++it) {
+        std::istringstream entry(*it);
+        Mapping mapping;
+        std::string perms, dev, inode;
+        char dash;
+
+        entry >> std::hex >> mapping.start >> dash >> mapping.end >> perms
+              >> mapping.offset >> dev >> inode;
+        if (!entry)
+            continue;
+
+        std::getline(entry >> std::ws, mapping.path);
+        if (!mapping.path.empty())
+            mappings.push_back(std::move(mapping));
+    }
+
+    auto resolve = [&](const std::string &str) {
+        size_t pos = str.rfind(' ');
+        if (pos == std::string::npos)
+            return str;
+
+        uintptr_t address = strtoull(str.c_str() + pos + 1, nullptr, 16);
+        for (const Mapping &mapping : mappings) {
+            if (address < mapping.start || address >= mapping.end)
+                continue;
+
+            std::ostringstream entry;
+            entry << str << " " << mapping.path << "+0x" << std::hex
+                  << address - mapping.start + mapping.offset;
+            return entry.str();
+        }
+
+        return str;
+    };
+
+    for (auto it = lines.begin(); it != maps; ++it) {
+        if (!it->compare(0, 1, "#") || !it->compare(0, 3, "pc "))
+            output << resolve(*it) << std::endl;
+        else
+            output << *it << std::endl;
+    }
+
+    for (auto it = log; it != lines.end(); ++it)
+        output << *it << std::endl;
+
+    return 0;
 }
 
 /**
@@ -442,6 +3315,11 @@ void logSetLevel(const char *category, const char *level)
 
 Logger::~Logger()
 {
+    logSetCollapseRepeated(false);
+
+    /* Write all pending messages before stopping the writer thread. */
+    std::atomic_store(&writer_, std::shared_ptr<AsyncLogWriter>());
+
     destroyed_ = true;
 
     for (LogCategory *category : categories_)
@@ -467,39 +3345,170 @@ Logger *Logger::instance()
 }
 
 /**
- * \brief Write a message to the configured logger output
+ * \brief Write a message to the configured log sinks
  * \param[in] msg The message object
+ *
+ * The message is formatted at most once per distinct format, in buffers local
+ * to the calling thread, and the formatted message is written to all sinks
+ * that accept it. The sink list is accessed without locking.
  */
 void Logger::write(const LogMessage &msg)
 {
-    std::shared_ptr<LogOutput> output = std::atomic_load(&output_);
-    if (!output)
+    std::shared_ptr<const LogSinkList> sinks = std::atomic_load(&sinks_);
+    if (!sinks || sinks->empty())
+        return;
+
+    if (collapse_.load(std::memory_order_relaxed) && collapseRepeated(msg))
         return;
 
-    output->write(msg);
+    /*
+	 * Fatal messages are followed by a backtrace and program abort. Write
+	 * all pending messages and output the fatal message synchronously.
+	 */
+    std::shared_ptr<AsyncLogWriter> writer = asyncWriter();
+    if (writer && msg.severity() == LogFatal) {
+        writer->flush();
+        writer.reset();
+    }
+
+    thread_local std::vector<LogLineBuffer> buffers;
+    thread_local std::vector<std::pair<unsigned int, std::string_view>> formatted;
+
+    if (buffers.size() < sinks->size())
+        buffers.resize(sinks->size());
+    formatted.clear();
+
+    for (const LogSink &sink : *sinks) {
+        if (!sink.accepts(msg.category(), msg.severity()))
+            continue;
+
+        unsigned int key = sink.output->formatKey();
+        std::string_view line;
+
+        auto it = std::find_if(formatted.begin(), formatted.end(),
+                               [key](const auto &f) { return f.first == key; });
+        if (it != formatted.end()) {
+            line = it->second;
+        } else {
+            line = sink.output->format(msg, buffers[formatted.size()]);
+            formatted.push_back({ key, line });
+        }
+
+        /*
+		 * The flight recorder doesn't perform any I/O, and is written
+		 * synchronously to ensure it is up to date when dumped.
+		 */
+        if (!writer || sink.output->target() == LoggingTargetFlightRecorder)
+            sink.output->write(msg.severity(), line);
+        else
+            writer->push({ sink.output, msg.severity(), std::string(line) });
+    }
+}
+
+/**
+ * \brief Check if a message repeats the previous message
+ * \param[in] msg The message
+ *
+ * If \a msg is identical to the previous message, account for it in the repeat
+ * count. Otherwise write the repeat count of the previous message, if any, and
+ * record \a msg as the new reference message.
+ *
+ * \return True if the message is a repeat and shall not be output, false
+ * otherwise
+ */
+bool Logger::collapseRepeated(const LogMessage &msg)
+{
+    MutexLocker locker(repeatMutex_);
+
+    if (msg.severity() != LogFatal && msg.fields().empty() &&
+        &msg.category() == lastCategory_ &&
+        msg.severity() == lastSeverity_ && msg.fileName() == lastFileName_ &&
+        msg.line() == lastLine_ && msg.prefix() == lastPrefix_ &&
+        msg.msgView() == lastMsg_) {
+        repeated_++;
+        return true;
+    }
+
+    writeRepeated();
+
+    lastCategory_ = &msg.category();
+    lastSeverity_ = msg.severity();
+    lastFileName_ = msg.fileName();
+    lastLine_ = msg.line();
+    lastPrefix_ = msg.prefix();
+    lastMsg_ = msg.msgView();
+
+    return false;
 }
 
 /**
- * \brief Write a backtrace to the log
+ * \brief Write the repeat count of the previous message
+ *
+ * The caller shall hold the repeatMutex_ lock.
  */
-void Logger::backtrace()
+void Logger::writeRepeated()
 {
-    std::shared_ptr<LogOutput> output = std::atomic_load(&output_);
-    if (!output)
+    if (!repeated_)
         return;
 
-    /*
-	 * Skip the first two entries that correspond to this function and
-	 * ~LogMessage().
-	 */
-    std::string backtrace = Backtrace().toString(2);
-    if (backtrace.empty()) {
-        output->write("Backtrace not available\n");
+    std::string str = "last message repeated " + std::to_string(repeated_) +
+                      " times\n";
+    repeated_ = 0;
+
+    std::shared_ptr<const LogSinkList> sinks = std::atomic_load(&sinks_);
+    if (!sinks)
         return;
+
+    for (const LogSink &sink : *sinks) {
+        if (sink.accepts(*lastCategory_, lastSeverity_))
+            writeString(sink, str);
+    }
+}
+
+/**
+ * \brief Write a string to a log sink
+ * \param[in] sink The log sink
+ * \param[in] str The string
+ *
+ * The string is queued to the asynchronous writer if enabled, to preserve the
+ * ordering with the messages previously written to the sink.
+ */
+void Logger::writeString(const LogSink &sink, const std::string &str)
+{
+    std::shared_ptr<AsyncLogWriter> writer = asyncWriter();
+    if (writer && sink.output->target() != LoggingTargetFlightRecorder)
+        writer->push({ sink.output, LogDebug, sink.output->formatString(str) });
+    else
+        sink.output->write(str);
+}
+
+/*
+ * Retrieve the asynchronous writer, waiting for a concurrent switch of writers
+ * to complete if no writer is published.
+ */
+std::shared_ptr<AsyncLogWriter> Logger::asyncWriter()
+{
+    std::shared_ptr<AsyncLogWriter> writer = std::atomic_load(&writer_);
+    if (writer || !switching_.load(std::memory_order_acquire))
+        return writer;
+
+    MutexLocker locker(asyncMutex_);
+    return std::atomic_load(&writer_);
+}
+
+/**
+ * \brief Write all pending asynchronous log messages
+ */
+void Logger::flush()
+{
+    if (collapse_.load(std::memory_order_relaxed)) {
+        MutexLocker locker(repeatMutex_);
+        writeRepeated();
     }
 
-    output->write("Backtrace:\n");
-    output->write(backtrace);
+    std::shared_ptr<AsyncLogWriter> writer = asyncWriter();
+    if (writer)
+        writer->flush();
 }
 
 /**
@@ -518,25 +3527,222 @@ int Logger::logSetFile(const char *path, bool color)
     if (!output->isValid())
         return -EINVAL;
 
-    std::atomic_store(&output_, output);
-    return 0;
+    setOutput(output);
+    return 0;
+}
+
+/**
+ * \brief Set the log stream
+ * \param[in] stream Stream to send log output to
+ * \param[in] color True to output colored messages
+ *
+ * \sa libcamera::logSetStream()
+ *
+ * \return Zero on success, or a negative error code otherwise.
+ */
+int Logger::logSetStream(std::ostream *stream, bool color)
+{
+    std::shared_ptr<LogOutput> output =
+            std::make_shared<LogOutput>(stream, color);
+    setOutput(output);
+    return 0;
+}
+
+/**
+ * \brief Set the log flight recorder
+ * \param[in] size The ring buffer size in bytes
+ * \param[in] path The path to the file backing the ring buffer, or nullptr
+ *
+ * \sa zeus::logSetFlightRecorder()
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int Logger::logSetFlightRecorder(size_t size, const char *path)
+{
+    if (!size)
+        return -EINVAL;
+
+    std::shared_ptr<LogOutput> output =
+            std::make_shared<LogOutput>(size, path);
+    if (!output->isValid())
+        return -EINVAL;
+
+    setOutput(output);
+    return 0;
+}
+
+/**
+ * \brief Install a new output for the primary sink
+ * \param[in] output The log output, or nullptr to remove the primary sink
+ *
+ * The output is configured with the current log format before replacing the
+ * output of the primary sink. The severity filter of the primary sink is
+ * preserved.
+ */
+void Logger::setOutput(std::shared_ptr<LogOutput> output)
+{
+    if (output)
+        output->setFormat(format_.load(std::memory_order_relaxed));
+
+    MutexLocker locker(sinksMutex_);
+
+    std::shared_ptr<const LogSinkList> sinks = std::atomic_load(&sinks_);
+    auto list = std::make_shared<LogSinkList>(sinks ? *sinks : LogSinkList());
+    auto it = std::find_if(list->begin(), list->end(),
+                           [](const LogSink &sink) { return sink.id == 0; });
+
+    if (!output) {
+        if (it != list->end())
+            list->erase(it);
+    } else if (it != list->end()) {
+        it->output = std::move(output);
+    } else {
+        list->insert(list->begin(), { 0, std::move(output), LogDebug, {} });
+    }
+
+    std::atomic_store(&sinks_, std::shared_ptr<const LogSinkList>(std::move(list)));
+}
+
+/**
+ * \brief Modify a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] func The function that modifies the sink list
+ *
+ * Copy the sink list, call \a func with the copy and an iterator to \a sink,
+ * and publish the modified list. Logging threads keep using the previous list
+ * until they complete their write.
+ *
+ * \return Zero on success, -ENOENT if the sink doesn't exist
+ */
+template<typename Func>
+int Logger::updateSink(int sink, Func &&func)
+{
+    MutexLocker locker(sinksMutex_);
+
+    std::shared_ptr<const LogSinkList> sinks = std::atomic_load(&sinks_);
+    auto list = std::make_shared<LogSinkList>(sinks ? *sinks : LogSinkList());
+    auto it = std::find_if(list->begin(), list->end(),
+                           [sink](const LogSink &s) { return s.id == sink; });
+    if (it == list->end())
+        return -ENOENT;
+
+    func(*list, it);
+
+    std::atomic_store(&sinks_, std::shared_ptr<const LogSinkList>(std::move(list)));
+    return 0;
+}
+
+/**
+ * \brief Add a log sink
+ * \param[in] output The sink log output
+ *
+ * \return The sink identifier on success, or a negative error code otherwise
+ */
+int Logger::logAddSink(std::shared_ptr<LogOutput> output)
+{
+    if (!output->isValid())
+        return -EINVAL;
+
+    MutexLocker locker(sinksMutex_);
+
+    std::shared_ptr<const LogSinkList> sinks = std::atomic_load(&sinks_);
+    auto list = std::make_shared<LogSinkList>(sinks ? *sinks : LogSinkList());
+    int id = nextSinkId_++;
+
+    list->push_back({ id, std::move(output), LogDebug, {} });
+
+    std::atomic_store(&sinks_, std::shared_ptr<const LogSinkList>(std::move(list)));
+    return id;
+}
+
+/**
+ * \brief Remove a log sink
+ * \param[in] sink The sink identifier
+ *
+ * \sa zeus::logRemoveSink()
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int Logger::logRemoveSink(int sink)
+{
+    return updateSink(sink, [](LogSinkList &list, LogSinkList::iterator it) {
+        list.erase(it);
+    });
+}
+
+/**
+ * \brief Set the severity filter of a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] category The category pattern, or "*" for all categories
+ * \param[in] level The log level
+ *
+ * \sa zeus::logSetSinkLevel()
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int Logger::logSetSinkLevel(int sink, const char *category, const char *level)
+{
+    LogSeverity severity = parseLogLevel(level);
+    if (severity == LogInvalid)
+        return -EINVAL;
+
+    std::string pattern = category;
+
+    return updateSink(sink, [&](LogSinkList &, LogSinkList::iterator it) {
+        if (pattern == "*") {
+            it->severity = severity;
+            return;
+        }
+
+        auto level = std::find_if(it->levels.begin(), it->levels.end(),
+                                  [&](const auto &l) { return l.first == pattern; });
+        if (level != it->levels.end())
+            level->second = severity;
+        else
+            it->levels.push_back({ pattern, severity });
+    });
+}
+
+/**
+ * \brief Set the format of a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] format The log format
+ *
+ * \sa zeus::logSetSinkFormat()
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int Logger::logSetSinkFormat(int sink, LoggingFormat format)
+{
+    if (!log_format_valid(format))
+        return -EINVAL;
+
+    return updateSink(sink, [&](LogSinkList &, LogSinkList::iterator it) {
+        it->output->setFormat(format);
+    });
 }
 
 /**
- * \brief Set the log stream
- * \param[in] stream Stream to send log output to
- * \param[in] color True to output colored messages
+ * \brief Rotate the log file of a log sink
+ * \param[in] sink The sink identifier
+ * \param[in] maxSize The size above which the file is rotated
+ * \param[in] count The number of rotated files to keep
+ * \param[in] interval The rotation interval
+ * \param[in] compress True to compress the rotated files
  *
- * \sa libcamera::logSetStream()
+ * \sa zeus::logSetSinkRotation()
  *
- * \return Zero on success, or a negative error code otherwise.
+ * \return Zero on success, or a negative error code otherwise
  */
-int Logger::logSetStream(std::ostream *stream, bool color)
+int Logger::logSetSinkRotation(int sink, size_t maxSize, unsigned int count,
+                               std::chrono::seconds interval, bool compress)
 {
-    std::shared_ptr<LogOutput> output =
-            std::make_shared<LogOutput>(stream, color);
-    std::atomic_store(&output_, output);
-    return 0;
+    int ret = 0;
+    int err = updateSink(sink, [&](LogSinkList &, LogSinkList::iterator it) {
+        ret = it->output->setRotation(maxSize, count, interval, compress);
+    });
+
+    return err ? err : ret;
 }
 
 /**
@@ -551,10 +3757,18 @@ int Logger::logSetTarget(enum LoggingTarget target)
 {
     switch (target) {
     case LoggingTargetSyslog:
-        std::atomic_store(&output_, std::make_shared<LogOutput>());
+        setOutput(std::make_shared<LogOutput>());
         break;
+    case LoggingTargetJournal: {
+        auto output = std::make_shared<LogOutput>(LoggingTargetJournal, nullptr);
+        if (!output->isValid())
+            return -EINVAL;
+
+        setOutput(output);
+        break;
+    }
     case LoggingTargetNone:
-        std::atomic_store(&output_, std::shared_ptr<LogOutput>());
+        setOutput(nullptr);
         break;
     default:
         return -EINVAL;
@@ -563,6 +3777,26 @@ int Logger::logSetTarget(enum LoggingTarget target)
     return 0;
 }
 
+/**
+ * \brief Set the log format
+ * \param[in] format The log format
+ *
+ * \sa zeus::logSetFormat()
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int Logger::logSetFormat(LoggingFormat format)
+{
+    if (!log_format_valid(format))
+        return -EINVAL;
+
+    format_.store(format, std::memory_order_relaxed);
+
+    /* The primary sink may not exist, ignore the error. */
+    logSetSinkFormat(0, format);
+    return 0;
+}
+
 /**
  * \brief Set the log level
  * \param[in] category Logging category
@@ -584,6 +3818,66 @@ void Logger::logSetLevel(const char *category, const char *level)
     }
 }
 
+/**
+ * \brief Enable or disable asynchronous logging
+ * \param[in] enable True to enable asynchronous logging, false to disable it
+ * \param[in] policy The policy applied when the log buffer is full
+ * \param[in] capacity The number of messages the log buffer can hold
+ *
+ * \sa zeus::logSetAsync()
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int Logger::logSetAsync(bool enable, LoggingOverflowPolicy policy,
+                        unsigned int capacity)
+{
+    if (enable && !capacity)
+        return -EINVAL;
+
+    MutexLocker locker(asyncMutex_);
+
+    /*
+	 * Retire the previous writer before publishing the new one, for all
+	 * the messages it has queued to be written first. It is destroyed
+	 * when the last logging thread releases its reference, after writing
+	 * all pending messages. Logging threads that find no writer in the
+	 * meantime wait for the switch to complete in asyncWriter(), instead
+	 * of writing to the outputs concurrently with the previous writer.
+	 */
+    switching_.store(true, std::memory_order_release);
+
+    std::shared_ptr<AsyncLogWriter> previous =
+            std::atomic_exchange(&writer_, std::shared_ptr<AsyncLogWriter>());
+    if (previous) {
+        previous->notifyRetired(&writerRetired_);
+        previous.reset();
+        writerRetired_.acquire();
+    }
+
+    if (enable)
+        std::atomic_store(&writer_, std::make_shared<AsyncLogWriter>(policy, capacity));
+
+    switching_.store(false, std::memory_order_release);
+    return 0;
+}
+
+/**
+ * \brief Enable or disable collapsing of repeated log messages
+ * \param[in] enable True to collapse repeated messages, false otherwise
+ *
+ * \sa zeus::logSetCollapseRepeated()
+ */
+void Logger::logSetCollapseRepeated(bool enable)
+{
+    MutexLocker locker(repeatMutex_);
+
+    collapse_.store(enable, std::memory_order_relaxed);
+
+    writeRepeated();
+    lastCategory_ = nullptr;
+    lastMsg_.clear();
+}
+
 /**
  * \brief Construct a logger
  *
@@ -592,12 +3886,18 @@ void Logger::logSetLevel(const char *category, const char *level)
  * ZEUS_LOG_NO_COLOR environment variable to disable coloring.
  */
 Logger::Logger()
+        : nextSinkId_(1), format_(LoggingFormatText), switching_(false),
+          collapse_(false),
+          lastCategory_(nullptr), lastSeverity_(LogInvalid),
+          lastFileName_(nullptr), lastLine_(0), repeated_(0)
 {
     bool color = !utils::secure_getenv("ZEUS_LOG_NO_COLOR");
     logSetStream(&std::cerr, color);
 
     parseLogFile();
+    parseLogFormat();
     parseLogLevels();
+    parseLogAsync();
 }
 
 /**
@@ -605,9 +3905,9 @@ Logger::Logger()
  *
  * If the ZEUS_LOG_FILE environment variable is set, open the file it
  * points to and redirect the logger output to it. If the environment variable
- * is set to "syslog", then the logger output will be directed to syslog. Errors
- * are silently ignored and don't affect the logger output (set to std::cerr by
- * default).
+ * is set to "syslog", then the logger output will be directed to syslog, and
+ * if it is set to "journal", to the systemd journal. Errors are silently
+ * ignored and don't affect the logger output (set to std::cerr by default).
  */
 void Logger::parseLogFile()
 {
@@ -620,9 +3920,53 @@ void Logger::parseLogFile()
         return;
     }
 
+    if (!strcmp(file, "journal")) {
+        logSetTarget(LoggingTargetJournal);
+        return;
+    }
+
     logSetFile(file, false);
 }
 
+/**
+ * \brief Parse the log format from the environment
+ *
+ * If the ZEUS_LOG_FORMAT environment variable is set to "json", "logfmt" or
+ * "journal", select the corresponding log format. Other values are ignored.
+ */
+void Logger::parseLogFormat()
+{
+    const char *format = utils::secure_getenv("ZEUS_LOG_FORMAT");
+    if (!format)
+        return;
+
+    if (!strcmp(format, "json"))
+        logSetFormat(LoggingFormatJson);
+    else if (!strcmp(format, "logfmt"))
+        logSetFormat(LoggingFormatLogfmt);
+    else if (!strcmp(format, "journal"))
+        logSetFormat(LoggingFormatJournal);
+}
+
+/**
+ * \brief Parse the asynchronous logging mode from the environment
+ *
+ * If the ZEUS_LOG_ASYNC environment variable is set, enable asynchronous
+ * logging. The variable selects the overflow policy, "drop" to drop messages
+ * when the buffer is full, and any other value to block.
+ */
+void Logger::parseLogAsync()
+{
+    const char *async = utils::secure_getenv("ZEUS_LOG_ASYNC");
+    if (!async)
+        return;
+
+    LoggingOverflowPolicy policy = !strcmp(async, "drop")
+                                           ? LoggingOverflowDrop
+                                           : LoggingOverflowBlock;
+    logSetAsync(true, policy, 4096);
+}
+
 /**
  * \brief Parse the log levels from the environment
  *
@@ -830,6 +4174,18 @@ LogCategory::LogCategory(const char *name)
  * \return Return the severity of the log category
  */
 
+/**
+ * \fn LogCategory::isEnabled()
+ * \brief Check if messages of a given severity are output for the category
+ * \param[in] severity The message severity
+ *
+ * This function is used by the LOG() macro to discard messages before they
+ * are constructed. The category severity is read atomically and may be
+ * changed concurrently with setSeverity().
+ *
+ * \return True if messages of \a severity are output, false otherwise
+ */
+
 /**
  * \brief Set the severity of the log category
  *
@@ -838,7 +4194,7 @@ LogCategory::LogCategory(const char *name)
  */
 void LogCategory::setSeverity(LogSeverity severity)
 {
-    severity_ = severity;
+    severity_.store(severity, std::memory_order_relaxed);
 }
 
 /**
@@ -882,7 +4238,8 @@ const LogCategory &LogCategory::defaultCategory()
 LogMessage::LogMessage(const char *fileName, unsigned int line,
                        const LogCategory &category, LogSeverity severity,
                        const std::string &prefix)
-        : category_(category), severity_(severity), prefix_(prefix)
+        : msgStream_(&msgBuffer_), category_(category), severity_(severity),
+          prefix_(prefix)
 {
     init(fileName, line);
 }
@@ -900,9 +4257,13 @@ LogMessage::LogMessage(const char *fileName, unsigned int line,
  * log by setting the severity to LogInvalid.
  */
 LogMessage::LogMessage(LogMessage &&other)
-        : msgStream_(std::move(other.msgStream_)), category_(other.category_),
-          severity_(other.severity_)
+        : msgBuffer_(std::move(other.msgBuffer_)), msgStream_(&msgBuffer_),
+          category_(other.category_), severity_(other.severity_),
+          timestamp_(other.timestamp_), fileName_(other.fileName_),
+          line_(other.line_), prefix_(std::move(other.prefix_)),
+          fields_(std::move(other.fields_))
 {
+    msgStream_.pword(streamIndex()) = this;
     other.severity_ = LogInvalid;
 }
 
@@ -910,10 +4271,21 @@ void LogMessage::init(const char *fileName, unsigned int line)
 {
     /* Log the timestamp, severity and file information. */
     timestamp_ = utils::clock::now();
+    fileName_ = utils::basename(fileName);
+    line_ = line;
+
+    /* Allow LogField insertion to find the message from its stream. */
+    msgStream_.pword(streamIndex()) = this;
+}
 
-    std::ostringstream ossFileInfo;
-    ossFileInfo << utils::basename(fileName) << ":" << line;
-    fileInfo_ = ossFileInfo.str();
+/*
+ * Index of the stream pointer-sized storage that stores the LogMessage the
+ * stream belongs to.
+ */
+int LogMessage::streamIndex()
+{
+    static const int index = std::ios_base::xalloc();
+    return index;
 }
 
 LogMessage::~LogMessage()
@@ -928,11 +4300,19 @@ LogMessage::~LogMessage()
 
     msgStream_ << std::endl;
 
+    /*
+	 * Attach the backtrace to fatal messages, skipping the entry that
+	 * corresponds to this function.
+	 */
+    if (severity_ == LogSeverity::LogFatal)
+        backtrace_ = Backtrace().toString(1);
+
     if (severity_ >= category_.severity())
         logger->write(*this);
 
     if (severity_ == LogSeverity::LogFatal) {
-        logger->backtrace();
+        logDumpFlightRecorder(STDERR_FILENO);
+        logDumpBinary();
         std::abort();
     }
 }
@@ -966,10 +4346,32 @@ LogMessage::~LogMessage()
  */
 
 /**
- * \fn LogMessage::fileInfo()
+ * \fn LogMessage::fileName()
+ * \brief Retrieve the name of the file the message is logged from
+ * \return The file name, without any leading directory components
+ */
+
+/**
+ * \fn LogMessage::line()
+ * \brief Retrieve the line number the message is logged from
+ * \return The line number
+ */
+
+/**
  * \brief Retrieve the file info of the log message
+ *
+ * The file info is formatted as "file:line" on first use. Log outputs format
+ * the file name and line number directly and don't require it.
+ *
  * \return The file info of the message
  */
+const std::string &LogMessage::fileInfo() const
+{
+    if (fileInfo_.empty())
+        fileInfo_ = std::string(fileName_) + ":" + std::to_string(line_);
+
+    return fileInfo_;
+}
 
 /**
  * \fn LogMessage::prefix()
@@ -983,6 +4385,191 @@ LogMessage::~LogMessage()
  * \return The message text of the message, as a string
  */
 
+/**
+ * \fn LogMessage::fields()
+ * \brief Retrieve the structured fields attached to the log message
+ * \return The message fields, in insertion order
+ */
+
+/**
+ * \fn LogMessage::backtrace()
+ * \brief Retrieve the backtrace attached to the log message
+ *
+ * The backtrace is captured for Fatal messages only, when the message is
+ * written. It is output by each log output in its own format.
+ *
+ * \return The backtrace, or an empty string if not available
+ */
+
+/**
+ * \fn LogMessage::msgView()
+ * \brief Retrieve the message text of the log message without copying it
+ *
+ * The returned view is invalidated when data is added to the message stream.
+ *
+ * \return The message text of the message, as a string view
+ */
+
+/**
+ * \class LogField
+ * \brief A typed key/value field attached to a log message
+ *
+ * The LogField class attaches structured data to a log message. Fields are
+ * inserted in the LOG() stream like any other value:
+ *
+ * \code{.cpp}
+ * LOG(Event, Warning) << "poll() failed"
+ *                     << LogField("fd", fd)
+ *                     << LogField("error", strerror(-ret));
+ * \endcode
+ *
+ * The fields are not part of the message text. They are stored in the
+ * LogMessage with their type, and log outputs encode them directly in the
+ * selected LoggingFormat, as JSON members, logfmt pairs or journal fields. As
+ * fields are part of the LOG() stream insertion chain, they are not evaluated
+ * when the message is discarded by the log level.
+ *
+ * The key must be a string that outlives the log message, typically a string
+ * literal. String values are copied. When inserted in a stream that doesn't
+ * belong to a LogMessage, the field is output as "key=value".
+ */
+
+/**
+ * \enum LogField::Type
+ * \brief The field value type
+ * \var LogField::Bool
+ * \brief Boolean value
+ * \var LogField::Int
+ * \brief Signed integer value
+ * \var LogField::UInt
+ * \brief Unsigned integer value
+ * \var LogField::Double
+ * \brief Floating point value
+ * \var LogField::String
+ * \brief String value
+ */
+
+/**
+ * \fn LogField::LogField(const char *key, bool value)
+ * \brief Construct a boolean field
+ * \param[in] key The field key
+ * \param[in] value The field value
+ */
+
+/**
+ * \fn LogField::LogField(const char *key, T value)
+ * \brief Construct an integer field
+ * \param[in] key The field key
+ * \param[in] value The field value
+ */
+
+/**
+ * \fn LogField::LogField(const char *key, double value)
+ * \brief Construct a floating point field
+ * \param[in] key The field key
+ * \param[in] value The field value
+ */
+
+/**
+ * \fn LogField::LogField(const char *key, std::string_view value)
+ * \brief Construct a string field
+ * \param[in] key The field key
+ * \param[in] value The field value
+ */
+
+/**
+ * \fn LogField::LogField(const char *key, const char *value)
+ * \copydoc LogField::LogField(const char *key, std::string_view value)
+ */
+
+/**
+ * \fn LogField::LogField(const char *key, const std::string &value)
+ * \copydoc LogField::LogField(const char *key, std::string_view value)
+ */
+
+/**
+ * \fn LogField::key()
+ * \brief Retrieve the field key
+ * \return The field key
+ */
+
+/**
+ * \fn LogField::type()
+ * \brief Retrieve the field value type
+ * \return The field value type
+ */
+
+/**
+ * \fn LogField::boolValue()
+ * \brief Retrieve the value of a LogField::Bool field
+ * \return The field value
+ */
+
+/**
+ * \fn LogField::intValue()
+ * \brief Retrieve the value of a LogField::Int field
+ * \return The field value
+ */
+
+/**
+ * \fn LogField::uintValue()
+ * \brief Retrieve the value of a LogField::UInt field
+ * \return The field value
+ */
+
+/**
+ * \fn LogField::doubleValue()
+ * \brief Retrieve the value of a LogField::Double field
+ * \return The field value
+ */
+
+/**
+ * \fn LogField::stringValue()
+ * \brief Retrieve the value of a LogField::String field
+ * \return The field value
+ */
+
+/**
+ * \brief Insert a field in a log message stream
+ * \param[in] out The output stream
+ * \param[in] field The field
+ *
+ * If \a out is the stream of a LogMessage, the field is attached to the
+ * message. Otherwise it is output as "key=value".
+ *
+ * \return The output stream \a out
+ */
+std::ostream &operator<<(std::ostream &out, const LogField &field)
+{
+    void *msg = out.pword(LogMessage::streamIndex());
+    if (msg) {
+        static_cast<LogMessage *>(msg)->fields_.push_back(field);
+        return out;
+    }
+
+    out << field.key() << "=";
+
+    switch (field.type()) {
+    case LogField::Bool:
+        out << (field.boolValue() ? "true" : "false");
+        break;
+    case LogField::Int:
+        out << field.intValue();
+        break;
+    case LogField::UInt:
+        out << field.uintValue();
+        break;
+    case LogField::Double:
+        out << field.doubleValue();
+        break;
+    case LogField::String:
+        out << field.stringValue();
+        break;
+    }
+
+    return out;
+}
+
 /**
  * \class Loggable
  * \brief Base class to support log message extensions
@@ -1049,6 +4636,126 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
                       severity);
 }
 
+/**
+ * \class LogRateLimiter
+ * \brief Per call site rate limiter for log messages
+ *
+ * The LogRateLimiter class limits the number of messages output from a single
+ * call site. It backs the LOG_EVERY_N(), LOG_FIRST_N() and LOG_RATE_LIMITED()
+ * macros, which instantiate one static rate limiter per call site, and must
+ * not be used directly.
+ *
+ * The rate limiter state is only accessed with atomic operations, the check
+ * is thus lock-free and can be performed concurrently from multiple threads.
+ */
+
+/**
+ * \enum LogRateLimiter::Policy
+ * \brief The rate limiting policy
+ * \var LogRateLimiter::EveryN
+ * \brief Output one message out of every count messages, starting with the
+ * first one
+ * \var LogRateLimiter::FirstN
+ * \brief Output the first count messages only
+ * \var LogRateLimiter::PerSecond
+ * \brief Output at most count messages per second
+ */
+
+/**
+ * \struct LogRateLimiter::Result
+ * \brief The result of a rate limiter check
+ *
+ * \var LogRateLimiter::Result::allowed
+ * \brief True if the message shall be output, false if it is suppressed
+ *
+ * \var LogRateLimiter::Result::suppressed
+ * \brief The number of messages suppressed since the previous message was
+ * output
+ */
+
+/**
+ * \brief Construct a rate limiter
+ * \param[in] policy The rate limiting policy
+ * \param[in] count The policy parameter
+ */
+LogRateLimiter::LogRateLimiter(Policy policy, unsigned int count)
+        : policy_(policy), count_(count), occurrences_(0), suppressed_(0),
+          windowStart_(0), windowCount_(0)
+{
+}
+
+/**
+ * \brief Check if a message shall be output
+ *
+ * This function accounts for one occurrence of the message and checks it
+ * against the rate limiting policy. It shall be called once per message,
+ * before the message is constructed.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The result of the check, with the number of messages suppressed
+ * since the previous allowed message
+ */
+LogRateLimiter::Result LogRateLimiter::check()
+{
+    bool allowed;
+
+    switch (policy_) {
+    case EveryN:
+        allowed = count_ &&
+                  occurrences_.fetch_add(1, std::memory_order_relaxed) % count_ == 0;
+        break;
+
+    case FirstN:
+        allowed = occurrences_.fetch_add(1, std::memory_order_relaxed) < count_;
+        break;
+
+    case PerSecond:
+    default: {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              utils::clock::now().time_since_epoch())
+                              .count();
+        int64_t start = windowStart_.load(std::memory_order_relaxed);
+
+        /*
+		 * Start a new one second window when the current one expires.
+		 * Only the thread that wins the race resets the counter.
+		 */
+        if ((!start || now - start >= 1000000000) &&
+            windowStart_.compare_exchange_strong(start, now,
+                                                 std::memory_order_relaxed))
+            windowCount_.store(0, std::memory_order_relaxed);
+
+        allowed = windowCount_.fetch_add(1, std::memory_order_relaxed) < count_;
+        break;
+    }
+    }
+
+    if (!allowed) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return { false, 0 };
+    }
+
+    return { true, suppressed_.exchange(0, std::memory_order_relaxed) };
+}
+
+/**
+ * \brief Insert the number of suppressed messages in a log message
+ * \param[in] out The output stream
+ * \param[in] result The rate limiter check result
+ *
+ * Nothing is output if no message has been suppressed.
+ *
+ * \return The output stream \a out
+ */
+std::ostream &operator<<(std::ostream &out, const LogRateLimiter::Result &result)
+{
+    if (result.suppressed)
+        out << "[" << result.suppressed << " suppressed] ";
+
+    return out;
+}
+
 /**
  * \def LOG_DECLARE_CATEGORY(name)
  * \hideinitializer
@@ -1089,6 +4796,13 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
  * absent the default category is used. The  \a severity controls whether the
  * message is printed or discarded, depending on the log level for the category.
  *
+ * The log level is checked before the message is constructed. When the message
+ * is discarded, the expressions passed to the stream are not evaluated, and the
+ * LOG() statement costs a single branch. Expressions with side effects should
+ * thus not be logged. Messages below the compile-time severity floor of their
+ * category are discarded by the compiler when optimizing, see
+ * ZEUS_LOG_MIN_SEVERITY.
+ *
  * If the severity is set to Fatal, execution is aborted and the program
  * terminates immediately after printing the message.
  *
@@ -1099,6 +4813,88 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
  * possible extent
  */
 
+/**
+ * \def ZEUS_LOG_MIN_SEVERITY
+ * \hideinitializer
+ * \brief The compile-time minimum severity of log messages
+ *
+ * Log messages with a severity lower than ZEUS_LOG_MIN_SEVERITY are compiled
+ * out. The LOG() condition folds to a constant, and the stream insertion code
+ * and string literals of the message are discarded by the compiler. Fatal
+ * messages are always compiled in.
+ *
+ * The macro is set to the numerical value of a LogSeverity, from the
+ * ZEUS_LOG_MIN_SEVERITY CMake option that takes a severity name (DEBUG, INFO,
+ * WARN, ERROR or FATAL). It defaults to LogDebug, compiling all messages in.
+ *
+ * The floor can be overridden for individual categories with
+ * ZEUS_LOG_CATEGORY_MIN_SEVERITY.
+ */
+
+/**
+ * \def ZEUS_LOG_CATEGORY_MIN_SEVERITY
+ * \hideinitializer
+ * \brief Per-category overrides of the compile-time minimum severity
+ *
+ * This macro is a string literal that lists categories whose compile-time
+ * minimum severity differs from ZEUS_LOG_MIN_SEVERITY. It uses the syntax of
+ * the ZEUS_LOG_LEVELS environment variable, a comma-separated list of
+ * "category:level" pairs, where a '*' matches all the remaining characters of
+ * the category name. The first matching pair applies. For instance,
+ * "Timer:DEBUG,Event*:ERROR" keeps all messages of the Timer category in a
+ * build configured to compile out Debug messages, and compiles out the
+ * Warning messages of the categories whose name starts with Event.
+ *
+ * The string is evaluated at compile time, and is set from the
+ * ZEUS_LOG_CATEGORY_MIN_SEVERITY CMake option.
+ */
+
+/**
+ * \def LOG_EVERY_N(category, severity, n)
+ * \hideinitializer
+ * \brief Log one message out of every \a n messages
+ * \param[in] category Category
+ * \param[in] severity Severity
+ * \param[in] n The sampling period
+ *
+ * This macro behaves as LOG(), but outputs only the first message and then one
+ * message out of every \a n messages logged from the call site. The number of
+ * messages suppressed since the previous output is prepended to the message.
+ *
+ * The rate limiter state is stored in a static variable, the limit thus
+ * applies to the call site across all threads. The log level is checked first,
+ * disabled messages are not accounted for. Suppressed messages are not
+ * constructed, and the expressions passed to the stream are not evaluated.
+ *
+ * Unlike LOG(), this macro expands to a statement and can't be used as part of
+ * an expression.
+ */
+
+/**
+ * \def LOG_FIRST_N(category, severity, n)
+ * \hideinitializer
+ * \brief Log the first \a n messages only
+ * \param[in] category Category
+ * \param[in] severity Severity
+ * \param[in] n The number of messages to output
+ *
+ * This macro behaves as LOG_EVERY_N(), but outputs the first \a n messages
+ * logged from the call site and suppresses all subsequent messages.
+ */
+
+/**
+ * \def LOG_RATE_LIMITED(category, severity, n)
+ * \hideinitializer
+ * \brief Log at most \a n messages per second
+ * \param[in] category Category
+ * \param[in] severity Severity
+ * \param[in] n The maximum number of messages per second
+ *
+ * This macro behaves as LOG_EVERY_N(), but outputs at most \a n messages per
+ * one second window for the call site. The first message output in a new
+ * window reports the number of messages suppressed in the previous windows.
+ */
+
 /**
  * \def ASSERT(condition)
  * \hideinitializer
@@ -0,0 +1,702 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: log_binary.cpp - Binary deferred-formatting log records
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <unistd.h>
+
+#include <zeus/log_binary.h>
+#include <zeus/mutex.h>
+#include <zeus/thread.h>
+#include <zeus/unique_fd.h>
+#include <zeus/utils.h>
+
+/**
+ * \file log_binary.h
+ * \brief Binary deferred-formatting log records
+ *
+ * Formatting log messages as text is often more expensive than the events
+ * being logged. The binary log format defers formatting to a later, offline
+ * step. Each call site registers a static format descriptor once, containing
+ * the category, severity, file information, format string and argument types.
+ * Each log event then only records the descriptor identifier, a timestamp, the
+ * thread ID and the raw argument bytes in a per-thread buffer.
+ *
+ * Binary log messages are written with the LOG_BINARY() macro to the file set
+ * with logSetBinaryFile(). When no binary log file is set, messages are
+ * formatted as text and output through the regular log infrastructure. The
+ * logDecodeBinary() function, used by the zeus-log-decode tool, converts a
+ * binary log file back to the text format.
+ *
+ * The binary log file starts with an 8 bytes magic value followed by a 32-bit
+ * version number. It then contains a sequence of records, each starting with
+ * a 8-bit record type. Descriptor records always precede the event records
+ * that reference them. All values are stored in native byte order.
+ */
+
+namespace zeus {
+
+namespace {
+
+constexpr char kMagic[8] = { 'Z', 'E', 'U', 'S', 'B', 'L', 'O', 'G' };
+constexpr uint32_t kVersion = 1;
+
+enum RecordType : uint8_t {
+    RecordDescriptor = 1,
+    RecordEvent = 2,
+};
+
+/* Record type, descriptor ID, thread ID, timestamp and payload size. */
+constexpr size_t kEventHeaderSize = 1 + 4 + 4 + 8 + 4;
+
+constexpr size_t kBufferSize = 64 * 1024;
+
+const char *severityName(unsigned int severity)
+{
+    static const char *const names[] = {
+        "DEBUG",
+        " INFO",
+        " WARN",
+        "ERROR",
+        "FATAL",
+    };
+
+    if (severity < std::size(names))
+        return names[severity];
+    else
+        return "UNKWN";
+}
+
+struct Descriptor {
+    std::string category;
+    unsigned int severity;
+    std::string fileName;
+    unsigned int line;
+    std::string format;
+    std::string types;
+};
+
+template<typename T>
+void append(std::vector<uint8_t> &data, const T &value)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+void appendString(std::vector<uint8_t> &data, const std::string &str)
+{
+    append<uint16_t>(data, str.size());
+    data.insert(data.end(), str.begin(), str.end());
+}
+
+/*
+ * Format the payload according to the format string. Each "{}" placeholder is
+ * replaced by the next argument, and "{:x}" formats integer arguments in
+ * hexadecimal.
+ */
+bool formatPayload(std::ostream &out, const std::string &format,
+                   const std::string &types, const uint8_t *data, size_t size)
+{
+    const uint8_t *end = data + size;
+    unsigned int arg = 0;
+
+    for (size_t pos = 0; pos < format.size(); ++pos) {
+        bool hex = !format.compare(pos, 4, "{:x}");
+        if (format.compare(pos, 2, "{}") && !hex) {
+            out << format[pos];
+            continue;
+        }
+
+        pos += hex ? 3 : 1;
+
+        if (arg >= types.size()) {
+            out << "{}";
+            continue;
+        }
+
+        char type = types[arg++];
+
+        if (type == 's') {
+            uint32_t len;
+            if (end - data < static_cast<ptrdiff_t>(sizeof(len)))
+                return false;
+            memcpy(&len, data, sizeof(len));
+            data += sizeof(len);
+
+            if (end - data < static_cast<ptrdiff_t>(len))
+                return false;
+            out.write(reinterpret_cast<const char *>(data), len);
+            data += len;
+            continue;
+        }
+
+        uint64_t raw;
+        if (end - data < static_cast<ptrdiff_t>(sizeof(raw)))
+            return false;
+        memcpy(&raw, data, sizeof(raw));
+        data += sizeof(raw);
+
+        if (type == 'f') {
+            double value;
+            memcpy(&value, &raw, sizeof(value));
+            out << value;
+        } else if (type == 'p' || hex) {
+            out << utils::hex(raw);
+        } else if (type == 'i') {
+            out << static_cast<int64_t>(raw);
+        } else {
+            out << raw;
+        }
+    }
+
+    return true;
+}
+
+/* Write the whole \a data to \a fd. This function is async-signal-safe. */
+void writeAll(int fd, const uint8_t *data, size_t size)
+{
+    while (size) {
+        ssize_t ret = ::write(fd, data, size);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return;
+
+        data += ret;
+        size -= ret;
+    }
+}
+
+/*
+ * The binary log file. Writes of complete buffers are atomic with respect to
+ * each other thanks to O_APPEND.
+ */
+class BinaryFile
+{
+public:
+    BinaryFile(UniqueFD fd)
+            : fd_(std::move(fd))
+    {
+    }
+
+    int fd() const { return fd_.get(); }
+
+    void write(const uint8_t *data, size_t size)
+    {
+        writeAll(fd_.get(), data, size);
+    }
+
+private:
+    UniqueFD fd_;
+};
+
+/*
+ * The registry stores the descriptors of all call sites and the current binary
+ * log file. The generation counter is incremented every time the file changes,
+ * to let per-thread buffers detect the change without locking.
+ */
+class BinaryRegistry
+{
+public:
+    static BinaryRegistry *instance()
+    {
+        static BinaryRegistry registry;
+        return &registry;
+    }
+
+    Mutex mutex_;
+    std::vector<std::vector<uint8_t>> descriptors_;
+    std::shared_ptr<BinaryFile> file_;
+    std::atomic<unsigned int> generation_{ 0 };
+};
+
+/*
+ * Per-thread buffers are linked in a global list and never freed, so that
+ * logDumpBinary() can walk them without locking, from a signal handler or the
+ * fatal log path. The buffer of an exited thread is reused by the next thread
+ * that logs a binary message.
+ *
+ * Only the owner thread writes to a buffer. The committed size covers the
+ * complete records, and is the only part of the buffer that a dump reads.
+ */
+class BinaryBuffer
+{
+public:
+    BinaryBuffer()
+            : next_(nullptr), used_(true), generation_(0), fd_(-1), size_(0),
+              committed_(0)
+    {
+    }
+
+    static BinaryBuffer *acquire();
+    void release();
+
+    uint8_t *reserve(size_t size);
+    void commit();
+    void flush();
+    void dump();
+
+    BinaryBuffer *next() const { return next_; }
+
+private:
+    /* Immutable once the buffer is linked in the list. */
+    BinaryBuffer *next_;
+
+    std::atomic<bool> used_;
+    std::shared_ptr<BinaryFile> file_;
+    unsigned int generation_;
+    std::atomic<int> fd_;
+
+    size_t size_;
+    std::atomic<size_t> committed_;
+    std::vector<uint8_t> large_;
+    uint8_t data_[kBufferSize];
+};
+
+std::atomic<BinaryBuffer *> bufferList{ nullptr };
+
+BinaryBuffer *BinaryBuffer::acquire()
+{
+    for (BinaryBuffer *buffer = bufferList.load(std::memory_order_acquire);
+         buffer; buffer = buffer->next_) {
+        bool used = false;
+        if (buffer->used_.compare_exchange_strong(used, true,
+                                                  std::memory_order_acquire))
+            return buffer;
+    }
+
+    BinaryBuffer *buffer = new BinaryBuffer();
+    buffer->next_ = bufferList.load(std::memory_order_relaxed);
+    while (!bufferList.compare_exchange_weak(buffer->next_, buffer,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed))
+        ;
+
+    return buffer;
+}
+
+void BinaryBuffer::release()
+{
+    flush();
+
+    fd_.store(-1, std::memory_order_release);
+    file_.reset();
+    generation_ = 0;
+
+    used_.store(false, std::memory_order_release);
+}
+
+uint8_t *BinaryBuffer::reserve(size_t size)
+{
+    BinaryRegistry *registry = BinaryRegistry::instance();
+    unsigned int generation = registry->generation_.load(std::memory_order_acquire);
+
+    if (generation != generation_) {
+        flush();
+
+        MutexLocker locker(registry->mutex_);
+        file_ = registry->file_;
+        generation_ = registry->generation_.load(std::memory_order_relaxed);
+        fd_.store(file_ ? file_->fd() : -1, std::memory_order_release);
+    }
+
+    if (!file_)
+        return nullptr;
+
+    if (size_ + size > kBufferSize)
+        flush();
+
+    /* Records larger than the buffer are written directly when committed. */
+    if (size > kBufferSize) {
+        large_.resize(size);
+        return large_.data();
+    }
+
+    uint8_t *data = data_ + size_;
+    size_ += size;
+    return data;
+}
+
+void BinaryBuffer::commit()
+{
+    if (!large_.empty()) {
+        file_->write(large_.data(), large_.size());
+        large_.clear();
+        return;
+    }
+
+    committed_.store(size_, std::memory_order_release);
+}
+
+void BinaryBuffer::flush()
+{
+    size_t size = committed_.load(std::memory_order_relaxed);
+    if (file_ && size)
+        file_->write(data_, size);
+
+    committed_.store(0, std::memory_order_release);
+    size_ = 0;
+}
+
+/* This function is async-signal-safe. */
+void BinaryBuffer::dump()
+{
+    if (!used_.load(std::memory_order_acquire))
+        return;
+
+    int fd = fd_.load(std::memory_order_acquire);
+    size_t size = committed_.load(std::memory_order_acquire);
+    if (fd < 0 || !size)
+        return;
+
+    writeAll(fd, data_, size);
+}
+
+/* Acquire a buffer on first use, and release it when the thread exits. */
+class ThreadBuffer
+{
+public:
+    ~ThreadBuffer()
+    {
+        if (buffer_)
+            buffer_->release();
+    }
+
+    BinaryBuffer *get()
+    {
+        if (!buffer_)
+            buffer_ = BinaryBuffer::acquire();
+        return buffer_;
+    }
+
+    BinaryBuffer *current() const { return buffer_; }
+
+private:
+    BinaryBuffer *buffer_ = nullptr;
+};
+
+thread_local ThreadBuffer threadBuffer;
+
+} /* namespace */
+
+/**
+ * \class LogBinarySite
+ * \brief A call site of the LOG_BINARY() macro
+ *
+ * The LogBinarySite class stores the static information of a binary log call
+ * site. It is instantiated as a static variable by the LOG_BINARY() macro, and
+ * registers its format descriptor the first time a message is logged. This
+ * class shall not be used directly.
+ */
+
+/**
+ * \brief Construct a binary log call site
+ * \param[in] category The log category
+ * \param[in] severity The log severity
+ * \param[in] fileName The file name of the call site
+ * \param[in] line The line number of the call site
+ * \param[in] format The format string
+ */
+LogBinarySite::LogBinarySite(const LogCategory &category, LogSeverity severity,
+                             const char *fileName, unsigned int line,
+                             const char *format)
+        : category_(category), severity_(severity), fileName_(fileName),
+          line_(line), format_(format), id_(0)
+{
+}
+
+/**
+ * \fn LogBinarySite::log()
+ * \brief Log a message with the arguments \a args
+ * \param[in] args The message arguments
+ *
+ * The arguments are encoded in their raw binary form in the calling thread's
+ * buffer. Supported argument types are integers, enumerations, floating point
+ * numbers, strings and pointers.
+ */
+
+uint32_t LogBinarySite::registerSite(const char *types)
+{
+    BinaryRegistry *registry = BinaryRegistry::instance();
+    MutexLocker locker(registry->mutex_);
+
+    /* Another thread may have registered the site concurrently. */
+    uint32_t id = id_.load(std::memory_order_relaxed);
+    if (id)
+        return id;
+
+    id = registry->descriptors_.size() + 1;
+
+    std::vector<uint8_t> descriptor;
+    append<uint8_t>(descriptor, RecordDescriptor);
+    append<uint32_t>(descriptor, id);
+    append<uint8_t>(descriptor, severity_);
+    append<uint32_t>(descriptor, line_);
+    appendString(descriptor, category_.name());
+    appendString(descriptor, utils::basename(fileName_));
+    appendString(descriptor, format_);
+    appendString(descriptor, types);
+
+    if (registry->file_)
+        registry->file_->write(descriptor.data(), descriptor.size());
+
+    registry->descriptors_.push_back(std::move(descriptor));
+    id_.store(id, std::memory_order_release);
+
+    return id;
+}
+
+uint8_t *LogBinarySite::beginRecord(uint32_t id, size_t size)
+{
+    /* Fatal messages must abort, log them as text. */
+    if (severity_ == LogFatal)
+        return nullptr;
+
+    uint8_t *data = threadBuffer.get()->reserve(kEventHeaderSize + size);
+    if (!data)
+        return nullptr;
+
+    uint8_t type = RecordEvent;
+    uint32_t tid = Thread::currentId();
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 utils::clock::now().time_since_epoch())
+                                 .count();
+    uint32_t payloadSize = size;
+
+    memcpy(data, &type, sizeof(type));
+    memcpy(data + 1, &id, sizeof(id));
+    memcpy(data + 5, &tid, sizeof(tid));
+    memcpy(data + 9, &timestamp, sizeof(timestamp));
+    memcpy(data + 17, &payloadSize, sizeof(payloadSize));
+
+    return data + kEventHeaderSize;
+}
+
+void LogBinarySite::endRecord()
+{
+    threadBuffer.current()->commit();
+}
+
+void LogBinarySite::logText(const char *types,
+                            const std::vector<uint8_t> &payload)
+{
+    LogMessage msg(fileName_, line_, category_, severity_);
+    formatPayload(msg.stream(), format_, types, payload.data(), payload.size());
+}
+
+/**
+ * \brief Direct binary log messages to a file
+ * \param[in] path Full path to the binary log file, or nullptr
+ *
+ * This function directs the messages logged with LOG_BINARY() to the file
+ * identified by \a path. The file is truncated if it exists. The descriptors
+ * of all call sites registered so far are written to the file, and all new
+ * binary log messages are written to it.
+ *
+ * Messages are buffered per thread, and the buffers are written to the file
+ * when they are full, when the thread exits, or when logFlushBinary() is called
+ * from the thread. The buffers of all threads are also written by
+ * logDumpBinary(), which is called when a fatal message is logged and by the
+ * crash handler.
+ *
+ * If \a path is nullptr, binary logging is disabled and LOG_BINARY() messages
+ * are formatted as text and output to the regular log.
+ *
+ * \return Zero on success, or a negative error code otherwise
+ */
+int logSetBinaryFile(const char *path)
+{
+    std::shared_ptr<BinaryFile> file;
+
+    if (path) {
+        UniqueFD fd(::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                           0666));
+        if (!fd.isValid())
+            return -errno;
+
+        file = std::make_shared<BinaryFile>(std::move(fd));
+
+        std::vector<uint8_t> header(std::begin(kMagic), std::end(kMagic));
+        append<uint32_t>(header, kVersion);
+        file->write(header.data(), header.size());
+    }
+
+    BinaryRegistry *registry = BinaryRegistry::instance();
+    MutexLocker locker(registry->mutex_);
+
+    if (file) {
+        for (const std::vector<uint8_t> &descriptor : registry->descriptors_)
+            file->write(descriptor.data(), descriptor.size());
+    }
+
+    registry->file_ = file;
+    registry->generation_.fetch_add(1, std::memory_order_release);
+
+    return 0;
+}
+
+/**
+ * \brief Write the calling thread's pending binary log messages
+ */
+void logFlushBinary()
+{
+    BinaryBuffer *buffer = threadBuffer.current();
+    if (buffer)
+        buffer->flush();
+}
+
+/**
+ * \brief Write the pending binary log messages of all threads
+ *
+ * This function writes the messages buffered by all threads to the binary log
+ * file, without locking. It is async-signal-safe, and meant to be called when
+ * the process is about to terminate, from a fatal error path or a signal
+ * handler. The buffers are not cleared.
+ *
+ * Messages being buffered concurrently by other running threads may be missing
+ * from the output or written twice.
+ */
+void logDumpBinary()
+{
+    for (BinaryBuffer *buffer = bufferList.load(std::memory_order_acquire);
+         buffer; buffer = buffer->next())
+        buffer->dump();
+}
+
+/**
+ * \brief Convert a binary log to text
+ * \param[in] input The binary log stream
+ * \param[out] output The text log stream
+ *
+ * This function reads binary log records from \a input and writes them to \a
+ * output in the same text format as the regular log file output, without
+ * colors. Events are output in the order they have been written to the file,
+ * which may differ from the timestamp order when multiple threads log
+ * concurrently.
+ *
+ * \return Zero on success, or -EINVAL if the input isn't a valid binary log
+ */
+int logDecodeBinary(std::istream &input, std::ostream &output)
+{
+    std::vector<uint8_t> data{ std::istreambuf_iterator<char>(input),
+                               std::istreambuf_iterator<char>() };
+    const uint8_t *pos = data.data();
+    const uint8_t *end = pos + data.size();
+
+    auto read = [&](auto *value) {
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(*value)))
+            return false;
+        memcpy(value, pos, sizeof(*value));
+        pos += sizeof(*value);
+        return true;
+    };
+
+    auto readString = [&](std::string *str) {
+        uint16_t len;
+        if (!read(&len) || end - pos < len)
+            return false;
+        str->assign(reinterpret_cast<const char *>(pos), len);
+        pos += len;
+        return true;
+    };
+
+    char magic[sizeof(kMagic)];
+    uint32_t version;
+    if (!read(&magic) || memcmp(magic, kMagic, sizeof(kMagic)) ||
+        !read(&version) || version != kVersion)
+        return -EINVAL;
+
+    std::map<uint32_t, Descriptor> descriptors;
+
+    while (pos < end) {
+        uint8_t type;
+        read(&type);
+
+        if (type == RecordDescriptor) {
+            uint32_t id;
+            uint8_t severity;
+            Descriptor desc;
+
+            if (!read(&id) || !read(&severity) || !read(&desc.line) ||
+                !readString(&desc.category) || !readString(&desc.fileName) ||
+                !readString(&desc.format) || !readString(&desc.types))
+                return -EINVAL;
+
+            desc.severity = severity;
+            descriptors[id] = std::move(desc);
+            continue;
+        }
+
+        if (type != RecordEvent)
+            return -EINVAL;
+
+        uint32_t id;
+        uint32_t tid;
+        uint64_t timestamp;
+        uint32_t size;
+
+        if (!read(&id) || !read(&tid) || !read(&timestamp) || !read(&size) ||
+            end - pos < static_cast<ptrdiff_t>(size))
+            return -EINVAL;
+
+        auto iter = descriptors.find(id);
+        if (iter == descriptors.end())
+            return -EINVAL;
+
+        const Descriptor &desc = iter->second;
+        utils::time_point time{ std::chrono::nanoseconds(timestamp) };
+
+        output << "[" << utils::time_point_to_string(time) << "] ["
+               << tid << "] " << severityName(desc.severity) << " "
+               << desc.category << " " << desc.fileName << ":"
+               << desc.line << " ";
+
+        if (!formatPayload(output, desc.format, desc.types, pos, size))
+            return -EINVAL;
+
+        output << std::endl;
+        pos += size;
+    }
+
+    return 0;
+}
+
+/**
+ * \def LOG_BINARY(category, severity, format, ...)
+ * \hideinitializer
+ * \brief Log a message in binary form
+ * \param[in] category Category
+ * \param[in] severity Severity
+ * \param[in] format Format string
+ *
+ * Log a message with deferred formatting. The \a format string contains "{}"
+ * placeholders that are replaced by the message arguments when the message is
+ * decoded, or "{:x}" for integers formatted in hexadecimal. The \a format
+ * shall be a string literal.
+ *
+ * As for LOG(), the severity is checked before the arguments are evaluated.
+ * Fatal messages are always output as text through the regular log, and abort
+ * execution.
+ */
+
+} /* namespace zeus */
@@ -140,12 +140,16 @@ InvokeMessage::InvokeMessage(BoundMethodBase *method,
                              std::shared_ptr<BoundMethodPackBase> pack,
                              Semaphore *semaphore, bool deleteMethod)
         : Message(Message::InvokeMessage), method_(method), pack_(pack),
-          semaphore_(semaphore), deleteMethod_(deleteMethod)
+          semaphore_(semaphore), deleteMethod_(deleteMethod),
+          coalesced_(false)
 {
 }
 
 InvokeMessage::~InvokeMessage()
 {
+    if (coalesced_)
+        BoundMethodBase::releaseMessage(this);
+
     if (deleteMethod_)
         delete method_;
 }
@@ -159,9 +163,19 @@ InvokeMessage::~InvokeMessage()
 /**
  * \brief Invoke the method bound to InvokeMessage::method_ with arguments
  * InvokeMessage::pack_
+ *
+ * For coalesced connections the message is released before invocation, any
+ * subsequent invocation will then be queued in a new message. If the bound
+ * method has been destroyed while the message was pending, no method is
+ * invoked.
  */
 void InvokeMessage::invoke()
 {
+    if (coalesced_) {
+        BoundMethodBase::invokeMessage(this);
+        return;
+    }
+
     method_->invokePack(pack_.get());
 }
 
@@ -66,7 +66,7 @@ void SignalBase::disconnect(std::function<bool(SlotList::iterator &)> match)
             if (object)
                 object->disconnect(this);
 
-            delete *iter;
+            (*iter)->destroy();
             iter = slots_.erase(iter);
         } else {
             ++iter;
@@ -131,6 +131,12 @@ SignalBase::SlotList SignalBase::slots()
  * Otherwise the caller shall disconnect signals manually before destroying \a
  * object.
  *
+ * If the typename T inherits from Object, the connection type and options can
+ * be selected with the optional \a type and \a flags parameters. Setting
+ * ConnectionFlag::Coalesce in \a flags causes queued invocations that are still
+ * pending when the signal is emitted again to be updated with the latest
+ * arguments instead of queuing a new invocation.
+ *
  * \context This function is \threadsafe.
  */
 
@@ -149,6 +155,9 @@ SignalBase::SlotList SignalBase::slots()
  * that satisfies the FunctionObject named requirements. The types of the
  * function object arguments shall match the types of the signal arguments.
  *
+ * As for member function slots, the connection \a type and \a flags can be
+ * selected when the typename T inherits from Object.
+ *
  * No matching disconnect() function exist, as it wouldn't be possible to pass
  * to a disconnect() function the same lambda that was passed to connect(). The
  * connection created by this function can not be removed selectively if the
@@ -158,6 +167,53 @@ SignalBase::SlotList SignalBase::slots()
  * \context This function is \threadsafe.
  */
 
+/**
+ * \typedef Signal::Filter
+ * \brief Predicate type to filter signal emissions for a connection
+ */
+
+/**
+ * \fn Signal::connect(T *object, R (T::*func)(Args...), Filter filter,
+ * ConnectionType type, ConnectionFlags flags)
+ * \brief Connect the signal to a member function slot with a filter
+ * \param[in] object The slot object pointer
+ * \param[in] func The slot member function
+ * \param[in] filter The predicate selecting the emissions to deliver
+ * \param[in] type The connection type
+ * \param[in] flags The connection options
+ *
+ * This function behaves as connect(T *object, R (T::*func)(Args...)), but the
+ * slot is only invoked for emissions for which the \a filter returns true. The
+ * \a filter is called with the signal arguments in the context of the thread
+ * that emits the signal, before the arguments are packed and before any message
+ * is posted to the receiver. Rejected emissions thus incur no cross-thread
+ * traffic.
+ *
+ * The \a filter may be called concurrently from all threads that emit the
+ * signal, and shall not modify the arguments.
+ *
+ * \context This function is \threadsafe.
+ */
+
+/**
+ * \fn Signal::connect(T *object, Func func, Filter filter,
+ * ConnectionType type, ConnectionFlags flags)
+ * \brief Connect the signal to a function object slot with a filter
+ * \param[in] object The slot object pointer
+ * \param[in] func The function object
+ * \param[in] filter The predicate selecting the emissions to deliver
+ * \param[in] type The connection type
+ * \param[in] flags The connection options
+ *
+ * This function behaves as connect(T *object, Func func), but the slot is only
+ * invoked for emissions for which the \a filter returns true. The \a filter is
+ * evaluated in the context of the thread that emits the signal, see
+ * connect(T *object, R (T::*func)(Args...), Filter filter, ConnectionType type,
+ * ConnectionFlags flags) for details.
+ *
+ * \context This function is \threadsafe.
+ */
+
 /**
  * \fn Signal::connect(R (*func)(Args...))
  * \brief Connect the signal to a static function slot
@@ -209,6 +265,9 @@ SignalBase::SlotList SignalBase::slots()
  * of the arguments (when passed by pointer or reference), the modification is
  * thus visible to all subsequently called slots.
  *
+ * Slots connected with a filter are skipped when the filter rejects the
+ * arguments.
+ *
  * This function is not \threadsafe, but thread-safety is guaranteed against
  * concurrent connect() and disconnect() calls.
  */
@@ -519,6 +519,22 @@ EventDispatcher *Thread::eventDispatcher()
     return data_->dispatcher_.load(std::memory_order_relaxed);
 }
 
+/**
+ * \brief Check if the thread has an event dispatcher
+ *
+ * The event dispatcher is created on the first call to eventDispatcher(). A
+ * thread without an event dispatcher doesn't run an event loop, and messages
+ * posted to it are never delivered.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return True if the event dispatcher has been created, false otherwise
+ */
+bool Thread::hasEventDispatcher() const
+{
+    return data_->dispatcher_.load(std::memory_order_acquire) != nullptr;
+}
+
 /**
  * \brief Post a message to the thread for the \a receiver
  * \param[in] msg The message
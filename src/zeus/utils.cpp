@@ -18,7 +18,8 @@
 // File: utils.cpp - Miscellaneous utility functions
 //
 
-#include <iomanip>
+#include <charconv>
+#include <ctype.h>
 #include <locale.h>
 #include <sstream>
 #include <stdlib.h>
@@ -188,32 +189,48 @@ struct timespec duration_to_timespec(const duration &value)
 std::string time_point_to_string(const time_point &time)
 {
     uint64_t nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
-    unsigned int secs = nsecs / 1000000000ULL;
-
-    std::ostringstream ossTimestamp;
-    ossTimestamp.fill('0');
-    ossTimestamp << secs / (60 * 60) << ":"
-                 << std::setw(2) << (secs / 60) % 60 << ":"
-                 << std::setw(2) << secs % 60 << "."
-                 << std::setw(9) << nsecs % 1000000000ULL;
-    return ossTimestamp.str();
+    uint64_t secs = nsecs / 1000000000ULL;
+
+    /* Format a zero-padded decimal value and return a pointer past its end. */
+    auto format = [](char *dst, uint64_t value, unsigned int width) {
+        char digits[20];
+        size_t len = std::to_chars(digits, digits + sizeof(digits), value).ptr - digits;
+        for (; width > len; --width)
+            *dst++ = '0';
+        memcpy(dst, digits, len);
+        return dst + len;
+    };
+
+    char str[40];
+    char *p = str;
+
+    p = format(p, secs / (60 * 60), 0);
+    *p++ = ':';
+    p = format(p, (secs / 60) % 60, 2);
+    *p++ = ':';
+    p = format(p, secs % 60, 2);
+    *p++ = '.';
+    p = format(p, nsecs % 1000000000ULL, 9);
+
+    return std::string(str, p - str);
 }
 
 std::basic_ostream<char, std::char_traits<char>> &
 operator<<(std::basic_ostream<char, std::char_traits<char>> &stream, const _hex &h)
 {
-    stream << "0x";
+    char digits[16];
+    size_t len = std::to_chars(digits, digits + sizeof(digits), h.v, 16).ptr - digits;
 
-    std::ostream::fmtflags flags = stream.setf(std::ios_base::hex,
-                                               std::ios_base::basefield);
-    std::streamsize width = stream.width(h.w);
-    char fill = stream.fill('0');
-
-    stream << h.v;
+    /* to_chars() produces lowercase digits, honour std::uppercase. */
+    if (stream.flags() & std::ios_base::uppercase) {
+        for (size_t i = 0; i < len; ++i)
+            digits[i] = toupper(digits[i]);
+    }
 
-    stream.flags(flags);
-    stream.width(width);
-    stream.fill(fill);
+    stream.write("0x", 2);
+    for (size_t i = len; i < h.w; ++i)
+        stream.put('0');
+    stream.write(digits, len);
 
     return stream;
 }
@@ -0,0 +1,76 @@
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// Copyright 2017 The Abseil Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// File: zeus-log-decode.cpp - Convert binary logs, flight recorders and crash reports to text
+//
+
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zeus/log_binary.h>
+#include <zeus/logging.h>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <binary-log> [output]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        std::cerr << "Failed to open " << argv[1] << ": "
+                  << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream file;
+    if (argc == 3) {
+        file.open(argv[2]);
+        if (!file) {
+            std::cerr << "Failed to open " << argv[2] << ": "
+                      << strerror(errno) << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::ostream &output = argc == 3 ? file : std::cout;
+
+    int ret = zeus::logDecodeBinary(input, output);
+    if (ret < 0) {
+        input.clear();
+        input.seekg(0);
+        ret = zeus::logDecodeFlightRecorder(input, output);
+    }
+
+    if (ret < 0) {
+        input.clear();
+        input.seekg(0);
+        ret = zeus::logDecodeCrashReport(input, output);
+    }
+
+    if (ret < 0) {
+        std::cerr << "Invalid binary log " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}